@@ -25,17 +25,16 @@
 *******************************************************************************/
 
 #include <project.h>
-#include "stdio.h"
+#include "string.h"
 #include "stdlib.h"
+#include "../common/slm_seq.h"
+#include "../common/slm_timing.h"
+#include "../common/slm_ts.h"
+#include "../common/slm_chan.h"
+#include "../common/slm_lcd.h"
+#include "../common/slm_fmt.h"
 
 
-#if defined (__GNUC__)
-    /* Add an explicit reference to the floating point printf library */
-    /* to allow usage of the floating point conversion specifiers. */
-    /* This is not linked in by default with the newlib-nano library. */
-    asm (".global _printf_float");
-#endif
-
 #define USBFS_DEVICE    (0u)
 
 /* The buffer size is equal to the maximum packet size of the IN and OUT bulk
@@ -44,51 +43,6 @@
 #define USBUART_BUFFER_SIZE (64u)
 #define LINE_STR_LENGTH     (20u)
 
-#define COUNT_PERIOD (0.0000005f) // 2MHz counter ticks 500ns
-#define SLM_CNTR_TICKS (5360u)    // 1.18ms + 1.5ms
-#define SLM_TRG_TICKS (200u)      // 50us
-//#define ANDOR_READ_TIME (2000u)   // 1MHz worst case is 1ms
-#define THIRTY_FPS (66667u)       // 33.3ms
-#define THIRTY_EXP (40955u)       // 33.3ms - 1ms - 1.18ms * 2
-#define THIRTY (30.0f)
-#define TEN (10.0f)
-#define TEN_FPS (200000u)
-#define TEN_EXP (77200u)        // 100ms - 1ms - 1.18ms * 2 - 56.8ms work damn you!
-#define TWENTY_FOUR (24.0f)
-#define TWENTY (20.0f)
-#define TWENTY_FPS (100000u)
-#define TWENTY_FOUR_FPS (83333u)
-#define TWENTY_EXP (3940u)       // 50ms - 1ms -1.18ms*2 - 39ms -4.43ms = 1.97ms
-#define FOURTY_EIGHT (48.0f)
-#define FOURTY_EIGHT_FPS (41666u)
-#define TWENTY_SIX_FPS (76923u)
-#define TWENTY_SIX (26.0f)
-#define STAGE_TICKS (180000u)     // Xms for stage trigger
-//#define STAGE_TICKS (12000u)
-#define ANDOR_READOUT (78600u)
-#define ANDOR_DELAY_TICKS (2048u)
-#define HAMA_SLOW_TICKS (650u)
-#define HAMA_NORM_TICKS (195u)
-#define HAMA_SLOW_READ (59586u)//(80920)//(58920u)  // 33ms - 1.18ms * 3
-//#define ANDOR_30_MHZ_HORZ (.00003837f)
-#define ANDOR_30_MHZ_HORZ (.00005547f) // Andors Timing chart is bulshit
-#define HAMA_SLOW_HORZ (.0000324812f) 
-#define HAMA_NORM_HORZ (.00000974436f)
-#define HAMA_VERT_DEFAULT (2048u)
-#define ANDOR_VERT_DEFAULT (1024u)
-#define CAP_MODE_NORMAL (0u)
-#define CAP_MODE_SLOW (1u)
-
-#define THREE_BEAM (0u)
-#define TWO_BEAM (1u)
-#define NO_SIM_Z_ONLY (2u)
-#define SINGLE_ANGLE (3u)
-#define SINGLE_ANGLE_MAX (5u)
-#define THREE_BEAM_MAX (15u)
-#define TWO_BEAM_MAX (9u)
-#define NO_BEAM_MAX (1u)
-#define TWO_CAM_MIN (2u)
-
 #define BLANK_ON (0u)
 #define BLANK_OFF (1u)
 
@@ -110,21 +64,11 @@
 #define OPTIONS5 "\n m) LASERS\nEnter Choice:"
 #define TRIGG_ON "Trig: ON "
 #define TRIGG_OFF "Trig: OFF"
+#define TRIGG_BAD "Trig: BAD"
 #define CAMERA_TRIGGER (0u)
 //#define SLM_TRIGGER (1u)
 #define STAGE_TRIGGER (1u)
-#define REG_ON (1u)
-#define REG_OFF (0u)
-#define FREE_RUN (0u)
-#define Z_MODE (1u)
-#define TIMED_MODE (2u)
-#define BLUE_LASER (0u)
-#define GREEN_LASER (1u)
-#define BOTH_LASERS (2u)
-
-#define TIMED_FIN 0x01
-#define Z_FIN     0x02
-#define STUPID (0u)//(200000u)
+
 
 char8* parity[] = {"None", "Odd", "Even", "Mark", "Space"};
 char8* stop[]   = {"1", "1.5", "2"};
@@ -151,130 +95,51 @@ char8* stop[]   = {"1", "1.5", "2"};
 *******************************************************************************/
 /******** The Land Of Globals ********/
 uint8 deMux = CAMERA_TRIGGER;
-volatile uint8 phases = 0;
-volatile uint16 zCount = 0;
-uint16 vert = ANDOR_VERT_DEFAULT;
-uint8 capMode = CAP_MODE_NORMAL;
-double horzPeriod = ANDOR_30_MHZ_HORZ;
-double readOutTime = 0;
-volatile uint8 mode = FREE_RUN;
-volatile uint8 simMode = THREE_BEAM;
-volatile uint16 zSteps = 0;
-volatile uint32 frameTicks = TEN_FPS;
-volatile uint32 exposureTicks = TEN_EXP;
-volatile float exposureSeconds = 0.0386f;
-volatile double exposure = 0.0386f;
-volatile double exposureMax = 0.00386f;
-volatile uint32 time_ticks_rem = 0;
-uint32 time_ticks = 0;
-uint32 wait_time_ticks = 0;
-volatile uint8 msgFlag = 0;
-volatile uint8 phase_max = THREE_BEAM_MAX;
-volatile uint8 laser_conf = BLUE_LASER;
-
-
-char line0[20];
+
+/* Menu choices -> sequencer modes */
+static const uint8 runModes[] = {FREE_RUN, Z_MODE, TIMED_MODE};
+static const uint8 simModes[] = {THREE_BEAM, TWO_BEAM, NO_SIM_Z_ONLY, SINGLE_ANGLE};
+
+
+char line0[32];     // wider than a row, lcd_print() cuts it
 char line1[20];
 char line2[20];
 char line3[20];
 
-double fps_in = TEN;
 
-
-char msg[64];
+char msg[96];        // longest is the read_input('a') echo, ~80 with a slow frame
 
 CY_ISR(T_ISR){
-    
-    // Controls the trigger periods and
-    // which device gets the trigger pulse
-    ENBL_TRIG_ISR_Write(REG_OFF);
-    TRIG_ISR_ClearPending();
-    
-    if (phases < phase_max) {
-            if(laser_conf == BOTH_LASERS){
-                /* First Laser Should be set to Green @ start*/
-                /* Just to make sure switches to Blue */
-                uint8 val = CAM_SEL_REG_Read();
-                CAM_SEL_REG_Write(!val);
-                if (val == BLUE_LASER){
-                    phases++;
-                    
-                }
-            } else {
-                phases++;
-            }
-            TRG_CNT_WritePeriod(exposureTicks);
-
-            TRIG_CNT_RST_Write(REG_ON);
-            TRIG_CNT_RST_Write(REG_OFF);
-            //TRIG_ISR_ClearPending();
-            ENBL_TRIG_ISR_Write(REG_ON);
-
-            if(mode == TIMED_MODE){
-                if(time_ticks_rem > frameTicks){
-                    time_ticks_rem -= frameTicks;
-                } else {
-                    time_ticks_rem = 0;
-                    ENBL_TRIG_ISR_Write(REG_OFF);
-                    msgFlag |= TIMED_FIN;
-                }
-            }
-        //}
-    } else {
-    //if (phases > 14){
-        phases = 0;
-        //strcpy(msg, "\nphases = 0\n");
-        /* Wait until component is ready to send data to host. */
-        //while (0u == USBUART_CDCIsReady())
-        //{
-        //}
-        /* Send MSG back to host. */
-        //USBUART_PutData((uint8*)msg, strlen(msg));
-        
-        if(mode == Z_MODE){
-            
-            if (zCount < zSteps) {
-                
-                STAGE_REG_Write(REG_ON);
-                STAGE_REG_Write(REG_OFF);
-                zCount++;
-                ENBL_TRIG_ISR_Write(REG_ON);
-                //TRIG_ISR_ClearPending();// Trying to see if this reduces stage movements.
-            } else {
-                ENBL_TRIG_ISR_Write(REG_OFF); 
-                zCount = 0;
-                msgFlag |= Z_FIN;
-            }
-        } else {
-            ENBL_TRIG_ISR_Write(REG_OFF);
-            ENBL_TRIG_ISR_Write(REG_ON);
-        }
-       
-    }
-
+    seq_frame_done();
+}
+#if (SLM_TIME_CNT)
+CY_ISR(TM_ISR){
+    seq_time_up();
 }
+#endif
 // read input prototype
 void read_input(uint8* buf, const char cmd);
 void set_mode(uint8* buf);
 void set_sim_mode(uint8* buf);
 void set_laser_mode(uint8* buf);
 void set_capMode(uint8* buf);
-void setExposure(void);
-void userSetExposure(void);
-void setWaitTime(void);
-void readTime(void);
+void report_timing(void);
+uint8 check_timing(void);
 
 int main()
 {
     uint16 count;
+    uint8 events;
     uint8 buffer[USBUART_BUFFER_SIZE] = {0};
     
 #if (CY_PSOC3 || CY_PSOC5LP)
     uint8 state;
     char8 lineStr[LINE_STR_LENGTH];
+    char* p;
     
     LCD_Char_Start();
 #endif /* (CY_PSOC3 || CY_PSOC5LP) */
+    lcd_init();
     
     CyGlobalIntEnable;
 
@@ -285,7 +150,11 @@ int main()
     BLANKING_DELAY_Start();
     STAGE_TRIG_Start();
     STAGE_WAIT_Start();
+    ts_init();
     TRIG_ISR_StartEx(T_ISR);
+#if (SLM_TIME_CNT)
+    TIME_ISR_StartEx(TM_ISR);
+#endif
 
     /* Start USBFS operation with 5-V operation. */
     USBUART_Start(USBFS_DEVICE, USBUART_5V_OPERATION);
@@ -297,10 +166,10 @@ int main()
         /* Send  OPTIONS. */
     //    USBUART_PutData((uint8*)msg, strlen(msg));
     //}
-    readTime();
-    setWaitTime();
+    mode = FREE_RUN;
+    stageWaitTicks = STAGE_TICKS;
+    setExposure();
     SLM_TRIG_WritePeriod(SLM_TRG_TICKS);
-    SLM_WAIT_WritePeriod(wait_time_ticks);
     TRIG_CNT_RST_Write(REG_ON);
     ACTIVATE_SLM_Write(REG_ON);
     STAGE_REG_Write(REG_ON);
@@ -308,18 +177,14 @@ int main()
     TRIG_CNT_RST_Write(REG_OFF);
     ACTIVATE_SLM_Write(REG_OFF);
     STAGE_REG_Write(REG_OFF);
-    BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-    STAGE_WAIT_WritePeriod(180000);
+    setBlankingDelay();
     BLANK_TOGGLE_Write(BLANK_ON);
     
-    LCD_Char_Position(0u, 0u);
-    LCD_Char_PrintString("Mode: Free");
-    LCD_Char_Position(0u, 11u);
-    LCD_Char_PrintString("FPS: 30.0");
-    LCD_Char_Position(1u, 0u);
-    LCD_Char_PrintString(TRIGG_OFF);
-    LCD_Char_Position(1u, 10u);
-    LCD_Char_PrintString("Blank: Off");
+    lcd_print(0u, 0u, "Mode: Free");
+    fmt_fps(fmt_str(line0, "FPS: "), frameTicks, 1u);
+    lcd_print(0u, 11u, line0);
+    lcd_print(1u, 0u, TRIGG_OFF);
+    lcd_print(1u, 10u, "Blank: Off");
     
     for(;;)
     {
@@ -414,7 +279,6 @@ int main()
                         /* Send MSG back to host. */
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         read_input(buffer, 'a');
-                        SLM_WAIT_WritePeriod(wait_time_ticks);
                         break;
                     case 'b': /* Set Z Steps */
                         strcpy(msg, ENTR_Z_STEPS);
@@ -446,7 +310,6 @@ int main()
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         read_input(buffer, 'd');
                         readTime();
-                        SLM_WAIT_WritePeriod(wait_time_ticks);
                         break;
                     case 'e': /* Change Hammamatsu Camera readout speed */
                         strcpy(msg, ENTER_CAP_MODE);
@@ -457,23 +320,9 @@ int main()
                         }
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         set_capMode(buffer);
-                        if(laser_conf == BLUE_LASER){
-                            if(capMode == CAP_MODE_NORMAL){
-                                horzPeriod = ANDOR_30_MHZ_HORZ;
-                                BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-                            } else {
-                                horzPeriod = ANDOR_30_MHZ_HORZ;;
-                                BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-                            }
-                        } else if (laser_conf == GREEN_LASER){
-                            horzPeriod = ANDOR_30_MHZ_HORZ;
-                            BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS); 
-                        } else {
-                            //horzPeriod = 0;
-                            BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-                        }
+                        setBlankingDelay();
                         setExposure();
-                        SLM_WAIT_WritePeriod(wait_time_ticks);
+                        report_timing();
                         break;
                     case 'f': /* Select between, Free Run, Z-stack and timed mode */
                         strcpy(msg, SELECT_MODE);
@@ -486,24 +335,22 @@ int main()
                         set_mode(buffer);
                         break;
                     case 'g': /* Start image Capture */
-                        strcpy(msg, "\n\n****Starting Capture****\n\n");
+                        if(check_timing()){
+                            break;
+                        }
+                        if(seq_start()){
+                            strcpy(msg, "\n\n****Starting Capture****\n\n");
+                            lcd_print(1u, 0u, TRIGG_ON);
+                        } else {
+                            strcpy(msg, "\n\n****Program not finished, capture refused****\n\n");
+                            lcd_print(1u, 0u, TRIGG_BAD);
+                        }
                         /* Send MSG back to host. */
                         /* Wait until component is ready to send data to host. */
                         while (0u == USBUART_CDCIsReady())
                         {
                         }
                         USBUART_PutData((uint8*)msg, strlen(msg));
-                        if(!ENBL_TRIG_ISR_Read()){
-                            time_ticks_rem = time_ticks;
-                            phases = 0;
-                            zCount = 0;
-                            if(laser_conf == BOTH_LASERS){
-                                CAM_SEL_REG_Write(GREEN_LASER);
-                            }
-                        }
-                        ENBL_TRIG_ISR_Write(REG_ON);
-                        LCD_Char_Position(1u,0u);
-                        LCD_Char_PrintString(TRIGG_ON);
                         break;
                     case 'h': /* Stop Image Capture */
                         strcpy(msg, "\n\n****Ending Capture****\n\n");
@@ -513,21 +360,18 @@ int main()
                         {
                         }
                         USBUART_PutData((uint8*)msg, strlen(msg));
-                        ENBL_TRIG_ISR_Write(REG_OFF);
-                        LCD_Char_Position(1u,0u);
-                        LCD_Char_PrintString(TRIGG_OFF);
+                        seq_stop();
+                        lcd_print(1u, 0u, TRIGG_OFF);
                         break;
                     case 'i': /* Toggle Laser Blanking */
                         if(BLANK_TOGGLE_Read()){
                             BLANK_TOGGLE_Write(BLANK_ON);
                             strcpy(msg, "\n\n****Blanking On****\n\n");
-                            LCD_Char_Position(1u,10u);
-                            LCD_Char_PrintString("Blank: On ");
+                            lcd_print(1u, 10u, "Blank: On ");
                         } else {
                             BLANK_TOGGLE_Write(BLANK_OFF);
                             strcpy(msg, "\n\n****Blanking Off****\n\n");
-                            LCD_Char_Position(1u,10u);
-                            LCD_Char_PrintString("Blank: Off");
+                            lcd_print(1u, 10u, "Blank: Off");
                         }
                         
                         while (0u == USBUART_CDCIsReady())
@@ -555,9 +399,9 @@ int main()
                         break;
                     case 'k': /* Print Out Current Configuration */
                         if(ENBL_TRIG_ISR_Read()){
-                            sprintf(msg, "\n\nTrigger: Running\n");   
+                            strcpy(msg, "\n\nTrigger: Running\n");   
                         } else {
-                            sprintf(msg, "\n\nTrigger: Stopped\n");                             
+                            strcpy(msg, "\n\nTrigger: Stopped\n");                             
                         }
                         
                         /* Wait until component is ready to send data to host. */
@@ -567,9 +411,9 @@ int main()
                         USBUART_PutData((uint8*)msg, strlen(msg));                        
                         
                         if(capMode == CAP_MODE_NORMAL){
-                            sprintf(msg, "Camera Readout Mode: Normal\n");
+                            strcpy(msg, "Camera Readout Mode: Normal\n");
                         } else {
-                             sprintf(msg, "Camera Readout Mode: SLOW\n");   
+                             strcpy(msg, "Camera Readout Mode: SLOW\n");   
                         }
                         /* Send  OPTIONS. */
                         /* Wait until component is ready to send data to host. */
@@ -579,11 +423,11 @@ int main()
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         
                         if(mode == 0){
-                            sprintf(msg, "Mode: Free Run\n");
+                            strcpy(msg, "Mode: Free Run\n");
                         } else if (mode == 1){
-                            sprintf(msg, "Mode: Z-Stack\n");
+                            strcpy(msg, "Mode: Z-Stack\n");
                         } else {
-                            sprintf(msg, "Mode: Timed\n");
+                            strcpy(msg, "Mode: Timed\n");
                         }
                         
                         /* Wait until component is ready to send data to host. */
@@ -593,13 +437,13 @@ int main()
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         
                         if(simMode == 0){
-                            sprintf(msg, "SIM Mode: Three Beam\n");
+                            strcpy(msg, "SIM Mode: Three Beam\n");
                         } else if(simMode == TWO_BEAM) {
-                            sprintf(msg, "SIM Mode: Two Beam\n");    
+                            strcpy(msg, "SIM Mode: Two Beam\n");    
                         } else if(simMode == NO_SIM_Z_ONLY){
-                            sprintf(msg, "SIM Mode: Z-only\n");   
+                            strcpy(msg, "SIM Mode: Z-only\n");   
                         } else {
-                            sprintf(msg, "SIM Mode: Single Angle\n");  
+                            strcpy(msg, "SIM Mode: Single Angle\n");  
                         }
                         
                         /* Wait until component is ready to send data to host. */
@@ -609,9 +453,9 @@ int main()
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         
                         if(BLANK_TOGGLE_Read()){
-                            sprintf(msg, "Blanking: Off\n");
+                            strcpy(msg, "Blanking: Off\n");
                         } else {
-                            sprintf(msg, "Blanking: On\n");
+                            strcpy(msg, "Blanking: On\n");
                         }
                         
                         /* Wait until component is ready to send data to host. */
@@ -620,21 +464,21 @@ int main()
                         }
                         USBUART_PutData((uint8*)msg, strlen(msg));                        
                         
-                        sprintf(msg, "FPS: %.3f\n", fps_in);
+                        fmt_str(fmt_fps(fmt_str(msg, "FPS: "), frameTicks, 3u), "\n");
                         /* Wait until component is ready to send data to host. */
                         while (0u == USBUART_CDCIsReady())
                         {
                         }
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         
-                        sprintf(msg, "exposure time: %.6f (sec)\n", exposure);                        
+                        fmt_str(fmt_sec(fmt_str(msg, "exposure time: "), exposureTicks), " (sec)\n");
                         /* Wait until component is ready to send data to host. */
                         while (0u == USBUART_CDCIsReady())
                         {
                         }
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         
-                        sprintf(msg, "Z-steps: %u\n", zSteps);
+                        fmt_str(fmt_u32(fmt_str(msg, "Z-steps: "), zSteps), "\n");
                         
                         /* Wait until component is ready to send data to host. */
                         while (0u == USBUART_CDCIsReady())
@@ -643,11 +487,11 @@ int main()
                         USBUART_PutData((uint8*)msg, strlen(msg));
 
                         if(laser_conf == BLUE_LASER){
-                            sprintf(msg, "Blue Laser\n");  
+                            strcpy(msg, "Blue Laser\n");  
                         } else if (laser_conf == GREEN_LASER){
-                            sprintf(msg, "Green Laser\n");
+                            strcpy(msg, "Green Laser\n");
                         } else {
-                            sprintf(msg, "Both Lasers Alternateing\n");   
+                            strcpy(msg, "Both Lasers Alternateing\n");   
                         }
                         
                         /* Wait until component is ready to send data to host. */
@@ -657,7 +501,8 @@ int main()
                         USBUART_PutData((uint8*)msg, strlen(msg));
                         break;
                     case 'l': /* Set User specified exposure time */
-                        sprintf(msg, "\n\nCan not exceed %.6f (sec) exposure to maintain fps\n", exposureMax);
+                        fmt_str(fmt_sec(fmt_str(msg, "\n\nCan not exceed "), exposureMaxTicks),
+                                " (sec) exposure to maintain fps\n");
                         /* Wait until component is ready to send data to host. */
                         while (0u == USBUART_CDCIsReady())
                         {
@@ -745,18 +590,16 @@ int main()
                 if (0u != (state & USBUART_LINE_CODING_CHANGED))
                 {                  
                     /* Get string to output. */
-                    sprintf(lineStr,"BR:%4ld %d%c%s", USBUART_GetDTERate(),\
-                                   (uint16) USBUART_GetDataBits(),\
-                                   parity[(uint16) USBUART_GetParityType()][0],\
-                                   stop[(uint16) USBUART_GetCharFormat()]);
+                    p = fmt_u32(fmt_str(lineStr, "BR:"), USBUART_GetDTERate());
+                    p = fmt_u32(fmt_char(p, ' '), (uint16) USBUART_GetDataBits());
+                    p = fmt_char(p, parity[(uint16) USBUART_GetParityType()][0]);
+                    fmt_str(p, stop[(uint16) USBUART_GetCharFormat()]);
 
                     /* Clear LCD line. */
-                    LCD_Char_Position(0u, 0u);
-                    LCD_Char_PrintString("                    ");
+                    lcd_print(0u, 0u, "                    ");
 
                     /* Output string on LCD. */
-                    LCD_Char_Position(0u, 0u);
-                    LCD_Char_PrintString(lineStr);
+                    lcd_print(0u, 0u, lineStr);
                 }
 
                 /* Output on LCD Line Control settings. */
@@ -764,41 +607,39 @@ int main()
                 {                   
                     /* Get string to output. */
                     state = USBUART_GetLineControl();
-                    sprintf(lineStr,"DTR:%s,RTS:%s",  (0u != (state & USBUART_LINE_CONTROL_DTR)) ? "ON" : "OFF",
-                                                      (0u != (state & USBUART_LINE_CONTROL_RTS)) ? "ON" : "OFF");
+                    p = fmt_str(fmt_str(lineStr, "DTR:"), (0u != (state & USBUART_LINE_CONTROL_DTR)) ? "ON" : "OFF");
+                    fmt_str(fmt_str(p, ",RTS:"), (0u != (state & USBUART_LINE_CONTROL_RTS)) ? "ON" : "OFF");
 
                     /* Clear LCD line. */
-                    LCD_Char_Position(1u, 0u);
-                    LCD_Char_PrintString("                    ");
+                    lcd_print(1u, 0u, "                    ");
 
                     /* Output string on LCD. */
-                    LCD_Char_Position(1u, 0u);
-                    LCD_Char_PrintString(lineStr);
+                    lcd_print(1u, 0u, lineStr);
                 }
             }
         #endif /* (CY_PSOC3 || CY_PSOC5LP) */
         }
-        switch(msgFlag){
-            case Z_FIN:
-                sprintf(msg, "\n\n****Z-capture Finished****\n\n");
-                /* Wait until component is ready to send data to PC. */
-                while (0u == USBUART_CDCIsReady())
-                {
-                }
-                USBUART_PutData((uint8*)msg, strlen(msg));
-                msgFlag &= ~Z_FIN;
-                break;
-            case TIMED_FIN:
-                sprintf(msg, "\n\n****Timed-capture Finished****\n\n");
-                /* Wait until component is ready to send data to PC. */
-                while (0u == USBUART_CDCIsReady())
-                {
-                }                
-                USBUART_PutData((uint8*)msg, strlen(msg));
-                msgFlag &= ~TIMED_FIN;
-                break;
-            default:
-                break;
+        events = seq_take_events();
+        if(events & Z_FIN){
+            strcpy(msg, "\n\n****Z-capture Finished****\n\n");
+            /* Wait until component is ready to send data to PC. */
+            while (0u == USBUART_CDCIsReady())
+            {
+            }
+            USBUART_PutData((uint8*)msg, strlen(msg));
+        }
+        if(events & TIMED_FIN){
+            strcpy(msg, "\n\n****Timed-capture Finished****\n\n");
+            /* Wait until component is ready to send data to PC. */
+            while (0u == USBUART_CDCIsReady())
+            {
+            }                
+            USBUART_PutData((uint8*)msg, strlen(msg));
+        }
+
+        /* The display only gets the loop when nothing else wants it */
+        if(!events && 0u == USBUART_DataIsReady()){
+            lcd_task();
         }
     }
 }
@@ -806,6 +647,7 @@ int main()
 // UART MAGIC
 void read_input(uint8* buf, const char cmd){
    char val_str[32] = {0};
+   char* p;
    uint8 i = 0;
    uint8 count = 0;
    while(buf[0] != '\n'){
@@ -850,45 +692,58 @@ void read_input(uint8* buf, const char cmd){
             }
         }
    }
-    double time_s;
     if(i < 31){
         val_str[i] = '\0';
         switch(cmd){
             case 'a':
                 fps_in = strtof(val_str, NULL);
                 if(fps_in > 0.0f){
-                   double period = 1 / fps_in;
-                   frameTicks = (uint32)(period / COUNT_PERIOD);
+                   frameTicks = fpsToTicks(fps_in);
                 }
-                //exposureTicks = frameTicks - SLM_CNTR_TICKS - HAMA_SLOW_READ - SLM_TRG_TICKS;
                 setExposure();
-                sprintf(msg, "\n\nSetting: %.1f, frameTicks: %lu, exposure: %.6f (sec)\n\n", fps_in, frameTicks, exposure);
+                report_timing();
+                p = fmt_fps(fmt_str(msg, "\n\nSetting: "), frameTicks, 1u);
+                p = fmt_u32(fmt_str(p, ", frameTicks: "), frameTicks);
+                fmt_str(fmt_sec(fmt_str(p, ", exposure: "), exposureTicks), " (sec)\n\n");
                 
-                sprintf(line0, "FPS: %.1f", fps_in);
-                LCD_Char_Position(0u, 11u);
-                LCD_Char_PrintString(line0);
+                fmt_fps(fmt_str(line0, "FPS: "), frameTicks, 1u);
+                lcd_print(0u, 11u, line0);
                 break;
             case 'b':
                 zSteps = (uint16)atoi(val_str);
-                sprintf(msg, "\n\nSetting: %s, zSteps: %u\n\n", val_str, zSteps);
+                p = fmt_str(fmt_str(msg, "\n\nSetting: "), val_str);
+                fmt_str(fmt_u32(fmt_str(p, ", zSteps: "), zSteps), "\n\n");
                 break;
             case 'c':
-                time_s = strtof(val_str, NULL);
-                time_ticks = (uint32)(time_s / COUNT_PERIOD);
-                sprintf(msg, "\n\nSetting: %s, time_ticks: %lu\n\n", val_str, time_ticks);
+                time_ticks = secToTicks(strtof(val_str, NULL));
+                p = fmt_str(fmt_str(msg, "\n\nSetting: "), val_str);
+                fmt_str(fmt_u32(fmt_str(p, ", time_ticks: "), time_ticks), "\n\n");
                 break;
             case 'd':
                 vert = (uint16)atoi(val_str);
                 setExposure();
-                sprintf(msg, "\n\nSetting: %s, exposure_ticks: %lu\n\n", val_str, exposureTicks);
+                report_timing();
+                p = fmt_str(fmt_str(msg, "\n\nSetting: "), val_str);
+                fmt_str(fmt_u32(fmt_str(p, ", exposure_ticks: "), exposureTicks), "\n\n");
                 break;
             case 'l':
                 exposure = strtof(val_str, NULL);
-                userSetExposure();
-                sprintf(msg, "\n\nSetting exposure: %.6f, exposureTicks: %lu\n\n", exposure, exposureTicks);
+                timingMsg = 0;
+                userSetExposure(0);
+                if(timingMsg & EXP_CHANGED){
+                    strcpy(msg, "\n\nExposure too long setting to exposureMax\n");
+                    while (0u == USBUART_CDCIsReady())
+                    {
+                    }
+                    /* Send Messege */
+                    USBUART_PutData((uint8*)msg, strlen(msg));
+                }
+                report_timing();
+                p = fmt_sec(fmt_str(msg, "\n\nSetting exposure: "), exposureTicks);
+                fmt_str(fmt_u32(fmt_str(p, ", exposureTicks: "), exposureTicks), "\n\n");
                 break;
             default:
-                sprintf(msg, "\n\n****something wrong has happened****\n\n");
+                strcpy(msg, "\n\n****something wrong has happened****\n\n");
                 break;
         }
         while (0u == USBUART_CDCIsReady())
@@ -896,13 +751,14 @@ void read_input(uint8* buf, const char cmd){
         }
         USBUART_PutData((uint8*)msg, strlen(msg));
     } else {
-        sprintf(msg, "\n\n****number too long****\n\n");
+        strcpy(msg, "\n\n****number too long****\n\n");
         USBUART_PutData((uint8*)msg, strlen(msg));
     }
 }
 
 void set_mode(uint8* buf){
    char val_str[32] = {0};
+   char* p;
    uint8 i = 0;
    uint8 count = 0;
    while(i < 1){
@@ -948,28 +804,28 @@ void set_mode(uint8* buf){
         }
     }
     if(val_str[0] != '\n'){
-        mode = (uint8)atoi(val_str);   
+        mode = runModes[val_str[0] - '0'];
     }
-    sprintf(msg, "\n\nMode: %u\n", mode);
+    fmt_str(fmt_u32(fmt_str(msg, "\n\nMode: "), mode), "\n");
     while (0u == USBUART_CDCIsReady())
     {
     }
     USBUART_PutData((uint8*)msg, strlen(msg));
-    if(mode == 0){
-        sprintf(line0, "Mode: Free FPS: %.1f", fps_in);
-    } else if(mode == 1){
-        sprintf(line0, "Mode: Z-St FPS: %.1f", fps_in);
+    if(mode == FREE_RUN){
+        p = fmt_str(line0, "Mode: Free FPS: ");
+    } else if(mode == Z_MODE){
+        p = fmt_str(line0, "Mode: Z-St FPS: ");
     } else {
-       sprintf(line0, "Mode: Timed FPS: %.1f", fps_in);   
+       p = fmt_str(line0, "Mode: Timed FPS: ");
     }
+    fmt_fps(p, frameTicks, 1u);
     
     while (0u == USBUART_CDCIsReady())
     {
     }
     USBUART_PutData((uint8*)msg, strlen(msg));
     
-    LCD_Char_Position(0u, 0u);
-    LCD_Char_PrintString(line0);
+    lcd_print(0u, 0u, line0);
     
 }
 
@@ -1020,24 +876,16 @@ void set_sim_mode(uint8* buf){
         }
     }
     if(val_str[0] != '\n'){
-        simMode = (uint8)atoi(val_str);   
+        seq_set_sim_mode(simModes[val_str[0] - '0']);
     }
     if(simMode == TWO_BEAM){
-        phase_max = TWO_BEAM_MAX;
-        sprintf(msg, "\n\nSIM Mode: TWO BEAM\n");
+        strcpy(msg, "\n\nSIM Mode: TWO BEAM\n");
     } else if(simMode == THREE_BEAM) {
-        phase_max = THREE_BEAM_MAX;
-        sprintf(msg, "\n\nSIM Mode: THREE BEAM\n");           
-    } else if (simMode == NO_SIM_Z_ONLY){
-        phase_max = NO_BEAM_MAX;
-        sprintf(msg, "\n\nSIM Mode: Z-Only\n");
+        strcpy(msg, "\n\nSIM Mode: THREE BEAM\n");           
     } else if (simMode == SINGLE_ANGLE) {
-        phase_max = SINGLE_ANGLE_MAX;
-        sprintf(msg, "\n\nSIM Mode: SINGLE ANGLE\n");
+        strcpy(msg, "\n\nSIM Mode: SINGLE ANGLE\n");
     } else {
-        phase_max = NO_BEAM_MAX;
-        simMode = NO_SIM_Z_ONLY;
-        sprintf(msg, "\n\nSIM Mode: Z-Only\n");
+        strcpy(msg, "\n\nSIM Mode: Z-Only\n");
     }
 
     while (0u == USBUART_CDCIsReady())
@@ -1067,6 +915,7 @@ void set_laser_mode(uint8* buf){
    char val_str[32] = {0};
    uint8 i = 0;
    uint8 count = 0;
+   uint8 laser = laser_conf;
    while(i < 1){
                /* Service USB CDC when device is configured. */
         if (0u != USBUART_GetConfiguration())
@@ -1110,35 +959,25 @@ void set_laser_mode(uint8* buf){
         }
     }
     if(val_str[0] != '\n'){
-        laser_conf = (uint8)atoi(val_str);   
+        laser = (uint8)atoi(val_str);
     }
-    if(laser_conf == BLUE_LASER){
-        CAM_SEL_REG_Write(BLUE_LASER);
-        sprintf(msg, "\n\nLaser Mode: 488nm\n");
-        if(capMode == CAP_MODE_NORMAL){
-            horzPeriod = ANDOR_30_MHZ_HORZ;
-            if(capMode == CAP_MODE_NORMAL){
-                BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-            } else {
-                BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);    
-            }
-        } else {
-            horzPeriod = ANDOR_30_MHZ_HORZ;
-            BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-        }
+    /* GREEN_LASER, or BOTH_LASERS starting on green; not under a capture */
+    if(chan_set_laser(laser)){
+        laser_conf = laser;
+        setBlankingDelay();
+        setExposure();
+        report_timing();
+    }
+
+    if(laser != laser_conf){
+        strcpy(msg, "\n\nLaser Mode: not changed, capture running\n");
+    } else if(laser_conf == BLUE_LASER){
+        strcpy(msg, "\n\nLaser Mode: 488nm\n");
     } else if(laser_conf == GREEN_LASER){
-        CAM_SEL_REG_Write(GREEN_LASER);
-        BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);    
-        sprintf(msg, "\n\nLaser Mode: 561nm\n");           
+        strcpy(msg, "\n\nLaser Mode: 561nm\n");           
     } else {
-        sprintf(msg, "\n\nLaser Mode: 488nm and 561nm Alternating\n");
-        // Try Set Readout Time to 0
-        //horzPeriod = 0;
-        CAM_SEL_REG_Write(GREEN_LASER);
-        BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);    
+        strcpy(msg, "\n\nLaser Mode: 488nm and 561nm Alternating\n");
     }
-    
-    setExposure();
 
     while (0u == USBUART_CDCIsReady())
     {
@@ -1197,104 +1036,30 @@ void set_capMode(uint8* buf){
     if(val_str[0] != '\n'){
         capMode = (uint8)atoi(val_str);   
     }
-    sprintf(msg, "\n\nCapture Mode: %u\n", capMode);
+    fmt_str(fmt_u32(fmt_str(msg, "\n\nCapture Mode: "), capMode), "\n");
     while (0u == USBUART_CDCIsReady())
     {
     }
     USBUART_PutData((uint8*)msg, strlen(msg));
 }
 
-void setExposure(void){
-    readTime();
-    exposureMax = 1 / fps_in - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-    if(exposureMax < 0){
-        if(capMode == CAP_MODE_NORMAL){
-            exposureMax = 1 / TEN - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-            fps_in = TEN;
-            sprintf(msg, "\n***Timing error setting to 10fps***\n");
-            while (0u == USBUART_CDCIsReady())
-            {
-            }
-            /* Send Messege */
-            USBUART_PutData((uint8*)msg, strlen(msg));
-        } else {
-            exposureMax = 1 / TEN - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-            fps_in = TEN;
-            sprintf(msg, "\n***Timing error setting to 10fps***\n");
-            while (0u == USBUART_CDCIsReady())
-            {
-            }
-            /* Send Messege */
-            USBUART_PutData((uint8*)msg, strlen(msg));
-        }
-        
-        if(laser_conf == GREEN_LASER){
-            exposureMax = 1 / TEN - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-            fps_in = TEN;
-            sprintf(msg, "\n***Timing error setting to 10fps***\n");
-            while (0u == USBUART_CDCIsReady())
-            {
-            }
-            /* Send Messege */
-            USBUART_PutData((uint8*)msg, strlen(msg));               
-        } else if (laser_conf == BOTH_LASERS){
-            exposureMax = 1 / FOURTY_EIGHT - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-            fps_in = FOURTY_EIGHT;
-            sprintf(msg, "\n***Timing error setting to 48fps***\n");
-            while (0u == USBUART_CDCIsReady())
-            {
-            }
-            /* Send Messege */
-            USBUART_PutData((uint8*)msg, strlen(msg)); 
-        }
-        
-    }
-    
+/* Tell the terminal what the timing core worked out */
+void report_timing(void){
+    char* p;
 
-    
-    exposure = exposureMax;
-    exposureTicks = (uint32)(exposure/COUNT_PERIOD);
-    setWaitTime();
-    
-}
-
-void userSetExposure(void){
-    //readTime();
-    //exposureMax = 1 / fps_in - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-    if(exposureMax < exposure){
-        exposure = exposureMax;
-        sprintf(msg, "\n\nExposure too long setting to exposureMax\n");
+    if(timingMsg & FPS_CHANGED){
+        p = fmt_fps(fmt_str(msg, "\n***Timing error setting to "), frameTicks, 1u);
+        fmt_str(fmt_str(fmt_str(p, "fps ("), limitName(frameLimit)), " limit)***\n");
         while (0u == USBUART_CDCIsReady())
         {
         }
         /* Send Messege */
         USBUART_PutData((uint8*)msg, strlen(msg));
     }
+    timingMsg = 0;
 
-    exposureTicks = (uint32)(exposure/COUNT_PERIOD);
-    setWaitTime();
-    
-}
-
-void setWaitTime(void){
-    double float_ticks = (readOutTime / COUNT_PERIOD) - (double)SLM_CNTR_TICKS / 2.0f;
-    
-    if(float_ticks <= 0 /*|| laser_conf == BOTH_LASERS*/){
-        wait_time_ticks = SLM_CNTR_TICKS + STUPID;
-    } else {
-        wait_time_ticks = (uint32)(readOutTime / COUNT_PERIOD) - SLM_TRG_TICKS / 2 + STUPID;
-    }
-    
-    //if(laser_conf == BOTH_LASERS){
-        uint32 remain_ticks = frameTicks - exposureTicks - SLM_TRG_TICKS;
-        if(wait_time_ticks < remain_ticks){
-             wait_time_ticks = remain_ticks + STUPID;   
-        }
-        if(wait_time_ticks < SLM_CNTR_TICKS){
-            wait_time_ticks = SLM_CNTR_TICKS + STUPID;
-        }
-    //}
-    sprintf(msg, "\nwait_time_ticks: %lu\nexposure: %.6f\n", wait_time_ticks, exposure);
+    p = fmt_u32(fmt_str(msg, "\nwait_time_ticks: "), wait_time_ticks);
+    fmt_str(fmt_sec(fmt_str(p, "\nexposure: "), exposureTicks), "\n");
     while (0u == USBUART_CDCIsReady())
     {
     }
@@ -1302,9 +1067,35 @@ void setWaitTime(void){
     USBUART_PutData((uint8*)msg, strlen(msg));
 }
 
-void readTime(void){
-    //readOutTime = (vert/2.0 + 10)*horzPeriod;
-    readOutTime = (vert + 10)*horzPeriod + 0.0064;// 64 is a fudge to see if we can obey andor readout timing
+/* Static timing check before a start (slm_check.h); the constraints that
+*  failed go out one line each with what they are short of
+*/
+uint8 check_timing(void){
+    struct timing_verdict verdict;
+    uint8 i;
+    char* p;
+
+    if(!seq_check_timing(&verdict)){
+        return 0;
+    }
+    strcpy(msg, "\n\n****Timing check failed, not starting****");
+    while (0u == USBUART_CDCIsReady())
+    {
+    }
+    USBUART_PutData((uint8*)msg, strlen(msg));
+    for(i = 0; i < CHECK_COUNT; i++){
+        if(verdict.failed & CHECK_BIT(i)){
+            p = fmt_str(fmt_str(msg, "\n"), checkName(i));
+            p = fmt_u32(fmt_str(p, ": short by "), (uint32)-verdict.slack[i]);
+            fmt_str(p, " ticks");
+            while (0u == USBUART_CDCIsReady())
+            {
+            }
+            USBUART_PutData((uint8*)msg, strlen(msg));
+        }
+    }
+    lcd_print(1u, 0u, TRIGG_BAD);
+    return verdict.failed;
 }
 
 /* [] END OF FILE */
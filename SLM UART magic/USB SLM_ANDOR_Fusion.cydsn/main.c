@@ -25,70 +25,32 @@
 *******************************************************************************/
 
 #include <project.h>
-#include "stdio.h"
 #include "stdlib.h"
+#include "../common/slm_seq.h"
+#include "../common/slm_timing.h"
+#include "../common/slm_sched.h"
+#include "../common/slm_ts.h"
+#include "../common/slm_isr_stats.h"
+#include "../common/slm_usb.h"
+#include "../common/slm_trace.h"
+#include "../common/slm_chan.h"
+#include "../common/slm_plane.h"
+#include "../common/slm_lcd.h"
+#include "../common/slm_fmt.h"
 
 
-#if defined (__GNUC__)
-    /* Add an explicit reference to the floating point printf library */
-    /* to allow usage of the floating point conversion specifiers. */
-    /* This is not linked in by default with the newlib-nano library. */
-    asm (".global _printf_float");
-#endif
-
 #define USBFS_DEVICE    (0u)
 
 /* The buffer size is equal to the maximum packet size of the IN and OUT bulk
 * endpoints.
 */
 
-//Stuff for USB communication
-#define CHANGE_FPS 0x1
-#define CHANGE_Z_STEPS 0x2
-#define SET_READOUT_SPEED 0x4
-#define SLOW_READOUT 0x8
-#define SET_LASER_MODE 0x10
-#define COUNTING 0x20
-#define STOP_COUNT 0x40
-#define SET_RUN_MODE 0x100
-#define SET_SIM_MODE 0x200
-#define START_CAPTURE 0x800
-#define STOP_CAPTURE 0x1000
-#define STAGE_TRIGG_ENABLE 0x40000
-#define STAGE_TRIGG_DISABLE 0x80000
-#define SEND_TRIGG 0x100000
-#define SET_EXPOSURE 0x200000
-#define START_LIVE 0x100000
-#define LIVE_RUNNING 0x200000
-#define STOP_LIVE 0x400000
-#define STAGE_MOVE_COMPLETE 0x800000
-#define Z_STACK_RUNNING 0x1000000
-#define STOP_Z_STACK 0x2000000
-#define TOGGLE_BLANKING 0x4000000
-#define TOGGLE_DIG_MOD 0x8000000
-
 /* USB device number. */
 #define USBFS_DEVICE  (0u)
 
-/* Active endpoints of USB device. */
-#define IN_EP_NUM     (1u)
-#define OUT_EP_NUM    (2u)
-
 /* Size of SRAM buffer to store endpoint data. */
 #define BUFFER_SIZE   (64u)
 
-struct usb_data{
-    volatile float fps;
-    volatile float exposure;
-    volatile uint32 flags;
-    volatile uint16 steps;
-    volatile uint8 mode;
-    volatile uint8 bonus;
-    volatile uint32 count;
-};
-volatile struct usb_data incoming;
-volatile struct usb_data outgoing;
-
 #define DEFAULT_FPS (5.0f)
 
 #if (USBFS_16BITS_EP_ACCESS_ENABLE)
@@ -116,57 +78,6 @@ volatile struct usb_data outgoing;
 #define USBUART_BUFFER_SIZE (64u)
 #define LINE_STR_LENGTH     (20u)
 
-#define COUNT_PERIOD (0.0000005f) // 2MHz counter ticks 500ns
-#define SLM_CNTR_TICKS (5360u)    // 1.18ms + 1.5ms
-#define SLM_TRG_TICKS (200u)      // 50us
-//#define ANDOR_READ_TIME (2000u)   // 1MHz worst case is 1ms
-#define THIRTY_FPS (66667u)       // 33.3ms
-#define THIRTY_EXP (40955u)       // 33.3ms - 1ms - 1.18ms * 2
-#define THIRTY (30.0f)
-#define TEN (10.0f)
-#define TEN_FPS (200000u)
-#define TEN_EXP (77200u)        // 100ms - 1ms - 1.18ms * 2 - 56.8ms work damn you!
-#define FIFTEEN (15.0f)
-#define TWENTY_FOUR (24.0f)
-#define TWENTY (20.0f)
-#define TWENTY_FPS (100000u)
-#define TWENTY_FOUR_FPS (83333u)
-#define TWENTY_EXP (3940u)       // 50ms - 1ms -1.18ms*2 - 39ms -4.43ms = 1.97ms
-#define FOURTY_EIGHT (48.0f)
-#define FOURTY_EIGHT_FPS (41666u)
-#define TWENTY_SIX_FPS (76923u)
-#define TWENTY_SIX (26.0f)
-#define STAGE_TICKS (180000u)     // Xms for stage trigger
-//#define STAGE_TICKS (12000u)
-#define ANDOR_READOUT (78600u)
-#define ANDOR_DELAY_TICKS (2048u)
-#define HAMA_SLOW_TICKS (650u)
-#define HAMA_NORM_TICKS (195u)
-#define HAMA_SLOW_READ (59586u)//(80920)//(58920u)  // 33ms - 1.18ms * 3
-//#define ANDOR_30_MHZ_HORZ (.00003837f)
-#define ANDOR_30_MHZ_HORZ (.00005547f) // Andors Timing chart is bulshit
-#define HAMA_SLOW_HORZ (.0000324812f) 
-#define HAMA_NORM_HORZ (.00000974436f)
-#define HAMA_VERT_DEFAULT (2048u)
-#define ANDOR_VERT_DEFAULT (1024u)
-#define CAP_MODE_NORMAL (0u)
-#define CAP_MODE_SLOW (1u)
-
-#define THREE_BEAM (0x0)
-#define TWO_BEAM (0x1)
-#define NO_SIM_Z_ONLY (0x2)
-#define SINGLE_ANGLE (0x4)
-#define SEVEN_PHASE (0x8)
-#define SEVEN_FREE (0x10)
-#define SINGLE_ANGLE_MAX (5u)
-#define THREE_BEAM_MAX (15u)
-#define SEVEN_PHASE_MAX (21u)
-#define TWO_BEAM_MAX (9u)
-#define NO_BEAM_MAX (1u)
-#define TWO_CAM_MIN (2u)
-#define ANGLE_MAX (3u)
-#define AXIAL_MAX (6u)
-
 #define BLANK_ON (0u)
 #define BLANK_OFF (1u)
 
@@ -188,27 +99,10 @@ volatile struct usb_data outgoing;
 #define OPTIONS5 "\n m) LASERS\nEnter Choice:"
 #define TRIGG_ON "Trig: ON "
 #define TRIGG_OFF "Trig: OFF"
+#define TRIGG_BAD "Trig: BAD"
 #define CAMERA_TRIGGER (0u)
 //#define SLM_TRIGGER (1u)
 #define STAGE_TRIGGER (1u)
-#define REG_ON (1u)
-#define REG_OFF (0u)
-#define FREE_RUN (0u)
-#define Z_MODE (1u)
-#define COUNT_MODE (2u)
-
-#define STOP_BLANKING (0x0)
-#define START_BLANKING (0x1)
-
-#define ARB_EXP (0x4)
-#define BLUE_LASER (0u)
-#define GREEN_LASER (1u)
-#define BOTH_LASERS (2u)
-
-#define COUNT_FIN 0x01
-#define Z_FIN     0x02
-
-#define STUPID (0u)//(200000u)
 
 //char8* parity[] = {"None", "Odd", "Even", "Mark", "Space"};
 //char8* stop[]   = {"1", "1.5", "2"};
@@ -235,198 +129,39 @@ volatile struct usb_data outgoing;
 *******************************************************************************/
 /******** The Land Of Globals ********/
 uint8 deMux = CAMERA_TRIGGER;
-volatile uint8 phases = 0;
-volatile uint8 angles = 0;
-volatile uint8 axCount = 0;
-volatile uint16 zCount = 0;
-volatile uint32 frameCount = 1;
-volatile uint32 count_itt = 0;
-uint16 vert = ANDOR_VERT_DEFAULT;
-uint8 capMode = CAP_MODE_SLOW;
-double horzPeriod = ANDOR_30_MHZ_HORZ;
-double readOutTime = 0;
-volatile uint8 mode = COUNT_MODE;
-volatile uint8 simMode = THREE_BEAM;
-volatile uint16 zSteps = 0;
-volatile uint32 frameTicks = TEN_FPS;
-volatile uint32 exposureTicks = TEN_EXP;
 volatile float exposureSeconds = 0.0386f;
-volatile double exposure = 0.0386f;
-volatile double exposureMax = 0.00386f;
-volatile uint32 time_ticks_rem = 0;
-uint32 time_ticks = 0;
-uint32 wait_time_ticks = 0;
-volatile uint8 msgFlag = 0;
-volatile uint8 phase_max = THREE_BEAM_MAX;
-volatile uint8 laser_conf = BLUE_LASER;
 volatile uint8 to_send = 0;
 
 
-char line0[20];
+char line0[32];     // wider than a row, lcd_print() cuts it
 char line1[20];
 char line2[20];
 char line3[20];
 
-volatile float fps_in = TEN;
-
-
-char msg[64];
-
 CY_ISR(T_ISR){
-    
-    // Controls the trigger periods and
-    // which device gets the trigger pulse
-    //STAGE_WAIT_REG_Write(REG_OFF);
-    ENBL_TRIG_ISR_Write(REG_OFF);
-    TRIG_ISR_ClearPending();
-    //outgoing.flags &= ~SEND_TRIGG;
-    switch(simMode){
-        case SEVEN_PHASE:
-            if (angles < ANGLE_MAX) {
-                if(laser_conf == BOTH_LASERS){
-                    /* First Laser Should be set to Green @ start*/
-                    /* Just to make sure switches to Blue */
-                    uint8 val = CAM_SEL_REG_Read();
-                    CAM_SEL_REG_Write(!val);
-                    if (val == BLUE_LASER){
-                        angles++;
-                        
-                    }
-                } else {
-                    angles++;
-                }
-                //TRG_CNT_WritePeriod(exposureTicks);
-
-                TRIG_CNT_RST_Write(REG_ON);
-                TRIG_CNT_RST_Write(REG_OFF);
-                //TRIG_ISR_ClearPending();
-                ENBL_TRIG_ISR_Write(REG_ON);
-                //STAGE_WAIT_REG_Write(REG_ON);
-
-
-                   
-                //}
-            } else {
-
-                angles = 0;
-
-                
-                
-                    
-                    if (axCount < AXIAL_MAX) {
-                        
-
-                        outgoing.flags |= SEND_TRIGG;
-                        //STAGE_REG_Write(REG_ON);
-                        //STAGE_REG_Write(REG_OFF);
-                        axCount++;
-                        //ENBL_TRIG_ISR_Write(REG_ON);
-                        //TRIG_ISR_ClearPending();// Trying to see if this reduces stage movements.
-                    } else {
-                        ENBL_TRIG_ISR_Write(REG_OFF); 
-                        //STAGE_WAIT_REG_Write(REG_ON);
-                        axCount = 0;
-                        msgFlag |= Z_FIN;
-                    }
-/*                } else if(mode == COUNT_MODE){
-                    if(count_itt < frameCount){
-                        count_itt += 1;
-                        ENBL_TRIG_ISR_Write(REG_OFF);
-                        ENBL_TRIG_ISR_Write(REG_ON);
-                    } else {
-                        count_itt = 0;
-                        ENBL_TRIG_ISR_Write(REG_OFF);
-                        msgFlag |= COUNT_FIN;
-                    }
-                } else {
-                    ENBL_TRIG_ISR_Write(REG_OFF);
-                    ENBL_TRIG_ISR_Write(REG_ON);
-                }*/
-            
-               
-            }
-            break;
-        default:
-            if (phases < phase_max) {
-                    if(laser_conf == BOTH_LASERS){
-                        /* First Laser Should be set to Green @ start*/
-                        /* Just to make sure switches to Blue */
-                        uint8 val = CAM_SEL_REG_Read();
-                        CAM_SEL_REG_Write(!val);
-                        if (val == BLUE_LASER){
-                            phases++;
-                            
-                        }
-                    } else {
-                        phases++;
-                    }
-                    //TRG_CNT_WritePeriod(exposureTicks);
-
-                    TRIG_CNT_RST_Write(REG_ON);
-                    TRIG_CNT_RST_Write(REG_OFF);
-                    //TRIG_ISR_ClearPending();
-                    ENBL_TRIG_ISR_Write(REG_ON);
-                    //STAGE_WAIT_REG_Write(REG_ON);
+    uint32 start = isr_stats_enter();
 
-
-                   
-                //}
-            } else {
-            //if (phases > 14){
-                phases = 0;
-                //strcpy(msg, "\nphases = 0\n");
-                /* Wait until component is ready to send data to host. */
-                //while (0u == USBUART_CDCIsReady())
-                //{
-                //}
-                /* Send MSG back to host. */
-                //USBUART_PutData((uint8*)msg, strlen(msg));
-                
-                if(mode == Z_MODE){
-                    
-                    if (zCount < zSteps) {
-                        
-
-                        //outgoing.flags |= SEND_TRIGG;
-                        STAGE_REG_Write(REG_ON);
-                        STAGE_REG_Write(REG_OFF);
-                        zCount++;
-                        ENBL_TRIG_ISR_Write(REG_ON);
-                        //TRIG_ISR_ClearPending();// Trying to see if this reduces stage movements.
-                    } else {
-                        ENBL_TRIG_ISR_Write(REG_OFF); 
-                        //STAGE_WAIT_REG_Write(REG_ON);
-                        zCount = 0;
-                        msgFlag |= Z_FIN;
-                    }
-                } else if(mode == COUNT_MODE){
-                    if(count_itt < frameCount){
-                        count_itt += 1;
-                        ENBL_TRIG_ISR_Write(REG_OFF);
-                        ENBL_TRIG_ISR_Write(REG_ON);
-                    } else {
-                        count_itt = 0;
-                        ENBL_TRIG_ISR_Write(REG_OFF);
-                        msgFlag |= COUNT_FIN;
-                    }
-                } else {
-                    ENBL_TRIG_ISR_Write(REG_OFF);
-                    ENBL_TRIG_ISR_Write(REG_ON);
-                }                           
-            }
-            break;
-    }
+    seq_frame_done();
+    isr_stats_exit(start);
+}
+#if (SLM_STAGE_READY)
+CY_ISR(S_ISR){
+    seq_stage_ready();
 }
+#endif
+#if (SLM_TIME_CNT)
+CY_ISR(TM_ISR){
+    seq_time_up();
+}
+#endif
 // read input prototype
 void read_input(volatile struct usb_data* buf, const char cmd);
 void set_mode(uint8 buf);
 void set_sim_mode(uint8 buf);
 void set_laser_mode(uint8 laser_mode);
 void set_capMode(uint32 buf);
-void setExposure(void);
-void userSetExposure(void);
-void setWaitTime(void);
-void readTime(void);
+void report_timing(void);
+void apply_command(void);
 
 int main()
 {
@@ -436,11 +171,14 @@ int main()
     outgoing.count = 0;
     outgoing.exposure = exposure;
     //uint16 count;
+    uint8 rx;
+    struct usb_cmd cmd;
     
 #if (CY_PSOC3 || CY_PSOC5LP)
     
     LCD_Char_Start();
 #endif /* (CY_PSOC3 || CY_PSOC5LP) */
+    lcd_init();
     
     CyGlobalIntEnable;
 
@@ -451,7 +189,14 @@ int main()
     BLANKING_DELAY_Start();
     STAGE_TRIG_Start();
     STAGE_WAIT_Start();
+    ts_init();
     TRIG_ISR_StartEx(T_ISR);
+#if (SLM_STAGE_READY)
+    STAGE_READY_ISR_StartEx(S_ISR);
+#endif
+#if (SLM_TIME_CNT)
+    TIME_ISR_StartEx(TM_ISR);
+#endif
 
     /* Start USBFS operation with 5V operation. */
     USBFS_Start(USBFS_DEVICE, USBFS_5V_OPERATION);
@@ -461,7 +206,7 @@ int main()
     }
     
     /* Enable OUT endpoint to receive data from host. */
-    USBFS_EnableOutEP(OUT_EP_NUM);
+    usb_link_init();
     //CyDelay(1000);
     /* Service USB CDC when device is configured. */
     //if (0u != USBUART_GetConfiguration())
@@ -481,20 +226,17 @@ int main()
     TRIG_CNT_RST_Write(REG_OFF);
     ACTIVATE_SLM_Write(REG_OFF);
     STAGE_REG_Write(REG_OFF);
-    BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-    STAGE_WAIT_WritePeriod(38000);
-    STAGE_TRIG_WritePeriod(12000);
+    setBlankingDelay();
+    stageWaitTicks = STAGE_SETTLE_TICKS;
+    STAGE_TRIG_WritePeriod(STAGE_PULSE_TICKS);
     BLANK_TOGGLE_Write(BLANK_OFF);
     
-    LCD_Char_Position(0u, 0u);
-    LCD_Char_PrintString("Mode: Count");
-    LCD_Char_Position(0u, 11u);
-    LCD_Char_PrintString("FPS: 5.0");
-    LCD_Char_Position(1u, 0u);
-    LCD_Char_PrintString(TRIGG_OFF);
-    LCD_Char_Position(1u, 10u);
-    LCD_Char_PrintString("Blank: Off");
+    lcd_print(0u, 0u, "Mode: Count");
+    lcd_print(0u, 11u, "FPS: 5.0");
+    lcd_print(1u, 0u, TRIGG_OFF);
+    lcd_print(1u, 10u, "Blank: Off");
     setExposure();
+    report_timing();
     for(;;)
     {
         /* Check if configuration is changed. */
@@ -504,288 +246,309 @@ int main()
             if (0u != USBFS_GetConfiguration())
             {
                 /* Enable OUT endpoint to receive data from host. */
-                USBFS_EnableOutEP(OUT_EP_NUM);
+                usb_link_init();
             }
         }
         
-                /* Check if data was received. */
-        if (USBFS_OUT_BUFFER_FULL == USBFS_GetEPState(OUT_EP_NUM))
+        /* Check if a command packet has been copied in, never waits on the host */
+        rx = usb_link_poll_out();
+        if (rx == USB_RX_LEGACY)
         {
-            /* Read number of received data bytes. */
-            //length = USBFS_GetEPCount(OUT_EP_NUM);
-
-            /* Trigger DMA to copy data from OUT endpoint buffer. */
-
-            USBFS_ReadOutEP(OUT_EP_NUM, (uint8*)&incoming, sizeof(struct usb_data));
-            /*if(incoming.flags & SEND_TRIGG){
-                    SOFT_TRIG_Reg_Write(REG_ON);
-                    CyDelayUs(100);
-                    SOFT_TRIG_Reg_Write(REG_OFF);
-                    incoming.flags &= ~(SEND_TRIGG);
-                    outgoing.flags |= TRIGG_SENT;
-            }*/
-
-                if(incoming.flags & STAGE_MOVE_COMPLETE){
-                    ENBL_TRIG_ISR_Write(REG_ON);
-                    incoming.flags &= ~(STAGE_MOVE_COMPLETE);
-                }
-                if(incoming.flags & CHANGE_FPS){
-                    outgoing.fps = incoming.fps;
-                    read_input(&incoming, 'a');
-                    SLM_WAIT_WritePeriod(wait_time_ticks);
-                    
-                    incoming.flags &= ~(CHANGE_FPS);
-                }
-                if(incoming.flags & CHANGE_Z_STEPS){
-                    outgoing.steps = incoming.steps;
-                    read_input(&incoming, 'b');
-                    
-                    incoming.flags &= ~(CHANGE_Z_STEPS);
-                }
-                    //read_input(buffer, 'c');
-                    /* Enter Vertical size of crop */
-                    //read_input(buffer, 'd');
-                    //readTime();
-                    //SLM_WAIT_WritePeriod(wait_time_ticks);
-                if(incoming.flags & SET_READOUT_SPEED){
-                    /* Change Hammamatsu Camera readout speed */
-                    /**** currently just set to Andor readout since andor is REALLLLLY SLOWWWWWWWWWWWW ****/
-                    /**** Need to update Settings for slower sensor readout for even less exposure time ***/
-                    set_capMode(incoming.flags&SLOW_READOUT);
-                    if(laser_conf == BLUE_LASER){
-                        if(capMode == CAP_MODE_NORMAL){
-                            horzPeriod = ANDOR_30_MHZ_HORZ;
-                            BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-                        } else {
-                            horzPeriod = ANDOR_30_MHZ_HORZ;
-                            BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-                        }
-                    } else if (laser_conf == GREEN_LASER){
-                        horzPeriod = ANDOR_30_MHZ_HORZ;
-                        BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS); 
-                    } else {
-                        //horzPeriod = 0;
-                        BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-                    }
-                    setExposure();
-                    SLM_WAIT_WritePeriod(wait_time_ticks);
-                    incoming.flags &= ~SET_READOUT_SPEED;
-                }
-                
-                if(incoming.flags & SET_RUN_MODE){
-                    /* Select between, Free Run, Z-stack and timed mode */
-                    set_mode(incoming.mode);
-                    incoming.flags &= ~SET_RUN_MODE;
-                }
-                if(incoming.flags & START_CAPTURE){
-                    if(!ENBL_TRIG_ISR_Read()){
-                        count_itt = 0;
-                        phases = 0;
-                        angles = 0;
-                        zCount = 0;
-                        axCount = 0;
-                        if(laser_conf == BOTH_LASERS){
-                            CAM_SEL_REG_Write(GREEN_LASER);
-                        }
-                    }
-                    ENBL_TRIG_ISR_Write(REG_ON);
-                    LCD_Char_Position(1u,0u);
-                    LCD_Char_PrintString(TRIGG_ON);
-                    incoming.flags &= ~START_CAPTURE;
-                }
-                if(incoming.flags & STOP_CAPTURE){
-                    ENBL_TRIG_ISR_Write(REG_OFF);
-                    LCD_Char_Position(1u,0u);
-                    LCD_Char_PrintString(TRIGG_OFF);
-                    incoming.flags &= ~STOP_CAPTURE;
-                }
-                if(incoming.flags & TOGGLE_BLANKING){
-                /* Toggle Laser Blanking */
-                    if(incoming.mode & START_BLANKING){
-                        BLANK_TOGGLE_Write(BLANK_ON);
-                        strcpy(msg, "\n\n****Blanking On****\n\n");
-                        LCD_Char_Position(1u,10u);
-                        LCD_Char_PrintString("Blank: On ");
-                    } else {
-                        BLANK_TOGGLE_Write(BLANK_OFF);
-                        strcpy(msg, "\n\n****Blanking Off****\n\n");
-                        LCD_Char_Position(1u,10u);
-                        LCD_Char_PrintString("Blank: Off");
-                    }
-                    incoming.flags &= ~TOGGLE_BLANKING;
-                }
-                if(incoming.flags & SET_SIM_MODE){
-                    /* For Z stack capture set 2 beam 3 beam or no sim */                        
-                    set_sim_mode(incoming.mode);
-                    incoming.flags &= ~SET_SIM_MODE;
-                }
-                    //case 'k': /* Print Out Current Configuration */
-                        //if(ENBL_TRIG_ISR_Read()){
-                        //    sprintf(msg, "\n\nTrigger: Running\n");   
-                        //} else {
-                        //    sprintf(msg, "\n\nTrigger: Stopped\n");                             
-                        //}
-                        
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));                        
-                        
-                        //if(capMode == CAP_MODE_NORMAL){
-                        //    sprintf(msg, "Camera Readout Mode: Normal\n");
-                        //} else {
-                        //     sprintf(msg, "Camera Readout Mode: SLOW\n");   
-                        //}
-                        /* Send  OPTIONS. */
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));
-                        
-                        //if(mode == 0){
-                        //    sprintf(msg, "Mode: Free Run\n");
-                        //} else if (mode == 1){
-                        //    sprintf(msg, "Mode: Z-Stack\n");
-                        //} else {
-                        //    sprintf(msg, "Mode: Timed\n");
-                        //}
-                        
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));
-                        
-                        //if(simMode == 0){
-                        //    sprintf(msg, "SIM Mode: Three Beam\n");
-                        //} else if(simMode == TWO_BEAM) {
-                        //    sprintf(msg, "SIM Mode: Two Beam\n");    
-                        //} else if(simMode == NO_SIM_Z_ONLY){
-                        //    sprintf(msg, "SIM Mode: Z-only\n");   
-                        //} else {
-                        //    sprintf(msg, "SIM Mode: Single Angle\n");  
-                        //}
-                        
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));
-                        
-                        //if(BLANK_TOGGLE_Read()){
-                        //    sprintf(msg, "Blanking: Off\n");
-                        //} else {
-                        //    sprintf(msg, "Blanking: On\n");
-                        //}
-                        
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));                        
-                        
-                        //sprintf(msg, "FPS: %.3f\n", fps_in);
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));
-                        
-                        //sprintf(msg, "exposure time: %.6f (sec)\n", exposure);                        
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));
-                        
-                        //sprintf(msg, "Z-steps: %u\n", zSteps);
-                        
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));
+            apply_command();
+        }
+        else if (rx == USB_RX_BATCH)
+        {
+            /* Apply a batch record by record, in order, acking each */
+            while (usb_cmd_next(&cmd))
+            {
+                uint8 status = usb_cmd_load(&cmd, &incoming);
 
-                        //if(laser_conf == BLUE_LASER){
-                        //    sprintf(msg, "Blue Laser\n");  
-                        //} else if (laser_conf == GREEN_LASER){
-                        //    sprintf(msg, "Green Laser\n");
-                        //} else {
-                        //    sprintf(msg, "Both Lasers Alternateing\n");   
-                        //}
-                        
-                        /* Wait until component is ready to send data to host. */
-                        //while (0u == USBUART_CDCIsReady())
-                        //{
-                        //}
-                        //USBUART_PutData((uint8*)msg, strlen(msg));
-                        //break;
-                if(incoming.flags & SET_EXPOSURE){
-                    /* Set User specified exposure time */
-                    read_input(&incoming,'l');
-                    incoming.flags &= ~SET_EXPOSURE;
-                    //SLM_WAIT_WritePeriod(wait_time_ticks);
-                }
-                if(incoming.flags & SET_LASER_MODE){
-                    /* Select Laser Mode */
-                    set_laser_mode(incoming.mode);
-                    incoming.flags &= ~SET_LASER_MODE;
+                if (status == CMD_OK)
+                {
+                    apply_command();
                 }
-           
+                usb_cmd_ack(cmd.seq, status);
+            }
         }
-        /* Trigger DMA to copy data into IN endpoint buffer.
-        * After data has been copied, IN endpoint is ready to be read by the
-        * host.
-        */
-        
-          
-            //outgoing.time_waiting = time_btwn_trig;
-            //outgoing.fps = current_fps;
-        uint8 sent = 0;
-        
-                /* Wait until DMA completes copying data from OUT endpoint buffer. */
-        while (USBFS_OUT_BUFFER_FULL == USBFS_GetEPState(OUT_EP_NUM))
+        if (rx != USB_RX_NONE)
         {
+            usb_link_trace_out();
+            trace_state();
+        }
+        //++outgoing.count;
+        uint8 events = seq_take_events() | sched_poll();
+        if(events & STAGE_REQ){
+            outgoing.flags |= SEND_TRIGG;
+        }
+        if(events & Z_FIN){
+            outgoing.flags |= STOP_Z_STACK;
+        }
+        if(events & (COUNT_FIN | TIMED_FIN)){
+            outgoing.flags |= STOP_COUNT;
+        }
+        if(events & TIMED_FIN){
+            /* TIME_CNT gated a timed schedule off, the DMA is still armed */
+            sched_stop();
         }
-        
-        /* Enable OUT endpoint to receive data from host. */
-        USBFS_EnableOutEP(OUT_EP_NUM);
 
-        /* Wait until IN buffer becomes empty (host has read data). */
-        while (USBFS_IN_BUFFER_EMPTY != USBFS_GetEPState(IN_EP_NUM))
+        /* Acks, timestamps and any status that is due, once the host has read the last packet */
+        usb_link_poll_in();
+
+        /* The display only gets the loop when nothing else wants it */
+        if (rx == USB_RX_NONE && !events)
         {
+            lcd_task();
         }
-        
-        if(outgoing.flags & (SEND_TRIGG|STOP_Z_STACK|CHANGE_FPS|SET_EXPOSURE|STOP_COUNT)){
-            sent = 1;
-        }
-            USBFS_LoadInEP(IN_EP_NUM, (uint8*)&outgoing, sizeof(struct usb_data));
-            /* (USBFS_GEN_16BITS_EP_ACCESS) */
-            //outgoing.flags &= ~(NEW_CNT);
-        if(sent){    
-            outgoing.flags &= ~(STOP_Z_STACK|SEND_TRIGG|CHANGE_FPS|SET_EXPOSURE|STOP_COUNT);
+    }
+}
+
+// helper functions
+/* Acts on the flags in incoming, from a legacy packet or a batch record */
+void apply_command(void){
+    struct timing_verdict verdict;
+
+    /*if(incoming.flags & SEND_TRIGG){
+            SOFT_TRIG_Reg_Write(REG_ON);
+            CyDelayUs(100);
+            SOFT_TRIG_Reg_Write(REG_OFF);
+            incoming.flags &= ~(SEND_TRIGG);
+            outgoing.flags |= TRIGG_SENT;
+    }*/
+
+    if(incoming.flags & STAGE_MOVE_COMPLETE){
+        seq_stage_move_complete();
+        incoming.flags &= ~(STAGE_MOVE_COMPLETE);
+    }
+    if(incoming.flags & SET_STAGE_HANDSHAKE){
+        outgoing.bonus = seq_set_stage_handshake(incoming.mode);
+        incoming.flags &= ~SET_STAGE_HANDSHAKE;
+    }
+    if(incoming.flags & TRACE_CAPTURE){
+        if(incoming.mode){
+            trace_start();
+        } else {
+            trace_stop();
         }
-        //CyDelayUs(250); 
+        incoming.flags &= ~TRACE_CAPTURE;
+    }
+    if(incoming.flags & SET_STATUS_RATE){
+        usb_set_status_period(incoming.count, incoming.mode);
+        incoming.flags &= ~SET_STATUS_RATE;
+    }
+    if(incoming.flags & PROGRAM_STEP){
+        outgoing.bonus = seq_set_prog_step((uint8)incoming.steps, incoming.mode, incoming.bonus);
+        incoming.flags &= ~PROGRAM_STEP;
+    }
+    if(incoming.flags & SET_CHANNEL){
+        outgoing.bonus = seq_set_chan((uint8)incoming.steps, incoming.mode,
+                                      (uint16)incoming.count, incoming.bonus);
+        setBlankingDelay();
+        setExposure();
+        incoming.flags &= ~SET_CHANNEL;
+    }
+    if(incoming.flags & SET_PLANE){
+        outgoing.bonus = seq_set_plane((uint8)incoming.steps, incoming.mode,
+                                       incoming.bonus, incoming.count);
+        incoming.flags &= ~SET_PLANE;
+    }
+    if(incoming.flags & SET_EXPO_SLOT){
+        outgoing.bonus = seq_set_expo((uint8)incoming.steps, incoming.mode, incoming.count);
+        incoming.flags &= ~SET_EXPO_SLOT;
+    }
+    if(incoming.flags & CHANGE_FPS){
+        outgoing.fps = incoming.fps;
+        read_input(&incoming, 'a');
         
-        //++outgoing.count;
-        switch(msgFlag){
-            case Z_FIN:
-                msgFlag &= ~Z_FIN;
-                outgoing.flags |= STOP_Z_STACK;
-                break;
-            case COUNT_FIN:
-                msgFlag &= ~COUNT_FIN;
-                outgoing.flags |= STOP_COUNT;
-                break;
-            default:
-                break;
+        incoming.flags &= ~(CHANGE_FPS);
+    }
+    if(incoming.flags & CHANGE_Z_STEPS){
+        outgoing.steps = incoming.steps;
+        read_input(&incoming, 'b');
+        
+        incoming.flags &= ~(CHANGE_Z_STEPS);
+    }
+        //read_input(buffer, 'c');
+        /* Enter Vertical size of crop */
+        //read_input(buffer, 'd');
+        //readTime();
+        //SLM_WAIT_WritePeriod(wait_time_ticks);
+    if(incoming.flags & SET_READOUT_SPEED){
+        /* Change camera readout speed, row time comes from the build's camera profile */
+        set_capMode(incoming.flags&SLOW_READOUT);
+        setBlankingDelay();
+        setExposure();
+        incoming.flags &= ~SET_READOUT_SPEED;
+    }
+    
+    if(incoming.flags & SET_RUN_MODE){
+        /* Select between, Free Run, Z-stack and timed mode */
+        set_mode(incoming.mode);
+        incoming.flags &= ~SET_RUN_MODE;
+    }
+    if(incoming.flags & START_CAPTURE){
+        /* A sequence that can't keep its frame doesn't start, bonus says why */
+        outgoing.bonus = seq_check_timing(&verdict);
+        if(outgoing.bonus){
+            lcd_print(1u, 0u, TRIGG_BAD);
+        } else if((incoming.flags & SCHED_CAPTURE) && !ENBL_TRIG_ISR_Read()
+            && !sched_running && sched_compile()){
+            sched_start();
+            lcd_print(1u, 0u, TRIGG_ON);
+        } else if(seq_start()){
+            lcd_print(1u, 0u, TRIGG_ON);
+        } else {
+            outgoing.bonus = SEQ_REFUSED;
+            lcd_print(1u, 0u, TRIGG_BAD);
         }
+        incoming.flags &= ~(START_CAPTURE | SCHED_CAPTURE);
+    }
+    if(incoming.flags & STOP_CAPTURE){
+        sched_stop();
+        seq_stop();
+        lcd_print(1u, 0u, TRIGG_OFF);
+        incoming.flags &= ~STOP_CAPTURE;
+    }
+    if(incoming.flags & TOGGLE_BLANKING){
+    /* Toggle Laser Blanking */
+        if(incoming.mode & START_BLANKING){
+            BLANK_TOGGLE_Write(BLANK_ON);
+            lcd_print(1u, 10u, "Blank: On ");
+        } else {
+            BLANK_TOGGLE_Write(BLANK_OFF);
+            lcd_print(1u, 10u, "Blank: Off");
+        }
+        incoming.flags &= ~TOGGLE_BLANKING;
+    }
+    if(incoming.flags & SET_SIM_MODE){
+        /* For Z stack capture set 2 beam 3 beam or no sim */                        
+        set_sim_mode(incoming.mode);
+        incoming.flags &= ~SET_SIM_MODE;
+    }
+        //case 'k': /* Print Out Current Configuration */
+            //if(ENBL_TRIG_ISR_Read()){
+            //    sprintf(msg, "\n\nTrigger: Running\n");   
+            //} else {
+            //    sprintf(msg, "\n\nTrigger: Stopped\n");                             
+            //}
+            
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));                        
+            
+            //if(capMode == CAP_MODE_NORMAL){
+            //    sprintf(msg, "Camera Readout Mode: Normal\n");
+            //} else {
+            //     sprintf(msg, "Camera Readout Mode: SLOW\n");   
+            //}
+            /* Send  OPTIONS. */
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));
+            
+            //if(mode == 0){
+            //    sprintf(msg, "Mode: Free Run\n");
+            //} else if (mode == 1){
+            //    sprintf(msg, "Mode: Z-Stack\n");
+            //} else {
+            //    sprintf(msg, "Mode: Timed\n");
+            //}
+            
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));
+            
+            //if(simMode == 0){
+            //    sprintf(msg, "SIM Mode: Three Beam\n");
+            //} else if(simMode == TWO_BEAM) {
+            //    sprintf(msg, "SIM Mode: Two Beam\n");    
+            //} else if(simMode == NO_SIM_Z_ONLY){
+            //    sprintf(msg, "SIM Mode: Z-only\n");   
+            //} else {
+            //    sprintf(msg, "SIM Mode: Single Angle\n");  
+            //}
+            
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));
+            
+            //if(BLANK_TOGGLE_Read()){
+            //    sprintf(msg, "Blanking: Off\n");
+            //} else {
+            //    sprintf(msg, "Blanking: On\n");
+            //}
+            
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));                        
+            
+            //sprintf(msg, "FPS: %.3f\n", fps_in);
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));
+            
+            //sprintf(msg, "exposure time: %.6f (sec)\n", exposure);                        
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));
+            
+            //sprintf(msg, "Z-steps: %u\n", zSteps);
+            
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));
+
+            //if(laser_conf == BLUE_LASER){
+            //    sprintf(msg, "Blue Laser\n");  
+            //} else if (laser_conf == GREEN_LASER){
+            //    sprintf(msg, "Green Laser\n");
+            //} else {
+            //    sprintf(msg, "Both Lasers Alternateing\n");   
+            //}
+            
+            /* Wait until component is ready to send data to host. */
+            //while (0u == USBUART_CDCIsReady())
+            //{
+            //}
+            //USBUART_PutData((uint8*)msg, strlen(msg));
+            //break;
+    if(incoming.flags & SET_EXPOSURE){
+        /* Set User specified exposure time */
+        read_input(&incoming,'l');
+        incoming.flags &= ~SET_EXPOSURE;
+        //SLM_WAIT_WritePeriod(wait_time_ticks);
+    }
+    if(incoming.flags & SET_LASER_MODE){
+        /* Select Laser Mode */
+        set_laser_mode(incoming.mode);
+        incoming.flags &= ~SET_LASER_MODE;
     }
+    if(incoming.flags & READ_ISR_STATS){
+        usb_queue_isr_stats();
+        incoming.flags &= ~READ_ISR_STATS;
+    }
+    if(incoming.flags & RESET_ISR_STATS){
+        isr_stats_reset();
+        incoming.flags &= ~RESET_ISR_STATS;
+    }
+    report_timing();
 }
 
-// helper functions
 void read_input(volatile struct usb_data* buf, const char cmd){
 
     //double time_s;
@@ -794,22 +557,21 @@ void read_input(volatile struct usb_data* buf, const char cmd){
             
             if(buf->fps > 0.0f){
                fps_in = buf->fps;
-               double period = 1 / fps_in;
-               frameTicks = (uint32)(period / COUNT_PERIOD);
+               frameTicks = fpsToTicks(fps_in);
             } else {
                 outgoing.fps = fps_in;
+                outgoing.mode = frameLimit;
                 outgoing.flags |= CHANGE_FPS;
             }
             //exposureTicks = frameTicks - SLM_CNTR_TICKS - HAMA_SLOW_READ - SLM_TRG_TICKS;
             setExposure();
-            sprintf(msg, "\n\nSetting: %.1f, frameTicks: %lu, exposure: %.6f (sec)\n\n", fps_in, frameTicks, exposure);
             
-            sprintf(line0, "FPS: %.1f", fps_in);
-            LCD_Char_Position(0u, 11u);
-            LCD_Char_PrintString(line0);
+            fmt_fps(fmt_str(line0, "FPS: "), frameTicks, 1u);
+            lcd_print(0u, 11u, line0);
             break;
         case 'b':
             zSteps = buf->steps;
+            plane_clear();
             break;
         /*case 'c':
             time_s = strtof(val_str, NULL);
@@ -824,7 +586,7 @@ void read_input(volatile struct usb_data* buf, const char cmd){
         case 'l':
             if(buf->exposure > 0.0f){
                 exposure = buf->exposure;
-                userSetExposure();
+                userSetExposure(incoming.mode & ARB_EXP);
             } else {
                 outgoing.exposure = exposure;
                 outgoing.flags |= SET_EXPOSURE;
@@ -832,59 +594,39 @@ void read_input(volatile struct usb_data* buf, const char cmd){
             //sprintf(msg, "\n\nSetting exposure: %.6f, exposureTicks: %lu\n\n", exposure, exposureTicks);
             break;
         default:
-            sprintf(msg, "\n\n****something wrong has happened****\n\n");
             break;
     }
 }
 
 void set_mode(uint8 buf){
+    char* p;
 
-    mode = buf;   
-    sprintf(msg, "\n\nMode: %u\n", mode);
+    /* TIMED_TO_SET_END rides in the top bit */
+    seq_set_run_mode(buf);
 
     if(mode == FREE_RUN){
-        sprintf(line0, "Mode: Free FPS: %.1f", fps_in);
+        p = fmt_str(line0, "Mode: Free FPS: ");
     } else if(mode == Z_MODE){
-        sprintf(line0, "Mode: Z-St FPS: %.1f", fps_in);
+        p = fmt_str(line0, "Mode: Z-St FPS: ");
+    } else if(mode == TIMED_MODE){
+        /* count is the capture time in 2MHz ticks */
+        time_ticks = incoming.count;
+        p = fmt_str(line0, "Mode: Timed FPS: ");
     } else {
        frameCount = incoming.count;
        incoming.mode &= ~COUNT_MODE;
-       sprintf(line0, "Mode: Count FPS: %.1f", fps_in);   
+       p = fmt_str(line0, "Mode: Count FPS: ");
     }
+    fmt_fps(p, frameTicks, 1u);
     
-    LCD_Char_Position(0u, 0u);
-    LCD_Char_PrintString(line0);
+    lcd_print(0u, 0u, line0);
     
 }
 
 void set_sim_mode(uint8 buf){
 
-    simMode = buf;   
+    seq_set_sim_mode(buf);
 
-    if(simMode == TWO_BEAM){
-        phase_max = TWO_BEAM_MAX;
-        sprintf(msg, "\n\nSIM Mode: TWO BEAM\n");
-    } else if(simMode == THREE_BEAM) {
-        phase_max = THREE_BEAM_MAX;
-        sprintf(msg, "\n\nSIM Mode: THREE BEAM\n");           
-    } else if (simMode == NO_SIM_Z_ONLY){
-        phase_max = NO_BEAM_MAX;
-        sprintf(msg, "\n\nSIM Mode: Z-Only\n");
-    } else if (simMode == SINGLE_ANGLE) {
-        phase_max = SINGLE_ANGLE_MAX;
-        sprintf(msg, "\n\nSIM Mode: SINGLE ANGLE\n");
-    } else if (simMode == SEVEN_PHASE){
-        phase_max = 21;
-        sprintf(msg, "\n\nSIM Mode: SEVEN_PHASE\n");
-    } else if (simMode == SEVEN_FREE){
-        phase_max = 21;
-        sprintf(msg, "\n\nSIM Mode: SEVEN_FREE\n");  
-    } else {
-        phase_max = NO_BEAM_MAX;
-        simMode = NO_SIM_Z_ONLY;
-        phase_max = 1;
-        sprintf(msg, "\n\nSIM Mode: Z-Only\n");
-    }
     /*if(mode == 0){
         sprintf(line0, "Mode: Free FPS: %.1f", fps_in);
     } else if(mode == 1){
@@ -905,29 +647,12 @@ void set_sim_mode(uint8 buf){
 
 
 void set_laser_mode(uint8 laser_mode){
-    laser_conf = laser_mode;   
-    if(laser_conf == BLUE_LASER){
-        CAM_SEL_REG_Write(BLUE_LASER);
-        if(capMode == CAP_MODE_NORMAL){
-            horzPeriod = ANDOR_30_MHZ_HORZ;
-            if(capMode == CAP_MODE_NORMAL){
-                BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-            } else {
-                BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);    
-            }
-        } else {
-            horzPeriod = ANDOR_30_MHZ_HORZ;
-            BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);
-        }
-    } else if(laser_conf == GREEN_LASER){
-        CAM_SEL_REG_Write(GREEN_LASER);
-        BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);               
-    } else {
-        // Try Set Readout Time to 0
-        //horzPeriod = 0;
-        CAM_SEL_REG_Write(GREEN_LASER);
-        BLANKING_DELAY_WritePeriod(ANDOR_DELAY_TICKS);    
+    /* GREEN_LASER, or BOTH_LASERS starting on green; not under a capture */
+    if(!chan_set_laser(laser_mode)){
+        return;
     }
+    laser_conf = laser_mode;
+    setBlankingDelay();
     setExposure();    
 }
 
@@ -940,123 +665,18 @@ void set_capMode(uint32 buf){
     }
 }
 
-void setExposure(void){
-    readTime();
-    exposureMax = 1 / fps_in - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-    if(exposureMax < 0){
-        if(capMode == CAP_MODE_NORMAL){
-            exposureMax = 1 / FIFTEEN - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-            fps_in = FIFTEEN;
-            //sprintf(msg, "\n***Timing error setting to 10fps***\n");
-            //while (0u == USBUART_CDCIsReady())
-            //{
-            //}
-            /* Send Messege */
-            //USBUART_PutData((uint8*)msg, strlen(msg));
-        } else {
-            exposureMax = 1 / FIFTEEN - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-            fps_in = FIFTEEN;
-            //sprintf(msg, "\n***Timing error setting to 10fps***\n");
-            //while (0u == USBUART_CDCIsReady())
-            //{
-            //}
-            /* Send Messege */
-            //USBUART_PutData((uint8*)msg, strlen(msg));
-        }
-        
-        if(laser_conf == GREEN_LASER){
-            exposureMax = 1 / FIFTEEN - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-            fps_in = FIFTEEN;
-            //sprintf(msg, "\n***Timing error setting to 10fps***\n");
-            //while (0u == USBUART_CDCIsReady())
-            //{
-            //}
-            /* Send Messege */
-            //USBUART_PutData((uint8*)msg, strlen(msg));               
-        } else /*if (laser_conf == BOTH_LASERS)*/{
-            exposureMax = 1 / FIFTEEN - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-            fps_in = FIFTEEN;
-            //sprintf(msg, "\n***Timing error setting to 48fps***\n");
-            //while (0u == USBUART_CDCIsReady())
-            //{
-            //}
-            /* Send Messege */
-            //USBUART_PutData((uint8*)msg, strlen(msg)); 
-        }
-        outgoing.fps = fps_in;
-        outgoing.flags |= CHANGE_FPS;
-    }
-    
-
-    
-    exposure = exposureMax;
-    outgoing.exposure = exposure;
-    outgoing.flags |= SET_EXPOSURE;
-    exposureTicks = (uint32)(exposure/COUNT_PERIOD);
-    TRG_CNT_WritePeriod(exposureTicks);
-    TRIG_CNT_RST_Write(REG_ON);
-    TRIG_CNT_RST_Write(REG_OFF);
-    setWaitTime();
-    
-}
-
-void userSetExposure(void){
-    //readTime();
-    if(!(incoming.mode&ARB_EXP)){
-        exposureMax = 1 / fps_in - readOutTime - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
-        if(exposureMax < exposure){
-            exposure = exposureMax;
-            outgoing.exposure = exposure;
-            outgoing.flags |= SET_EXPOSURE;
-            //sprintf(msg, "\n\nExposure too long setting to exposureMax\n");
-            //while (0u == USBUART_CDCIsReady())
-            //{
-            //}
-            /* Send Messege */
-            //USBUART_PutData((uint8*)msg, strlen(msg));
-        }
-    } else {
-        fps_in = 1/(exposure + readOutTime - ((double)SLM_CNTR_TICKS)*COUNT_PERIOD/2);
+/* Echo timing the core had to change back to the host */
+void report_timing(void){
+    if(timingMsg & FPS_CHANGED){
         outgoing.fps = fps_in;
+        outgoing.mode = frameLimit;
         outgoing.flags |= CHANGE_FPS;
-        exposureTicks = (uint32)(exposure/COUNT_PERIOD);
     }
-    TRG_CNT_WritePeriod(exposureTicks);
-    TRIG_CNT_RST_Write(REG_ON);
-    TRIG_CNT_RST_Write(REG_OFF);
-    setWaitTime();
-    
-}
-
-void setWaitTime(void){
-    double float_ticks = (readOutTime / COUNT_PERIOD) - (double)SLM_CNTR_TICKS / 2.0f;
-    
-    if(float_ticks <= 0 /*|| laser_conf == BOTH_LASERS*/){
-        wait_time_ticks = SLM_CNTR_TICKS + STUPID;
-    } else {
-        wait_time_ticks = (uint32)(readOutTime / COUNT_PERIOD) - SLM_TRG_TICKS / 2 + STUPID;
+    if(timingMsg & EXP_CHANGED){
+        outgoing.exposure = exposure;
+        outgoing.flags |= SET_EXPOSURE;
     }
-    
-    //if(laser_conf == BOTH_LASERS){
-        uint32 remain_ticks = frameTicks - exposureTicks - SLM_TRG_TICKS;
-        if(wait_time_ticks < remain_ticks){
-             wait_time_ticks = remain_ticks + STUPID;   
-        }
-        if(wait_time_ticks < SLM_CNTR_TICKS){
-            wait_time_ticks = SLM_CNTR_TICKS + STUPID;
-        }
-    //}
-    //sprintf(msg, "\nwait_time_ticks: %lu\nexposure: %.6f\n", wait_time_ticks, exposure);
-    //while (0u == USBUART_CDCIsReady())
-    //{
-    //}
-    /* Send Messege */
-    //USBUART_PutData((uint8*)msg, strlen(msg));
-}
-
-void readTime(void){
-    //readOutTime = (vert/2.0 + 10)*horzPeriod;
-    readOutTime = (vert + 10)*horzPeriod + 0.0064;// 64 is a fudge to see if we can obey andor readout timing
+    timingMsg = 0;
 }
 
 /* [] END OF FILE */
@@ -0,0 +1,85 @@
+/*******************************************************************************
+* File Name: slm_camera.h
+*
+* Description:
+*   Camera profiles.  Everything that used to differ between the three
+*   main.c copies (row time, rows per row time, readout fudge and
+*   BLANKING_DELAY) is a const struct cam_profile, with every value worked
+*   out in 2MHz ticks by the preprocessor.  The frame used when the readout
+*   does not fit the requested one is solved for (minFrameTicks()) instead
+*   of the fixed rate each copy had.
+*
+*   The camera is picked per build with a preprocessor definition in the
+*   .cyprj (or CAMERA= for the sim Makefile):
+*     SLM_CAMERA_HAMAMATSU  CAP_MODE_NORMAL / CAP_MODE_SLOW readout
+*     SLM_CAMERA_ANDOR      Andor 30MHz, the default
+*   CAM_ACTIVE() only reads capMode; with one profile per build (Andor) it
+*   folds to a constant address.
+*
+*******************************************************************************/
+
+#ifndef SLM_CAMERA_H
+#define SLM_CAMERA_H
+
+#include "slm_hw.h"
+
+#define TICKS_PER_SEC (2000000u)
+#define HORZ_Q (16u)
+
+#define CAP_MODE_NORMAL (0u)
+#define CAP_MODE_SLOW (1u)
+
+/* Row time in picoseconds -> 2MHz ticks in Q16, rounded */
+#define CAM_HORZ_Q16(ps) ((uint32)(((uint64)(ps) * TICKS_PER_SEC * 65536ull + 500000000000ull) / 1000000000000ull))
+#define CAM_US_TICKS(us) ((uint32)((us) * (TICKS_PER_SEC / 1000000u)))
+#define CAM_FPS_TICKS(fps) ((uint32)((TICKS_PER_SEC + (fps) / 2u) / (fps)))
+
+struct cam_profile{
+    uint32 horz;            // row time, Q16 ticks (seconds * TICKS_PER_SEC << HORZ_Q)
+    uint32 readFudge;       // added to every readout, ticks
+    uint16 blankDelay;      // BLANKING_DELAY period, BLUE_LASER route
+    uint16 blankDelayAlt;   // BLANKING_DELAY period, any other route
+    uint8 rowShift;         // readout is (vert >> rowShift) + 10 row times
+};
+
+/* Hamamatsu, normal readout: 2 rows per 9.74436us row time */
+static const struct cam_profile camHamaNormal = {
+    CAM_HORZ_Q16(9744360u), 0u, 195u, 536u, 1u
+};
+
+/* Hamamatsu, slow readout: 2 rows per 32.4812us row time */
+static const struct cam_profile camHamaSlow = {
+    CAM_HORZ_Q16(32481200u), 0u, 650u, 536u, 1u
+};
+
+/* Andor 30MHz.  55.47us measured, Andors Timing chart is bulshit (38.37us),
+*  plus 6.4ms to obey the readout timing.
+*/
+static const struct cam_profile camAndor30 = {
+    CAM_HORZ_Q16(55470000u), CAM_US_TICKS(6400u), 2048u, 2048u, 0u
+};
+
+#if defined(SLM_CAMERA_HAMAMATSU)
+#define CAM_NORMAL camHamaNormal
+#define CAM_SLOW camHamaSlow
+#define CAM_VERT_DEFAULT (2048u)
+#define CAM_MODE_DEFAULT CAP_MODE_NORMAL
+#define CAM_FPS_DEFAULT (30.0f)
+#define CAM_FRAME_DEFAULT CAM_FPS_TICKS(30u)
+#define CAM_NAME "hamamatsu"
+#else
+#define CAM_NORMAL camAndor30
+#define CAM_SLOW camAndor30
+#define CAM_VERT_DEFAULT (1024u)
+#define CAM_MODE_DEFAULT CAP_MODE_SLOW
+#define CAM_FPS_DEFAULT (10.0f)
+#define CAM_FRAME_DEFAULT CAM_FPS_TICKS(10u)
+#define CAM_NAME "andor_30mhz"
+#endif
+
+#define CAM_PROFILE(cap) (((cap) == CAP_MODE_SLOW) ? &CAM_SLOW : &CAM_NORMAL)
+#define CAM_ACTIVE() CAM_PROFILE(capMode)
+
+#endif /* SLM_CAMERA_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,147 @@
+/*******************************************************************************
+* File Name: slm_chan.c
+*
+* Description:
+*   Laser / camera channel table and the interleave walk shared by T_ISR and
+*   sched_compile(), see slm_chan.h.
+*
+*******************************************************************************/
+
+#include "slm_chan.h"
+#include "slm_seq.h"
+#include "slm_timing.h"
+
+/******** The Land Of Globals ********/
+struct laser_chan chanTable[CHAN_MAX] = {{BLUE_LASER, 0u}};
+uint8 chanCount = 1;
+uint8 chanOrder = CHAN_PER_PHASE;
+volatile uint8 chanActive = 0;      // last channel chan_apply() selected
+
+/*******************************************************************************
+* Function Name: chan_set
+********************************************************************************
+*
+* Summary:
+*  Stores one channel.  As with sequence program steps, writing index n
+*  makes the table n + 1 channels long, so channel 0 starts a new table.
+*  The order given with the last channel written is the one used.  The
+*  route and BLANKING_DELAY go back to channel 0 of the new table, where
+*  the next capture starts.
+*
+* Return:
+*  0 if a capture is running (seq_running()), the index or order is out of
+*  range or the channels are out of order.
+*
+*******************************************************************************/
+uint8 chan_set(uint8 index, uint8 sel, uint16 blankDelay, uint8 order){
+    if(seq_running() || index >= CHAN_MAX || index > chanCount || order >= CHAN_ORDER_COUNT){
+        return 0;
+    }
+    chanTable[index].sel = sel;
+    chanTable[index].blankDelay = blankDelay;
+    chanCount = index + 1u;
+    chanOrder = order;
+    chan_apply(0);
+    return 1;
+}
+
+/* SET_LASER_MODE: one laser, or BOTH_LASERS as green then blue per phase;
+*  0 while a capture is running, the table is left as it was
+*/
+uint8 chan_set_laser(uint8 laser){
+    if(seq_running()){
+        return 0;
+    }
+    if(laser == BOTH_LASERS){
+        chan_set(0, GREEN_LASER, 0, CHAN_PER_PHASE);
+        chan_set(1, BLUE_LASER, 0, CHAN_PER_PHASE);
+    } else {
+        chan_set(0, (laser == BLUE_LASER) ? BLUE_LASER : GREEN_LASER, 0, CHAN_PER_PHASE);
+    }
+    return 1;
+}
+
+void chan_rewind(struct chan_cursor* c){
+    c->chan = 0;
+    c->blk = 0;
+}
+
+/*******************************************************************************
+* Function Name: chan_advance
+********************************************************************************
+*
+* Summary:
+*  End of a frame inside a set.  Moves the cursor to the next frame's channel
+*  and returns the next frame's pattern position: pos + 1, or back to the
+*  start of the block when the block still has channels to go.  A block is
+*  one phase, angle phases of an angle, or the set, and always ends at max.
+*
+* Parameters:
+*  pos: pattern position of the frame that ended, below max.
+*  angle: phases per angle.
+*
+*******************************************************************************/
+uint8 chan_advance(struct chan_cursor* c, uint8 pos, uint8 max, uint8 angle){
+    uint8 block;
+
+    pos++;
+    if(chanCount < 2u){
+        return pos;
+    }
+    if(chanOrder == CHAN_PER_FRAME){
+        c->chan = (c->chan + 1u < chanCount) ? c->chan + 1u : 0u;
+        return pos;
+    }
+    block = (chanOrder == CHAN_PER_PHASE) ? 1u : (chanOrder == CHAN_PER_ANGLE) ? angle : max;
+    if(++c->blk >= block || pos == max){
+        if(++c->chan < chanCount){
+            pos -= c->blk;
+        } else {
+            c->chan = 0;
+        }
+        c->blk = 0;
+    }
+    return pos;
+}
+
+/* End of a set: the next set starts on channel 0, or the next channel per frame */
+void chan_set_end(struct chan_cursor* c){
+    c->blk = 0;
+    if(chanOrder == CHAN_PER_FRAME && chanCount > 1u){
+        c->chan = (c->chan + 1u < chanCount) ? c->chan + 1u : 0u;
+    } else {
+        c->chan = 0;
+    }
+}
+
+/* Route and blanking for the next frame, T_ISR or START_CAPTURE */
+void chan_apply(uint8 chan){
+    chanActive = chan;
+    HW_CAM_SEL_REG_WRITE(chanTable[chan].sel);
+    HW_BLANKING_DELAY_WRITE_PERIOD(chanBlankDelay(chan));
+}
+
+/*******************************************************************************
+* Function Name: chan_schedulable
+********************************************************************************
+*
+* Summary:
+*  The schedule DMA only writes the route, so every channel has to fit
+*  routeMask and share one BLANKING_DELAY period.
+*
+*******************************************************************************/
+uint8 chan_schedulable(uint8 routeMask){
+    uint8 i;
+
+    for(i = 0; i < chanCount; i++){
+        if(chanTable[i].sel & ~routeMask){
+            return 0;
+        }
+        if(chanBlankDelay(i) != chanBlankDelay(0)){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* [] END OF FILE */
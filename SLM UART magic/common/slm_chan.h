@@ -0,0 +1,62 @@
+/*******************************************************************************
+* File Name: slm_chan.h
+*
+* Description:
+*   Laser / camera channel table.  Each channel is a CAM_SEL_REG value and a
+*   BLANKING_DELAY period; a SIM set is shot in every channel of the table,
+*   the order deciding how the channels take turns:
+*     CHAN_PER_FRAME  next channel every frame, the pattern steps every frame
+*     CHAN_PER_PHASE  each pattern in every channel before the SLM moves on
+*                     (what BOTH_LASERS did for two)
+*     CHAN_PER_ANGLE  the phases of one angle in every channel in turn
+*     CHAN_PER_Z      the whole set in every channel before the stage steps
+*   The last frame of a set goes out on channel 0, as the green frame did
+*   with BOTH_LASERS, so a set is chanCount * phase_max + 1 frames
+*   (phase_max + 1 for CHAN_PER_FRAME).
+*
+*   SET_LASER_MODE still works and writes a one or two channel table;
+*   SET_CHANNEL / CMD_CHAN write up to CHAN_MAX channels.
+*
+*******************************************************************************/
+
+#ifndef SLM_CHAN_H
+#define SLM_CHAN_H
+
+#include "slm_hw.h"
+
+#define CHAN_MAX (8u)
+
+/* Interleave orders */
+#define CHAN_PER_FRAME (0u)
+#define CHAN_PER_PHASE (1u)
+#define CHAN_PER_ANGLE (2u)
+#define CHAN_PER_Z (3u)
+#define CHAN_ORDER_COUNT (4u)
+
+struct laser_chan{
+    uint8 sel;              // CAM_SEL_REG value
+    uint16 blankDelay;      // BLANKING_DELAY period, 0 for the camera's default on sel
+};
+
+/* Where T_ISR or sched_compile() is in the channel order */
+struct chan_cursor{
+    uint8 chan;
+    uint8 blk;              // frames shot in this channel since the block started
+};
+
+extern struct laser_chan chanTable[CHAN_MAX];
+extern uint8 chanCount;
+extern uint8 chanOrder;
+extern volatile uint8 chanActive;
+
+uint8 chan_set(uint8 index, uint8 sel, uint16 blankDelay, uint8 order);
+uint8 chan_set_laser(uint8 laser);
+void chan_rewind(struct chan_cursor* c);
+uint8 chan_advance(struct chan_cursor* c, uint8 pos, uint8 max, uint8 angle);
+void chan_set_end(struct chan_cursor* c);
+void chan_apply(uint8 chan);
+uint8 chan_schedulable(uint8 routeMask);
+
+#endif /* SLM_CHAN_H */
+
+/* [] END OF FILE */
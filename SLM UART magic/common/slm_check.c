@@ -0,0 +1,136 @@
+/*******************************************************************************
+* File Name: slm_check.c
+*
+* Description:
+*   Static timing check and the period arithmetic it shares with
+*   slm_timing.c, see slm_check.h.  Pure functions, linked into the host
+*   client as well as the firmware.
+*
+*******************************************************************************/
+
+#include "slm_check.h"
+#include "slm_seq.h"
+#include "slm_timing.h"
+
+/* Camera readout of rows, UMULL + shift rounded to the nearest tick.  The
+*  10 row times are scaled up by rowShift so (rows >> rowShift) stays exact
+*  for odd rows.
+*/
+uint32 timing_readout(const struct cam_profile* cam, uint16 rows){
+    uint32 shift = HORZ_Q + cam->rowShift;
+    uint64 ticks = (uint64)(rows + (10u << cam->rowShift)) * cam->horz;
+
+    return (uint32)((ticks + (1ull << (shift - 1u))) >> shift) + cam->readFudge;
+}
+
+/*******************************************************************************
+* Function Name: timing_wait
+********************************************************************************
+*
+* Summary:
+*  SLM_WAIT after an exposure of expTicks: the readout, never shorter than
+*  the SLM reload, stretched so the chain takes frame ticks when the
+*  exposure leaves room.
+*
+*******************************************************************************/
+uint32 timing_wait(uint32 frame, uint32 expTicks, uint32 readout){
+    uint32 wait;
+
+    if(readout <= SLM_CNTR_TICKS / 2u){
+        wait = SLM_CNTR_TICKS + STUPID;
+    } else {
+        wait = readout - SLM_TRG_TICKS / 2u + STUPID;
+    }
+
+    /* Stretch the wait so a short exposure still gives the requested frame rate */
+    if(frame > expTicks + SLM_TRG_TICKS){
+        uint32 remain_ticks = frame - expTicks - SLM_TRG_TICKS;
+        if(wait < remain_ticks){
+             wait = remain_ticks + STUPID;
+        }
+    }
+    if(wait < SLM_CNTR_TICKS){
+        wait = SLM_CNTR_TICKS + STUPID;
+    }
+    return wait;
+}
+
+/* BLANKING_DELAY of a channel, the camera's value for its route unless set */
+uint16 timing_blank_delay(const struct cam_profile* cam, const struct laser_chan* chan){
+    if(chan->blankDelay){
+        return chan->blankDelay;
+    }
+    return (chan->sel == BLUE_LASER) ? cam->blankDelay : cam->blankDelayAlt;
+}
+
+/* a - b, saturated to the int32 range */
+static int32 slack(uint64 a, uint64 b){
+    if(a >= b){
+        return (a - b > 0x7FFFFFFFu) ? 0x7FFFFFFF : (int32)(a - b);
+    }
+    return (b - a > 0x7FFFFFFFu) ? -0x7FFFFFFF : -(int32)(b - a);
+}
+
+/*******************************************************************************
+* Function Name: timing_check
+********************************************************************************
+*
+* Summary:
+*  Holds cfg against every CHECK_* constraint that applies to it and fills
+*  v with the slack of each.  Constraints that don't apply (CHECK_STAGE
+*  without stage steps) are left out of v->checked with a slack of 0.
+*
+* Return:
+*  The CHECK_BIT()s that failed, 0 if the sequence keeps its frame.
+*
+*******************************************************************************/
+uint8 timing_check(const struct timing_config* cfg, struct timing_verdict* v){
+    uint8 i;
+
+    v->checked = CHECK_BIT(CHECK_PERIOD) | CHECK_BIT(CHECK_READOUT) | CHECK_BIT(CHECK_SLM);
+    v->failed = 0;
+    v->laserChan = 0;
+    v->slack[CHECK_PERIOD] = slack(cfg->frame, (uint64)cfg->exposure + cfg->wait + SLM_TRG_TICKS);
+    v->slack[CHECK_READOUT] = slack((uint64)cfg->wait + SLM_TRG_TICKS, cfg->readout);
+    v->slack[CHECK_SLM] = slack(cfg->wait, SLM_CNTR_TICKS);
+    v->slack[CHECK_LASER] = 0;
+    v->slack[CHECK_STAGE] = 0;
+
+    /* BLANKING_DELAY has to end inside the exposure on every channel */
+    for(i = 0; i < cfg->chanCount && i < CHAN_MAX; i++){
+        int32 s = slack(cfg->exposure, (uint64)cfg->blankDelay[i] + 1u);
+
+        if(i == 0 || s < v->slack[CHECK_LASER]){
+            v->slack[CHECK_LASER] = s;
+            v->laserChan = i;
+        }
+    }
+    if(cfg->chanCount){
+        v->checked |= CHECK_BIT(CHECK_LASER);
+    }
+    /* The settle the stage needs, and the whole move inside a frame */
+    if(cfg->stageSteps){
+        uint64 move = (uint64)cfg->stageSteps * ((uint64)cfg->stagePulse + cfg->stageWait);
+        int32 settle = slack(cfg->stageWait, cfg->stageSettle);
+        int32 fit = slack(cfg->frame, move);
+
+        v->slack[CHECK_STAGE] = (settle < fit) ? settle : fit;
+        v->checked |= CHECK_BIT(CHECK_STAGE);
+    }
+
+    for(i = 0; i < CHECK_COUNT; i++){
+        if((v->checked & CHECK_BIT(i)) && v->slack[i] < 0){
+            v->failed |= CHECK_BIT(i);
+        }
+    }
+    return v->failed;
+}
+
+/* For messages */
+const char* checkName(uint8 check){
+    static const char* const names[] = {"period", "readout", "slm", "laser", "stage"};
+
+    return (check < CHECK_COUNT) ? names[check] : "?";
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,80 @@
+/*******************************************************************************
+* File Name: slm_check.h
+*
+* Description:
+*   Static timing check of a configured sequence.  setExposure() and
+*   setWaitTime() stretch and clamp the periods so the chain always runs,
+*   but a set that cannot keep the frame still started: it ran slower than
+*   frameTicks, or the next exposure began during the camera readout.
+*   timing_check() holds a struct timing_config against every constraint
+*   of the chain and returns the slack of each, in ticks:
+*     CHECK_PERIOD   TRG_CNT + SLM_WAIT + SLM_TRIG fit frameTicks
+*     CHECK_READOUT  SLM_WAIT + SLM_TRIG outlast the camera readout
+*     CHECK_SLM      SLM_WAIT outlasts the SLM reload (SLM_CNTR_TICKS)
+*     CHECK_LASER    the exposure outlasts BLANKING_DELAY on every channel
+*                    the sequence alternates through
+*     CHECK_STAGE    STAGE_WAIT covers the stage's settle time, and a move,
+*                    STAGE_TRIG + STAGE_WAIT per pulse, fits one frame
+*                    period, when the sequence steps the stage with
+*                    STAGE_REG; the chain is held for the whole move, so a
+*                    longer one stretches the frame after it
+*   Plane and exposure table slots are held to their channel's
+*   BLANKING_DELAY when they are looked up (plane_exposure(), expo_ticks())
+*   and lengthen their own frame on purpose, so only the base set is held
+*   to frameTicks.
+*
+*   Nothing here touches a global or a register.  The firmware refuses
+*   START_CAPTURE on a failed check (seq_check_timing(), the failed CHECK_*
+*   bits come back in bonus); the host client links the same object and
+*   builds the config with timing_readout() / timing_wait() /
+*   timing_blank_delay(), which readTime() / waitTicks() / chanBlankDelay()
+*   use on the device, so both get the same verdict.
+*
+*******************************************************************************/
+
+#ifndef SLM_CHECK_H
+#define SLM_CHECK_H
+
+#include "slm_hw.h"
+#include "slm_camera.h"
+#include "slm_chan.h"
+
+/* Constraints, index into timing_verdict.slack */
+#define CHECK_PERIOD (0u)
+#define CHECK_READOUT (1u)
+#define CHECK_SLM (2u)
+#define CHECK_LASER (3u)
+#define CHECK_STAGE (4u)
+#define CHECK_COUNT (5u)
+#define CHECK_BIT(c) (1u << (c))
+
+/* Periods of one sequence, in ticks */
+struct timing_config{
+    uint32 frame;               // frameTicks
+    uint32 exposure;            // TRG_CNT
+    uint32 wait;                // SLM_WAIT
+    uint32 readout;             // camera readout of vert rows
+    uint32 stageWait;           // STAGE_WAIT
+    uint32 stageSettle;         // what the stage needs to move and settle
+    uint32 stagePulse;          // STAGE_TRIG
+    uint16 blankDelay[CHAN_MAX];
+    uint8 chanCount;
+    uint8 stageSteps;           // most STAGE_REG pulses per move, 0 if the sequence never steps
+};
+
+struct timing_verdict{
+    int32 slack[CHECK_COUNT];   // ticks to spare, negative where the constraint fails
+    uint8 checked;              // CHECK_BIT()s that apply to the sequence
+    uint8 failed;               // CHECK_BIT()s with negative slack
+    uint8 laserChan;            // channel with the least CHECK_LASER slack
+};
+
+uint32 timing_readout(const struct cam_profile* cam, uint16 rows);
+uint32 timing_wait(uint32 frame, uint32 expTicks, uint32 readout);
+uint16 timing_blank_delay(const struct cam_profile* cam, const struct laser_chan* chan);
+uint8 timing_check(const struct timing_config* cfg, struct timing_verdict* v);
+const char* checkName(uint8 check);
+
+#endif /* SLM_CHECK_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,58 @@
+/*******************************************************************************
+* File Name: slm_expo.c
+*
+* Description:
+*   Exposure table, see slm_expo.h.  T_ISR (slm_seq.c) and sched_compile()
+*   look slots up with expo_ticks().
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "slm_expo.h"
+#include "slm_timing.h"
+
+/******** The Land Of Globals ********/
+uint32 expoTable[CHAN_MAX][EXPO_POS_MAX];
+uint8 expoActive = 0;       // any slot set since the last EXPO_CLEAR
+
+/*******************************************************************************
+* Function Name: expo_set
+********************************************************************************
+*
+* Summary:
+*  Stores the TRG_CNT period of one slot, 0 for the frame's own exposure.
+*  EXPO_CLEAR as pos zeroes the whole table.
+*
+* Return:
+*  0 if pos or chan is out of range.
+*
+*******************************************************************************/
+uint8 expo_set(uint8 pos, uint8 chan, uint32 ticks){
+    if(pos == EXPO_CLEAR){
+        memset(expoTable, 0, sizeof(expoTable));
+        expoActive = 0;
+        return 1;
+    }
+    if(pos >= EXPO_POS_MAX || chan >= CHAN_MAX){
+        return 0;
+    }
+    expoTable[chan][pos] = ticks;
+    if(ticks){
+        expoActive = 1;
+    }
+    return 1;
+}
+
+/* TRG_CNT period of a slot; base is what the frame would have had without the table */
+uint32 expo_ticks(uint8 pos, uint8 chan, uint32 base){
+    uint32 ticks = expoTable[chan][pos];
+    uint32 laser;
+
+    if(!ticks){
+        return base;
+    }
+    laser = chanBlankDelay(chan) + 1u;
+    return (ticks < laser) ? laser : ticks;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,45 @@
+/*******************************************************************************
+* File Name: slm_expo.h
+*
+* Description:
+*   Exposure table.  Gratings and laser lines differ a lot in diffraction
+*   efficiency, so each (pattern position, channel) slot of a SIM set can
+*   have its own TRG_CNT period instead of exposureTicks for all.  The
+*   position is the phase (the angle for SEVEN_PHASE) the frame shows, the
+*   channel the slm_chan.h one it goes out on.  A slot of 0 keeps the
+*   exposure the frame would have had: exposureTicks, or the plane's with a
+*   Z plane table (slm_plane.h).  A slot is never shorter than its
+*   channel's BLANKING_DELAY.
+*
+*   Only TRG_CNT changes; SLM_WAIT stays as setWaitTime() made it, so a
+*   longer slot makes its frame longer by the difference and a shorter one
+*   shorter.  The set gets slower only by what the slow slots add.
+*
+*   T_ISR writes the period for the next frame.  A scheduled capture
+*   (slm_sched.h) plays the periods from a second DMA channel into TRG_CNT
+*   instead, with SLM_SCHED_EXPO; without it a table capture runs through
+*   T_ISR.  SIM_PROGRAM sets keep the plain exposure.
+*
+*   SET_EXPO_SLOT / CMD_EXPO write one slot, EXPO_CLEAR as the position
+*   drops the table.
+*
+*******************************************************************************/
+
+#ifndef SLM_EXPO_H
+#define SLM_EXPO_H
+
+#include "slm_hw.h"
+#include "slm_chan.h"
+
+#define EXPO_POS_MAX (22u)      // pattern positions, phase_max + 1 of SEVEN_FREE
+#define EXPO_CLEAR (0xFFu)      // position that drops the table
+
+extern uint32 expoTable[CHAN_MAX][EXPO_POS_MAX];
+extern uint8 expoActive;
+
+uint8 expo_set(uint8 pos, uint8 chan, uint32 ticks);
+uint32 expo_ticks(uint8 pos, uint8 chan, uint32 base);
+
+#endif /* SLM_EXPO_H */
+
+/* [] END OF FILE */
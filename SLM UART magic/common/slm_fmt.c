@@ -0,0 +1,82 @@
+/*******************************************************************************
+* File Name: slm_fmt.c
+*
+* Description:
+*   Integer text formatting, see slm_fmt.h.
+*
+*******************************************************************************/
+
+#include "slm_fmt.h"
+#include "slm_camera.h"
+
+#define FMT_PLACES_MAX (6u)
+
+static const uint32 pow10[FMT_PLACES_MAX + 1u] = {1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u};
+
+char* fmt_str(char* p, const char* s){
+    while(*s){
+        *p++ = *s++;
+    }
+    *p = '\0';
+    return p;
+}
+
+char* fmt_char(char* p, char c){
+    *p++ = c;
+    *p = '\0';
+    return p;
+}
+
+char* fmt_u32(char* p, uint32 v){
+    char digits[10];
+    uint8 n = 0;
+
+    do{
+        digits[n++] = (char)('0' + v % 10u);
+        v /= 10u;
+    } while(v);
+    while(n){
+        *p++ = digits[--n];
+    }
+    *p = '\0';
+    return p;
+}
+
+/* v / 10^places with the point, places up to 6 */
+char* fmt_fixed(char* p, uint32 v, uint8 places){
+    uint32 frac;
+    uint8 i;
+
+    if(places > FMT_PLACES_MAX){
+        places = FMT_PLACES_MAX;
+    }
+    p = fmt_u32(p, v / pow10[places]);
+    if(places == 0){
+        return p;
+    }
+    frac = v % pow10[places];
+    *p++ = '.';
+    for(i = places; i > 0; i--){
+        *p++ = (char)('0' + (frac / pow10[i - 1u]) % 10u);
+    }
+    *p = '\0';
+    return p;
+}
+
+/* 2MHz ticks as seconds to the nearest microsecond, halves up */
+char* fmt_sec(char* p, uint32 ticks){
+    return fmt_fixed(p, ticks / 2u + (ticks & 1u), 6u);
+}
+
+/* The rate of a ticks long frame, rounded to places (up to 3) */
+char* fmt_fps(char* p, uint32 ticks, uint8 places){
+    if(places > 3u){
+        places = 3u;
+    }
+    if(ticks == 0){
+        return fmt_fixed(p, 0, places);
+    }
+    return fmt_fixed(p, (TICKS_PER_SEC * pow10[places] + ticks / 2u) / ticks, places);
+}
+
+/* [] END OF FILE */
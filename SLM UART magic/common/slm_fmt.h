@@ -0,0 +1,32 @@
+/*******************************************************************************
+* File Name: slm_fmt.h
+*
+* Description:
+*   Integer text formatting for the LCD and the UART menus, so no firmware
+*   needs printf, let alone _printf_float.  Timing is formatted from the
+*   ticks it actually runs on (frameTicks, exposureTicks), not from the
+*   float the host sent:
+*     fmt_sec(p, exposureTicks)     "0.033464"   seconds, 6 places (1us)
+*     fmt_fps(p, frameTicks, 1)     "10.0"       TICKS_PER_SEC / ticks
+*
+*   Every call appends at p, NUL terminates and returns the new end, so a
+*   line is built by chaining them.  The caller sizes the buffer:
+*   fmt_u32() writes at most 10 characters, fmt_sec() 11.
+*
+*******************************************************************************/
+
+#ifndef SLM_FMT_H
+#define SLM_FMT_H
+
+#include "slm_hw.h"
+
+char* fmt_str(char* p, const char* s);
+char* fmt_char(char* p, char c);
+char* fmt_u32(char* p, uint32 v);
+char* fmt_fixed(char* p, uint32 v, uint8 places);
+char* fmt_sec(char* p, uint32 ticks);
+char* fmt_fps(char* p, uint32 ticks, uint8 places);
+
+#endif /* SLM_FMT_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,82 @@
+/*******************************************************************************
+* File Name: slm_frames.c
+*
+* Description:
+*   Frame counters and late T_ISR detection, see slm_frames.h.
+*   frames_isr() runs in T_ISR, frames_read() in the main loop.
+*
+*******************************************************************************/
+
+#include "slm_frames.h"
+
+/******** The Land Of Globals ********/
+static volatile struct frame_counts counts;
+#if (HW_FRAME_CNT_AVAILABLE)
+static uint32 base[3];          // hardware counts at frames_reset()
+static volatile uint32 lastSlm; // hardware SLM count at the last T_ISR
+#endif
+
+static uint16 inc16(uint16 v, uint32 n){
+    return (v + n > 0xFFFFu) ? 0xFFFFu : (uint16)(v + n);
+}
+
+/* START_CAPTURE with the trigger stopped */
+void frames_reset(void){
+    uint8 s = HW_ENTER_CRITICAL();
+
+    counts.triggers = counts.slm = counts.stage = 0;
+    counts.late = counts.skipped = counts.lateMax = 0;
+#if (HW_FRAME_CNT_AVAILABLE)
+    base[0] = HW_CAM_CNT_READ();
+    base[1] = lastSlm = HW_SLM_CNT_READ();
+    base[2] = HW_STAGE_CNT_READ();
+#endif
+    HW_EXIT_CRITICAL(s);
+}
+
+/* First thing in seq_frame_done() */
+void frames_isr(void){
+    uint32 lat = HW_TRIG_ISR_LATENCY();
+
+    if(lat >= FRAME_LATE_TICKS){
+        counts.late = inc16(counts.late, 1u);
+    }
+    if(lat > counts.lateMax){
+        counts.lateMax = (lat > 0xFFFFu) ? 0xFFFFu : (uint16)lat;
+    }
+#if (HW_FRAME_CNT_AVAILABLE)
+    {
+        uint32 slm = HW_SLM_CNT_READ();
+
+        if(slm - lastSlm > 1u){
+            counts.skipped = inc16(counts.skipped, slm - lastSlm - 1u);
+        }
+        lastSlm = slm;
+    }
+#else
+    counts.triggers++;
+    counts.slm++;
+#endif
+}
+
+/* A STAGE_REG pulse from T_ISR */
+void frames_stage(void){
+#if !(HW_FRAME_CNT_AVAILABLE)
+    counts.stage++;
+#endif
+}
+
+/* Snapshot for the status packet */
+void frames_read(struct frame_counts* c){
+    uint8 s = HW_ENTER_CRITICAL();
+
+    *c = *(struct frame_counts*)&counts;
+#if (HW_FRAME_CNT_AVAILABLE)
+    c->triggers = HW_CAM_CNT_READ() - base[0];
+    c->slm = HW_SLM_CNT_READ() - base[1];
+    c->stage = HW_STAGE_CNT_READ() - base[2];
+#endif
+    HW_EXIT_CRITICAL(s);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,47 @@
+/*******************************************************************************
+* File Name: slm_frames.h
+*
+* Description:
+*   Frame counters of the running capture, for the status packet: camera
+*   triggers, SLM pulses and STAGE_REG pulses since START_CAPTURE, and the
+*   frames T_ISR served too late.
+*
+*   With SLM_FRAME_CNT=1 (slm_hw.h) the three counts come from hardware
+*   counters, so they include schedule DMA frames and anything T_ISR never
+*   saw; without it T_ISR counts them itself and triggers == SLM pulses ==
+*   T_ISR runs.
+*
+*   Late frames: T_ISR restarts the chain, so every tick it enters after
+*   the SLM_TRIG terminal count stretches the frame.  Entering
+*   FRAME_LATE_TICKS or later counts the frame as late.  SLM_TRIG reloads
+*   and runs on until T_ISR stops it, so an SLM pulse the hardware counter
+*   saw between two T_ISRs beyond the first is a pattern the SLM stepped
+*   past without a camera frame: skipped.
+*
+*******************************************************************************/
+
+#ifndef SLM_FRAMES_H
+#define SLM_FRAMES_H
+
+#include "slm_hw.h"
+#include "slm_timing.h"
+
+#define FRAME_LATE_TICKS (SLM_TRG_TICKS / 2u)   // half way to the next SLM_TRIG TC
+
+struct frame_counts{
+    uint32 triggers;    // camera triggers, TRG_CNT starts
+    uint32 slm;         // SLM trigger pulses
+    uint32 stage;       // STAGE_REG pulses
+    uint16 late;        // T_ISRs FRAME_LATE_TICKS or more after the TC
+    uint16 skipped;     // SLM pulses without a T_ISR, hardware counters only
+    uint16 lateMax;     // longest T_ISR latency, ticks
+};
+
+void frames_reset(void);
+void frames_isr(void);
+void frames_stage(void);
+void frames_read(struct frame_counts* c);
+
+#endif /* SLM_FRAMES_H */
+
+/* [] END OF FILE */
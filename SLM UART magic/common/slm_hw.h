@@ -0,0 +1,224 @@
+/*******************************************************************************
+* File Name: slm_hw.h
+*
+* Description:
+*   Thin register access layer used by the sequencer and timing core.
+*   On the PSoC every macro maps 1:1 onto the PSoC Creator generated API, so
+*   there is no cost over calling the components directly.  When built on a
+*   workstation with SLM_HOST_BUILD defined, the same macros resolve to the
+*   counter chain model in sim/slm_sim_hw.h.
+*
+*******************************************************************************/
+
+#ifndef SLM_HW_H
+#define SLM_HW_H
+
+#if defined(SLM_HOST_BUILD)
+
+#include "slm_sim_hw.h"
+
+#else
+
+#include <project.h>
+
+/* Trigger counter chain periods, in 2MHz ticks */
+#define HW_TRG_CNT_WRITE_PERIOD(p)          TRG_CNT_WritePeriod(p)
+#define HW_SLM_WAIT_WRITE_PERIOD(p)         SLM_WAIT_WritePeriod(p)
+#define HW_SLM_TRIG_WRITE_PERIOD(p)         SLM_TRIG_WritePeriod(p)
+#define HW_BLANKING_DELAY_WRITE_PERIOD(p)   BLANKING_DELAY_WritePeriod(p)
+#define HW_STAGE_TRIG_WRITE_PERIOD(p)       STAGE_TRIG_WritePeriod(p)
+#define HW_STAGE_WAIT_WRITE_PERIOD(p)       STAGE_WAIT_WritePeriod(p)
+
+/* Control registers */
+#define HW_ENBL_TRIG_ISR_WRITE(v)           ENBL_TRIG_ISR_Write(v)
+#define HW_ENBL_TRIG_ISR_READ()             ENBL_TRIG_ISR_Read()
+#define HW_TRIG_CNT_RST_WRITE(v)            TRIG_CNT_RST_Write(v)
+#define HW_CAM_SEL_REG_WRITE(v)             CAM_SEL_REG_Write(v)
+#define HW_CAM_SEL_REG_READ()               CAM_SEL_REG_Read()
+#define HW_STAGE_REG_WRITE(v)               STAGE_REG_Write(v)
+#define HW_BLANK_TOGGLE_WRITE(v)            BLANK_TOGGLE_Write(v)
+#define HW_ACTIVATE_SLM_WRITE(v)            ACTIVATE_SLM_Write(v)
+
+/* Frame interrupt */
+#define HW_TRIG_ISR_CLEAR_PENDING()         TRIG_ISR_ClearPending()
+
+/* Used to hand flags from T_ISR to the main loop without losing bits */
+#define HW_ENTER_CRITICAL()                 CyEnterCriticalSection()
+#define HW_EXIT_CRITICAL(s)                 CyExitCriticalSection(s)
+
+/* USBFS vendor bulk endpoints (slm_usb.h), manual DMA mode */
+#define HW_USB_EP_STATE(ep)                 USBFS_GetEPState(ep)
+#define HW_USB_EP_COUNT(ep)                 USBFS_GetEPCount(ep)
+#define HW_USB_ENABLE_OUT_EP(ep)            USBFS_EnableOutEP(ep)
+#define HW_USB_READ_OUT_EP(ep, b, n)        USBFS_ReadOutEP((ep), (b), (n))
+#define HW_USB_LOAD_IN_EP(ep, b, n)         USBFS_LoadInEP((ep), (b), (n))
+#define HW_USB_OUT_BUFFER_FULL              USBFS_OUT_BUFFER_FULL
+#define HW_USB_IN_BUFFER_EMPTY              USBFS_IN_BUFFER_EMPTY
+
+/* Character LCD (slm_lcd.h), only lcd_task() touches it */
+#define HW_LCD_POSITION(r, c)               LCD_Char_Position((r), (c))
+#define HW_LCD_PUTCHAR(ch)                  LCD_Char_PutChar(ch)
+
+/* Trigger timestamps (slm_ts.h): the Cortex-M3 DWT cycle counter, free
+*  running at BUS_CLK, so no schematic component is needed.
+*/
+#define HW_DWT_CTRL                         ((reg32*)0xE0001000u)
+#define HW_DWT_CYCCNT                       ((reg32*)0xE0001004u)
+#define HW_DEMCR                            ((reg32*)0xE000EDFCu)
+
+void hw_ts_start(void);
+
+#define HW_TS_START()                       hw_ts_start()
+#define HW_TS_NOW()                         CY_GET_REG32(HW_DWT_CYCCNT)
+#define HW_TS_HZ                            (BCLK__BUS_CLK__HZ)
+
+/* T_ISR instrumentation (slm_isr_stats.h).  SLM_TRIG is a down counting
+*  UDB Counter that reloads at its terminal count and keeps running, so
+*  period - count at T_ISR entry is the time since the TC.
+*/
+#define HW_TRIG_ISR_LATENCY()               ((uint32)(SLM_TRIG_ReadPeriod() - SLM_TRIG_ReadCounter()))
+#define HW_CYCLES()                         HW_TS_NOW()
+
+/* Schedule DMA (slm_sched.h).  Needs a DMA component SCHED_DMA whose drq is
+*  the SLM_TRIG terminal count and a control register SCHED_REG (route bits
+*  OR'ed into CAM_SEL, stage/next bits in pulse mode into the STAGE_TRIG and
+*  TRG_CNT reloads).  Set SLM_SCHED_DMA=1 in the project once the schematic
+*  has them; without it every capture runs through T_ISR.
+*/
+#ifndef SLM_SCHED_DMA
+#define SLM_SCHED_DMA (0u)
+#endif
+
+#if (SLM_SCHED_DMA)
+void hw_sched_arm(const uint8* table, uint16 len, uint8 cyclic);
+void hw_sched_disarm(void);
+uint8 hw_sched_busy(void);
+
+#define HW_SCHED_AVAILABLE                  (1u)
+#define HW_SCHED_ARM(t, n, c)               hw_sched_arm((t), (n), (c))
+#define HW_SCHED_DISARM()                   hw_sched_disarm()
+#define HW_SCHED_BUSY()                     hw_sched_busy()
+#else
+#define HW_SCHED_AVAILABLE                  (0u)
+#define HW_SCHED_ARM(t, n, c)
+#define HW_SCHED_DISARM()
+#define HW_SCHED_BUSY()                     (0u)
+#endif /* SLM_SCHED_DMA */
+
+/* Burst mode (slm_sched.h).  Needs a control register BURST_REG (BURST_RUN
+*  sets a run latch that lets the SLM_TRIG terminal count restart TRG_CNT,
+*  BURST_COUNTED lets BURST_CNT clear it, BURST_GO in pulse mode starts the
+*  first frame), a 32 bit down counter BURST_CNT clocked by the SLM_TRIG
+*  terminal count and a status register BURST_STATUS with the latch in
+*  bit 0.  Set SLM_BURST=1 in the project once the schematic has them.
+*/
+#ifndef SLM_BURST
+#define SLM_BURST (0u)
+#endif
+
+#if (SLM_BURST)
+#define HW_BURST_RUN                        (0x01u)
+#define HW_BURST_COUNTED                    (0x02u)
+#define HW_BURST_GO                         (0x04u)
+
+void hw_burst_start(uint32 frames);
+
+#define HW_BURST_AVAILABLE                  (1u)
+#define HW_BURST_START(n)                   hw_burst_start(n)
+#define HW_BURST_STOP()                     BURST_REG_Write(0u)
+#define HW_BURST_BUSY()                     (BURST_STATUS_Read() & HW_BURST_RUN)
+#else
+#define HW_BURST_AVAILABLE                  (0u)
+#define HW_BURST_START(n)
+#define HW_BURST_STOP()
+#define HW_BURST_BUSY()                     (0u)
+#endif /* SLM_BURST */
+
+/* Schedule exposure DMA (slm_expo.h).  Needs a second DMA component
+*  EXPO_DMA on the SCHED_DMA drq, at a higher priority so the next frame's
+*  TRG_CNT period is written before SCHED_REG restarts the chain.  Set
+*  SLM_SCHED_EXPO=1 with SLM_SCHED_DMA; without it a capture with an
+*  exposure table runs through T_ISR.
+*/
+#ifndef SLM_SCHED_EXPO
+#define SLM_SCHED_EXPO (0u)
+#endif
+
+#if (SLM_SCHED_DMA && SLM_SCHED_EXPO)
+void hw_expo_arm(const uint32* table, uint16 len);
+void hw_expo_disarm(void);
+
+#define HW_SCHED_EXPO_AVAILABLE             (1u)
+#define HW_SCHED_EXPO_ARM(t, n)             hw_expo_arm((t), (n))
+#define HW_SCHED_EXPO_DISARM()              hw_expo_disarm()
+#else
+#define HW_SCHED_EXPO_AVAILABLE             (0u)
+#define HW_SCHED_EXPO_ARM(t, n)
+#define HW_SCHED_EXPO_DISARM()
+#endif /* SLM_SCHED_EXPO */
+
+/* Stage ready handshake (slm_seq.h).  Needs a digital input pin STAGE_READY
+*  from the stage controller and an isr STAGE_READY_ISR on its rising edge.
+*  Set SLM_STAGE_READY=1 in the project once the schematic has them; without
+*  it SEVEN_PHASE waits for STAGE_MOVE_COMPLETE over USB.
+*/
+#ifndef SLM_STAGE_READY
+#define SLM_STAGE_READY (0u)
+#endif
+
+#if (SLM_STAGE_READY)
+#define HW_STAGE_READY_AVAILABLE            (1u)
+#else
+#define HW_STAGE_READY_AVAILABLE            (0u)
+#endif /* SLM_STAGE_READY */
+
+/* Frame counters (slm_frames.h).  Needs three 32 bit UDB Counters counting
+*  up and never reloading: CAM_CNT clocked by the camera trigger rising
+*  edge, SLM_CNT by the SLM_TRIG terminal count and STAGE_CNT by STAGE_REG.
+*  Set SLM_FRAME_CNT=1 in the project once the schematic has them; without
+*  it T_ISR counts, and misses schedule DMA frames.
+*/
+#ifndef SLM_FRAME_CNT
+#define SLM_FRAME_CNT (0u)
+#endif
+
+#if (SLM_FRAME_CNT)
+#define HW_FRAME_CNT_AVAILABLE              (1u)
+#define HW_CAM_CNT_READ()                   CAM_CNT_ReadCounter()
+#define HW_SLM_CNT_READ()                   SLM_CNT_ReadCounter()
+#define HW_STAGE_CNT_READ()                 STAGE_CNT_ReadCounter()
+#else
+#define HW_FRAME_CNT_AVAILABLE              (0u)
+#endif /* SLM_FRAME_CNT */
+
+/* TIMED_MODE deadline (slm_seq.h).  Needs a 32 bit UDB Counter TIME_CNT
+*  clocked at 2MHz, counting down once from its period, a control register
+*  TIME_REG (TIME_RUN holds the counter and the TIME_UP latch in reset while
+*  clear, TIME_GATE lets the latch block the TRG_CNT reload) and an isr
+*  TIME_ISR on the terminal count.  Set SLM_TIME_CNT=1 in the project once
+*  the schematic has them; without it T_ISR counts the time frame by frame.
+*/
+#ifndef SLM_TIME_CNT
+#define SLM_TIME_CNT (0u)
+#endif
+
+#if (SLM_TIME_CNT)
+#define HW_TIME_RUN                         (0x01u)
+#define HW_TIME_GATE                        (0x02u)
+
+void hw_time_start(uint32 ticks, uint8 gate);
+
+#define HW_TIME_CNT_AVAILABLE               (1u)
+#define HW_TIME_START(t, g)                 hw_time_start((t), (g))
+#define HW_TIME_STOP()                      TIME_REG_Write(0u)
+#else
+#define HW_TIME_CNT_AVAILABLE               (0u)
+#define HW_TIME_START(t, g)
+#define HW_TIME_STOP()
+#endif /* SLM_TIME_CNT */
+
+#endif /* SLM_HOST_BUILD */
+
+#endif /* SLM_HW_H */
+
+/* [] END OF FILE */
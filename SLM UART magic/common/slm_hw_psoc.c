@@ -0,0 +1,127 @@
+/*******************************************************************************
+* File Name: slm_hw_psoc.c
+*
+* Description:
+*   PSoC side of slm_hw.h for the parts that are more than a single generated
+*   API call.  Not built for the simulator.
+*
+*******************************************************************************/
+
+#include "slm_hw.h"
+
+/* Starts the DWT cycle counter behind HW_TS_NOW() */
+void hw_ts_start(void){
+    CY_SET_REG32(HW_DEMCR, CY_GET_REG32(HW_DEMCR) | 0x01000000u);    // TRCENA
+    CY_SET_REG32(HW_DWT_CYCCNT, 0u);
+    CY_SET_REG32(HW_DWT_CTRL, CY_GET_REG32(HW_DWT_CTRL) | 0x1u);     // CYCCNTENA
+}
+
+#if (SLM_TIME_CNT)
+
+/* Reloads TIME_CNT and clears the TIME_UP latch, then lets it count down */
+void hw_time_start(uint32 ticks, uint8 gate){
+    TIME_REG_Write(0u);
+    TIME_CNT_WritePeriod(ticks);
+    TIME_CNT_WriteCounter(ticks);
+    TIME_REG_Write(HW_TIME_RUN | (gate ? HW_TIME_GATE : 0u));
+}
+
+#endif /* SLM_TIME_CNT */
+
+#if (SLM_BURST)
+
+/* frames 0 runs until HW_BURST_STOP() */
+void hw_burst_start(uint32 frames){
+    BURST_REG_Write(0u);
+    if(frames){
+        BURST_CNT_WritePeriod(frames);
+        BURST_CNT_WriteCounter(frames);
+    }
+    BURST_REG_Write(HW_BURST_RUN | (frames ? HW_BURST_COUNTED : 0u) | HW_BURST_GO);
+}
+
+#endif /* SLM_BURST */
+
+#if (SLM_SCHED_DMA)
+
+static uint8 sched_ch = CY_DMA_INVALID_CHANNEL;
+static uint8 sched_td = CY_DMA_INVALID_TD;
+
+/*******************************************************************************
+* Function Name: hw_sched_arm
+********************************************************************************
+*
+* Summary:
+*  Points SCHED_DMA at the schedule table, one byte into SCHED_REG per
+*  SLM_TRIG terminal count, and plays entry 0 with a CPU request to start the
+*  first frame.  A cyclic table chains the TD back onto itself.
+*
+*******************************************************************************/
+void hw_sched_arm(const uint8* table, uint16 len, uint8 cyclic){
+    if(sched_ch == CY_DMA_INVALID_CHANNEL){
+        sched_ch = SCHED_DMA_DmaInitialize(1u, 1u, HI16(CYDEV_SRAM_BASE), HI16(CYDEV_PERIPH_BASE));
+        sched_td = CyDmaTdAllocate();
+    }
+    CyDmaChDisable(sched_ch);
+    CyDmaTdSetConfiguration(sched_td, len, cyclic ? sched_td : CY_DMA_DISABLE_TD, TD_INC_SRC_ADR);
+    CyDmaTdSetAddress(sched_td, LO16((uint32)table), LO16((uint32)SCHED_REG_Control_PTR));
+    CyDmaChSetInitialTd(sched_ch, sched_td);
+    CyDmaChEnable(sched_ch, 1u);
+    CyDmaChSetRequest(sched_ch, CPU_REQ);
+}
+
+void hw_sched_disarm(void){
+    if(sched_ch != CY_DMA_INVALID_CHANNEL){
+        CyDmaChDisable(sched_ch);
+    }
+}
+
+uint8 hw_sched_busy(void){
+    uint8 state = 0;
+
+    if(sched_ch != CY_DMA_INVALID_CHANNEL){
+        CyDmaChStatus(sched_ch, NULL, &state);
+    }
+    return (state & CY_DMA_STATUS_CHAIN_ACTIVE) != 0u;
+}
+
+#if (SLM_SCHED_EXPO)
+
+static uint8 expo_ch = CY_DMA_INVALID_CHANNEL;
+static uint8 expo_td = CY_DMA_INVALID_TD;
+
+/*******************************************************************************
+* Function Name: hw_expo_arm
+********************************************************************************
+*
+* Summary:
+*  Points EXPO_DMA at the exposure cycle, one 32 bit TRG_CNT period per
+*  SLM_TRIG terminal count, and writes entry 0 with a CPU request.  The TD
+*  chains back onto itself, the cycle repeats until hw_expo_disarm().
+*
+*******************************************************************************/
+void hw_expo_arm(const uint32* table, uint16 len){
+    if(expo_ch == CY_DMA_INVALID_CHANNEL){
+        expo_ch = EXPO_DMA_DmaInitialize(4u, 1u, HI16(CYDEV_SRAM_BASE), HI16(CYDEV_PERIPH_BASE));
+        expo_td = CyDmaTdAllocate();
+        CyDmaChPriority(expo_ch, 0u);
+    }
+    CyDmaChDisable(expo_ch);
+    CyDmaTdSetConfiguration(expo_td, len * 4u, expo_td, TD_INC_SRC_ADR);
+    CyDmaTdSetAddress(expo_td, LO16((uint32)table), LO16((uint32)TRG_CNT_PERIOD_LSB_PTR));
+    CyDmaChSetInitialTd(expo_ch, expo_td);
+    CyDmaChEnable(expo_ch, 1u);
+    CyDmaChSetRequest(expo_ch, CPU_REQ);
+}
+
+void hw_expo_disarm(void){
+    if(expo_ch != CY_DMA_INVALID_CHANNEL){
+        CyDmaChDisable(expo_ch);
+    }
+}
+
+#endif /* SLM_SCHED_EXPO */
+
+#endif /* SLM_SCHED_DMA */
+
+/* [] END OF FILE */
@@ -0,0 +1,80 @@
+/*******************************************************************************
+* File Name: slm_isr_stats.c
+*
+* Description:
+*   T_ISR latency / execution time histograms, see slm_isr_stats.h.
+*
+*******************************************************************************/
+
+#include "slm_isr_stats.h"
+
+static uint32 latHist[ISR_HIST_BINS];
+static uint32 execHist[ISR_HIST_BINS];
+static uint32 isrCalls;
+static uint32 latMax;
+static uint32 execMax;
+
+static uint8 hist_bin(uint32 v){
+    uint8 bin;
+
+    if(v == 0){
+        return 0;
+    }
+    bin = (uint8)(32 - __builtin_clz(v));   // a single CLZ on the M3
+    return (bin < ISR_HIST_BINS) ? bin : (ISR_HIST_BINS - 1u);
+}
+
+static uint16 sat16(uint32 v){
+    return (v > 0xFFFFu) ? 0xFFFFu : (uint16)v;
+}
+
+/* First thing in T_ISR; returns the start for isr_stats_exit() */
+uint32 isr_stats_enter(void){
+    uint32 start = HW_CYCLES();
+    uint32 lat = HW_TRIG_ISR_LATENCY();
+
+    latHist[hist_bin(lat)]++;
+    if(lat > latMax){
+        latMax = lat;
+    }
+    isrCalls++;
+    return start;
+}
+
+/* Last thing in T_ISR */
+void isr_stats_exit(uint32 start){
+    uint32 exec = HW_CYCLES() - start;
+
+    execHist[hist_bin(exec)]++;
+    if(exec > execMax){
+        execMax = exec;
+    }
+}
+
+void isr_stats_reset(void){
+    uint8 s = HW_ENTER_CRITICAL();
+    uint8 i;
+
+    for(i = 0; i < ISR_HIST_BINS; i++){
+        latHist[i] = execHist[i] = 0;
+    }
+    isrCalls = latMax = execMax = 0;
+    HW_EXIT_CRITICAL(s);
+}
+
+void isr_stats_fill(struct isr_stats_packet* p){
+    uint8 s = HW_ENTER_CRITICAL();
+    uint8 i;
+
+    p->magic = USB_HIST_MAGIC;
+    p->calls = isrCalls;
+    p->latency_max = sat16(latMax);
+    p->exec_max = sat16(execMax);
+    for(i = 0; i < ISR_HIST_BINS; i++){
+        p->latency[i] = sat16(latHist[i]);
+        p->exec[i] = sat16(execHist[i]);
+    }
+    HW_EXIT_CRITICAL(s);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,40 @@
+/*******************************************************************************
+* File Name: slm_isr_stats.h
+*
+* Description:
+*   T_ISR instrumentation.  Every invocation adds its entry latency (SLM_TRIG
+*   terminal count to the first instruction, 2MHz ticks) and its execution
+*   time (HW_CYCLES units) to a log2 histogram.  Latency includes any time
+*   T_ISR spent behind a USBFS interrupt.  The host reads the histogram with
+*   READ_ISR_STATS / CMD_ISR_STATS as a struct isr_stats_packet.
+*
+*   Bin 0 counts zeros, bin k counts [2^(k-1), 2^k), the last bin counts
+*   everything above.
+*
+*******************************************************************************/
+
+#ifndef SLM_ISR_STATS_H
+#define SLM_ISR_STATS_H
+
+#include "slm_hw.h"
+
+#define ISR_HIST_BINS (13u)
+#define USB_HIST_MAGIC (0x484D4C53u)    // "SLMH"
+
+struct isr_stats_packet{
+    uint32 magic;
+    uint32 calls;
+    uint16 latency_max;
+    uint16 exec_max;
+    uint16 latency[ISR_HIST_BINS];  // counts saturate at 0xFFFF
+    uint16 exec[ISR_HIST_BINS];
+};
+
+uint32 isr_stats_enter(void);
+void isr_stats_exit(uint32 start);
+void isr_stats_reset(void);
+void isr_stats_fill(struct isr_stats_packet* p);
+
+#endif /* SLM_ISR_STATS_H */
+
+/* [] END OF FILE */
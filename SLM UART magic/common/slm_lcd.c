@@ -0,0 +1,100 @@
+/*******************************************************************************
+* File Name: slm_lcd.c
+*
+* Description:
+*   Character LCD shadow and its background renderer, see slm_lcd.h.  Main
+*   loop only, nothing here runs in an isr.
+*
+*******************************************************************************/
+
+#include "slm_lcd.h"
+
+#define LCD_NO_CURSOR (0xFFu)
+
+/******** The Land Of Globals ********/
+char lcdShadow[LCD_ROWS][LCD_COLS];
+
+static char lcdShown[LCD_ROWS][LCD_COLS];   // what the display holds
+static uint32 lcdDirty[LCD_ROWS];           // columns where the two differ
+static uint8 cursorRow = LCD_NO_CURSOR;
+static uint8 cursorCol = LCD_NO_CURSOR;
+
+/* After LCD_Char_Start(), which leaves the display clear */
+void lcd_init(void){
+    uint8 r, c;
+
+    for(r = 0; r < LCD_ROWS; r++){
+        for(c = 0; c < LCD_COLS; c++){
+            lcdShadow[r][c] = lcdShown[r][c] = ' ';
+        }
+        lcdDirty[r] = 0;
+    }
+    cursorRow = cursorCol = LCD_NO_CURSOR;
+}
+
+/* Text at row, col, cut at the end of the row */
+void lcd_print(uint8 row, uint8 col, const char* s){
+    if(row >= LCD_ROWS){
+        return;
+    }
+    for(; col < LCD_COLS && *s; col++, s++){
+        lcdShadow[row][col] = *s;
+        if(*s != lcdShown[row][col]){
+            lcdDirty[row] |= (uint32)1u << col;
+        } else {
+            lcdDirty[row] &= ~((uint32)1u << col);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: lcd_task
+********************************************************************************
+*
+* Summary:
+*  One display access: moves the cursor to the first changed cell, or
+*  writes it when the cursor is already there.  Call from the main loop
+*  when no command or event is waiting.
+*
+* Return:
+*  1 while cells are still waiting to go out.
+*
+*******************************************************************************/
+uint8 lcd_task(void){
+    uint8 r, c;
+
+    for(r = 0; r < LCD_ROWS; r++){
+        if(lcdDirty[r]){
+            break;
+        }
+    }
+    if(r == LCD_ROWS){
+        return 0;
+    }
+    for(c = 0; !(lcdDirty[r] & ((uint32)1u << c)); c++){
+    }
+    if(r != cursorRow || c != cursorCol){
+        HW_LCD_POSITION(r, c);
+        cursorRow = r;
+        cursorCol = c;
+        return 1;
+    }
+    HW_LCD_PUTCHAR(lcdShadow[r][c]);
+    lcdShown[r][c] = lcdShadow[r][c];
+    lcdDirty[r] &= ~((uint32)1u << c);
+    cursorCol = (c + 1u < LCD_COLS) ? c + 1u : LCD_NO_CURSOR;
+    return lcd_pending();
+}
+
+uint8 lcd_pending(void){
+    uint8 r;
+
+    for(r = 0; r < LCD_ROWS; r++){
+        if(lcdDirty[r]){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* [] END OF FILE */
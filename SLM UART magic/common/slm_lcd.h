@@ -0,0 +1,34 @@
+/*******************************************************************************
+* File Name: slm_lcd.h
+*
+* Description:
+*   Character LCD shadow.  Command handlers only write text into lcdShadow
+*   with lcd_print(), which costs a copy; the main loop calls lcd_task()
+*   when it has nothing else to do, and that pushes one changed cell (or the
+*   cursor move in front of it) to the display per call.  A character LCD
+*   busy-waits ~40us per access, so a handler never waits on the display
+*   and a command arriving mid-redraw waits for at most one access.
+*
+*   Only cells that differ from what the display shows go out; printing a
+*   row blank and then its new text costs just the cells that changed.
+*
+*******************************************************************************/
+
+#ifndef SLM_LCD_H
+#define SLM_LCD_H
+
+#include "slm_hw.h"
+
+#define LCD_ROWS (2u)
+#define LCD_COLS (20u)      // <= 32, one dirty bit per column
+
+extern char lcdShadow[LCD_ROWS][LCD_COLS];
+
+void lcd_init(void);
+void lcd_print(uint8 row, uint8 col, const char* s);
+uint8 lcd_task(void);
+uint8 lcd_pending(void);
+
+#endif /* SLM_LCD_H */
+
+/* [] END OF FILE */
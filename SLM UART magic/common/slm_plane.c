@@ -0,0 +1,53 @@
+/*******************************************************************************
+* File Name: slm_plane.c
+*
+* Description:
+*   Z plane table, see slm_plane.h.  T_ISR walks it in slm_seq.c.
+*
+*******************************************************************************/
+
+#include "slm_plane.h"
+#include "slm_timing.h"
+
+/******** The Land Of Globals ********/
+struct z_plane planeTable[PLANE_MAX];
+uint8 planeCount = 0;       // 0: zSteps equal planes
+
+/*******************************************************************************
+* Function Name: plane_set
+********************************************************************************
+*
+* Summary:
+*  Stores one plane.  Writing index n makes the table n + 1 planes long, so
+*  plane 0 starts a new table.
+*
+* Return:
+*  0 if the index is out of range, the planes are out of order or a flag is
+*  unknown.
+*
+*******************************************************************************/
+uint8 plane_set(uint8 index, uint8 pulses, uint8 flags, uint32 exposure){
+    if(index >= PLANE_MAX || index > planeCount || (flags & ~PLANE_FLAGS)){
+        return 0;
+    }
+    planeTable[index].pulses = pulses;
+    planeTable[index].flags = flags;
+    planeTable[index].exposure = exposure;
+    planeCount = index + 1u;
+    return 1;
+}
+
+/* CHANGE_Z_STEPS: back to equal planes */
+void plane_clear(void){
+    planeCount = 0;
+}
+
+/* TRG_CNT period of a plane, never shorter than the laser blanking */
+uint32 plane_exposure(uint8 index){
+    uint32 ticks = planeTable[index].exposure ? planeTable[index].exposure : exposureTicks;
+    uint32 laser = laserMinTicks();
+
+    return (ticks < laser) ? laser : ticks;
+}
+
+/* [] END OF FILE */
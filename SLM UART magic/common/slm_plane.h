@@ -0,0 +1,53 @@
+/*******************************************************************************
+* File Name: slm_plane.h
+*
+* Description:
+*   Z plane table.  With planeCount > 0 a Z_MODE stack is planeCount planes
+*   instead of zSteps + 1 equal ones, and T_ISR sets each plane up at the
+*   boundary before its first frame:
+*     pulses     STAGE_REG pulses that move the stage onto the plane, 0
+*                stays put; plane 0's go out at START_CAPTURE.  One pulse
+*                is held off by STAGE_WAIT in hardware as before, more go
+*                through the stage handshake (SEND_TRIGG for the host to
+*                move that far, or a pulse per STAGE_READY with STAGE_HS_HW)
+*     exposure   TRG_CNT ticks for the plane's frames, 0 for exposureTicks;
+*                SLM_WAIT is stretched or shrunk so the frame stays
+*                frameTicks long where it can
+*     PLANE_NO_SIM  the plane is one frame, the closing frame of a set,
+*                instead of a SIM set
+*   The SLM still gets one trigger per frame, so its running order has to
+*   match the planes.
+*
+*   SET_PLANE / CMD_PLANE write the table as SET_CHANNEL does (index 0
+*   starts a new one), CHANGE_Z_STEPS drops it again.  A stack with a table
+*   always runs through T_ISR, never the schedule DMA.
+*
+*******************************************************************************/
+
+#ifndef SLM_PLANE_H
+#define SLM_PLANE_H
+
+#include "slm_hw.h"
+
+#define PLANE_MAX (32u)
+
+/* struct z_plane flags */
+#define PLANE_NO_SIM (0x01)
+#define PLANE_FLAGS (PLANE_NO_SIM)
+
+struct z_plane{
+    uint8 pulses;           // STAGE_REG pulses onto this plane
+    uint8 flags;
+    uint32 exposure;        // TRG_CNT ticks, 0 for exposureTicks
+};
+
+extern struct z_plane planeTable[PLANE_MAX];
+extern uint8 planeCount;
+
+uint8 plane_set(uint8 index, uint8 pulses, uint8 flags, uint32 exposure);
+void plane_clear(void);
+uint32 plane_exposure(uint8 index);
+
+#endif /* SLM_PLANE_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,179 @@
+/*******************************************************************************
+* File Name: slm_prog.c
+*
+* Description:
+*   Sequence program table and its interpreter, see slm_prog.h.
+*
+*******************************************************************************/
+
+#include "slm_prog.h"
+
+/******** The Land Of Globals ********/
+struct prog_step progTable[PROG_MAX];
+uint8 progLen = 0;
+
+/*******************************************************************************
+* Function Name: prog_set_step
+********************************************************************************
+*
+* Summary:
+*  Stores one uploaded step.  Steps go in from index 0 up; writing index n
+*  makes the program n + 1 steps long, so a shorter program replaces a
+*  longer one without a separate clear.
+*
+* Return:
+*  0 if the index or opcode is out of range or the steps are out of order.
+*
+*******************************************************************************/
+uint8 prog_set_step(uint8 index, uint8 op, uint8 arg){
+    if(index >= PROG_MAX || index > progLen || op >= PROG_OP_COUNT){
+        return 0;
+    }
+    progTable[index].op = op;
+    progTable[index].arg = arg;
+    progLen = index + 1u;
+    return 1;
+}
+
+/*******************************************************************************
+* Function Name: prog_check
+********************************************************************************
+*
+* Summary:
+*  Checks a program before it is run: loops balanced, nested at most
+*  PROG_DEPTH deep, with non-zero counts and a frame in every body, frame
+*  counts non-zero, PROG_LASER channels below chans (chanCount).  Runs on
+*  the host too, before an upload.
+*
+* Return:
+*  Frames per set, saturated at 0xFFFFFFFF; 0 if the program can't run.
+*
+*******************************************************************************/
+uint32 prog_check(const struct prog_step* prog, uint8 len, uint8 chans){
+    uint32 frames[PROG_DEPTH + 1u];
+    uint8 count[PROG_DEPTH + 1u];
+    uint8 depth = 0;
+    uint8 i;
+
+    frames[0] = 0;
+    for(i = 0; i < len && prog[i].op != PROG_END; i++){
+        uint8 arg = prog[i].arg;
+        uint32 n;
+
+        switch(prog[i].op){
+            case PROG_FRAMES:
+                if(arg == 0){
+                    return 0;
+                }
+                frames[depth] = (frames[depth] + arg < arg) ? 0xFFFFFFFFu : frames[depth] + arg;
+                break;
+            case PROG_LOOP:
+                if(arg == 0 || depth == PROG_DEPTH){
+                    return 0;
+                }
+                depth++;
+                frames[depth] = 0;
+                count[depth] = arg;
+                break;
+            case PROG_NEXT:
+                if(depth == 0 || frames[depth] == 0){
+                    return 0;
+                }
+                n = (frames[depth] > 0xFFFFFFFFu / count[depth]) ? 0xFFFFFFFFu : frames[depth] * count[depth];
+                depth--;
+                frames[depth] = (frames[depth] + n < n) ? 0xFFFFFFFFu : frames[depth] + n;
+                break;
+            case PROG_LASER:
+                if(arg >= chans){
+                    return 0;
+                }
+                break;
+            case PROG_STAGE:
+            case PROG_WAIT:
+                break;
+            default:
+                return 0;
+        }
+    }
+    return depth ? 0 : frames[0];
+}
+
+/* Start of the set, frames go out on chan until a PROG_LASER */
+void prog_rewind(struct prog_cursor* c, uint8 chan){
+    c->pc = 0;
+    c->left = 0;
+    c->depth = 0;
+    c->chan = c->chan0 = chan;
+}
+
+/*******************************************************************************
+* Function Name: prog_advance
+********************************************************************************
+*
+* Summary:
+*  Walks progTable up to the next frame.  Called from T_ISR at the end of
+*  every frame, so it only loops over the steps between two frames, which
+*  for a program that passed prog_check() is bounded by its length.  At the
+*  end of the set the cursor goes back to the start and the channel to the
+*  one the set started with, so every set is the same.
+*
+* Return:
+*  PROG_A_* for the next frame; the frame's channel is in c->chan.
+*
+*******************************************************************************/
+uint8 prog_advance(struct prog_cursor* c){
+    uint8 acts = 0;
+    uint8 guard;
+
+    if(c->left){
+        c->left--;
+        return 0;
+    }
+    for(guard = 0; guard < 2u * PROG_MAX; guard++){
+        const struct prog_step* s;
+
+        if(c->pc >= progLen){
+            break;
+        }
+        s = &progTable[c->pc++];
+        switch(s->op){
+            case PROG_FRAMES:
+                c->left = s->arg ? s->arg - 1u : 0u;
+                return acts;
+            case PROG_LASER:
+                c->chan = s->arg;
+                break;
+            case PROG_STAGE:
+                acts |= PROG_A_STAGE;
+                break;
+            case PROG_WAIT:
+                acts |= PROG_A_WAIT;
+                break;
+            case PROG_LOOP:
+                if(c->depth == PROG_DEPTH){
+                    break;
+                }
+                c->loopPc[c->depth] = c->pc;
+                c->loopLeft[c->depth] = s->arg;
+                c->depth++;
+                break;
+            case PROG_NEXT:
+                if(c->depth == 0){
+                    break;
+                }
+                if(--c->loopLeft[c->depth - 1u]){
+                    c->pc = c->loopPc[c->depth - 1u];
+                } else {
+                    c->depth--;
+                }
+                break;
+            default:
+                c->pc = progLen;
+                break;
+        }
+    }
+    prog_rewind(c, c->chan0);
+    return acts | PROG_A_END;
+}
+
+/* [] END OF FILE */
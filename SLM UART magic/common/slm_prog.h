@@ -0,0 +1,81 @@
+/*******************************************************************************
+* File Name: slm_prog.h
+*
+* Description:
+*   Programmable SIM sequences.  With simMode SIM_PROGRAM the shape of one
+*   SIM set comes from progTable instead of a fixed phase_max: a list of
+*   two byte steps uploaded over USB (CMD_PROG / PROGRAM_STEP) and walked by
+*   T_ISR one frame at a time, or compiled into the DMA schedule
+*   (slm_sched.h).  The run mode still decides what happens between sets,
+*   exactly as for the built-in SIM modes.
+*
+*   Steps, [op][arg]:
+*     PROG_FRAMES n   n frames (1..255), every one an SLM advance
+*     PROG_LASER c    channel (slm_chan.h) for the frames after it
+*     PROG_STAGE      STAGE_REG pulse before the next frame
+*     PROG_WAIT       stage handshake before the next frame, as at the end of
+*                     a SEVEN_PHASE plane (SEND_TRIGG or STAGE_READY)
+*     PROG_LOOP n     the steps up to the matching PROG_NEXT, n times (1..255)
+*     PROG_NEXT       end of a PROG_LOOP body
+*     PROG_END        end of the set, the same as running off the table
+*
+*   5 phases x 3 angles, stepping the stage after each angle:
+*     LOOP 3, FRAMES 5, STAGE, NEXT
+*
+*   A program is checked (prog_check()) before it is run; every loop body
+*   must contain a frame, so T_ISR never walks more than PROG_MAX steps
+*   between two frames.
+*
+*******************************************************************************/
+
+#ifndef SLM_PROG_H
+#define SLM_PROG_H
+
+#include "slm_hw.h"
+
+#define PROG_MAX (64u)      // steps
+#define PROG_DEPTH (4u)     // PROG_LOOP nesting
+
+/* Step opcodes */
+#define PROG_FRAMES (0x00)
+#define PROG_LASER (0x01)
+#define PROG_STAGE (0x02)
+#define PROG_WAIT (0x03)
+#define PROG_LOOP (0x04)
+#define PROG_NEXT (0x05)
+#define PROG_END (0x06)
+#define PROG_OP_COUNT (0x07)
+
+/* prog_advance() results, what goes with the next frame */
+#define PROG_A_STAGE (0x01)   // pulse STAGE_REG first
+#define PROG_A_WAIT (0x02)    // wait for the stage handshake first
+#define PROG_A_END (0x04)     // the set is over, no frame; the cursor is rewound
+                              // and any PROG_A_STAGE / WAIT go with the next set
+
+struct prog_step{
+    uint8 op;
+    uint8 arg;
+};
+
+/* Walking state, T_ISR and sched_compile() each keep one */
+struct prog_cursor{
+    uint8 pc;
+    uint8 left;                     // frames left in the current PROG_FRAMES
+    uint8 depth;
+    uint8 chan;
+    uint8 chan0;                    // channel at the start of the set
+    uint8 loopPc[PROG_DEPTH];
+    uint8 loopLeft[PROG_DEPTH];
+};
+
+extern struct prog_step progTable[PROG_MAX];
+extern uint8 progLen;
+
+uint8 prog_set_step(uint8 index, uint8 op, uint8 arg);
+uint32 prog_check(const struct prog_step* prog, uint8 len, uint8 chans);
+void prog_rewind(struct prog_cursor* c, uint8 chan);
+uint8 prog_advance(struct prog_cursor* c);
+
+#endif /* SLM_PROG_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,308 @@
+/*******************************************************************************
+* File Name: slm_sched.c
+*
+* Description:
+*   Compiles the current mode / simMode / channel table / zSteps /
+*   frameCount into sched_table by walking the same rules as
+*   seq_frame_done(), then hands the table to the schedule DMA.  SIM_PROGRAM
+*   sets are walked with the program interpreter T_ISR uses (slm_prog.h),
+*   the channels with the same interleave walk (slm_chan.h).
+*
+*******************************************************************************/
+
+#include "slm_seq.h"
+#include "slm_sched.h"
+#include "slm_ts.h"
+#include "slm_prog.h"
+#include "slm_chan.h"
+#include "slm_frames.h"
+#include "slm_timing.h"
+
+uint8 sched_table[SCHED_MAX];
+uint16 sched_len = 0;
+uint32 sched_expo[SCHED_EXPO_MAX];
+uint16 sched_expo_len = 0;      // 0: TRG_CNT keeps exposureTicks
+uint8 sched_cyclic = 0;
+static uint8 sched_fin = 0;
+static uint8 sched_expo_armed = 0;
+uint8 sched_burst = 0;
+uint32 sched_burst_frames = 0;  // 0: until stopped or TIME_CNT gates it
+
+static uint8 sched_entry(uint8 chan, uint8 acts){
+    return chanTable[chan].sel | SCHED_NEXT | ((acts & PROG_A_STAGE) ? SCHED_STAGE : 0u);
+}
+
+/* TRG_CNT period of the frame entry i starts, for the first cycle only */
+static void sched_expo_put(uint16 i, uint8 pos, uint8 chan){
+    if(i < sched_expo_len){
+        sched_expo[i] = expo_ticks(pos, chan, exposureTicks);
+    }
+}
+
+/* Back to exposureTicks after a schedule with an exposure table */
+static void sched_expo_end(void){
+    if(sched_expo_armed){
+        sched_expo_armed = 0;
+        HW_SCHED_EXPO_DISARM();
+        HW_TRG_CNT_WRITE_PERIOD(exposureTicks);
+    }
+}
+
+/*******************************************************************************
+* Function Name: sched_burst_fit
+********************************************************************************
+*
+* Summary:
+*  Checks whether the capture can run as a hardware burst: one channel, so
+*  CAM_SEL and BLANKING_DELAY never change, one exposure, and no stage step
+*  or handshake between frames.  Sets sched_burst_frames and sched_fin.
+*
+*******************************************************************************/
+static uint8 sched_burst_fit(void){
+    uint32 perSet;
+    uint8 i;
+
+    if(!HW_BURST_AVAILABLE || chanCount != 1u || expoActive || simMode == SEVEN_PHASE){
+        return 0;
+    }
+    if(simMode == SIM_PROGRAM){
+        perSet = prog_check(progTable, progLen, chanCount);
+        for(i = 0; i < progLen; i++){
+            if(progTable[i].op == PROG_STAGE || progTable[i].op == PROG_WAIT){
+                return 0;
+            }
+        }
+    } else {
+        perSet = phase_max + 1u;
+    }
+    sched_burst_frames = 0;
+    sched_fin = 0;
+    switch(mode){
+        case FREE_RUN:
+            return 1;
+        case COUNT_MODE:
+            /* frameCount + 1 sets, as T_ISR runs them */
+            if(!perSet || frameCount >= 0xFFFFFFFFu / perSet){
+                return 0;
+            }
+            sched_burst_frames = (frameCount + 1u) * perSet;
+            sched_fin = COUNT_FIN;
+            return 1;
+        case TIMED_MODE:
+            return HW_TIME_CNT_AVAILABLE && timedStop == TIMED_STOP_EXACT;
+        default:
+            return 0;
+    }
+}
+
+/* SIM_PROGRAM, the same walk as prog_frame_done() in slm_seq.c */
+static uint16 sched_compile_prog(void){
+    struct prog_cursor c;
+    uint16 z = 0;
+    uint32 cnt = 0;
+    uint16 n = 0;
+    uint8 acts;
+
+    if(!prog_check(progTable, progLen, chanCount)){
+        return 0;
+    }
+    prog_rewind(&c, 0);
+    acts = prog_advance(&c);
+    /* Room for a frame and the closing entry */
+    while(n < SCHED_MAX - 1u){
+        if(acts & PROG_A_WAIT){
+            /* Stage handshake, T_ISR only */
+            return 0;
+        }
+        sched_table[n++] = sched_entry(c.chan, acts);
+        acts = prog_advance(&c);
+        if(!(acts & PROG_A_END)){
+            continue;
+        }
+        if(mode == Z_MODE){
+            if(z < zSteps){
+                z++;
+                acts |= PROG_A_STAGE;
+            } else {
+                sched_table[n++] = chanTable[c.chan].sel;
+                sched_fin = Z_FIN;
+                break;
+            }
+        } else if(mode == COUNT_MODE){
+            if(cnt < frameCount){
+                cnt++;
+            } else {
+                sched_table[n++] = chanTable[c.chan].sel;
+                sched_fin = COUNT_FIN;
+                break;
+            }
+        } else {
+            /* Entry 0 has no room for steps after the last frame */
+            if(acts & (PROG_A_STAGE | PROG_A_WAIT)){
+                return 0;
+            }
+            sched_cyclic = 1;
+            break;
+        }
+        acts |= prog_advance(&c);
+    }
+    return n;
+}
+
+/*******************************************************************************
+* Function Name: sched_compile
+********************************************************************************
+*
+* Summary:
+*  Builds sched_table for the configured acquisition.  Entry 0 starts the
+*  first frame, entry n is written at the end of frame n-1.  Free run
+*  compiles a single SIM set and replays it cyclically.  A capture that
+*  fits a hardware burst (sched_burst_fit()) needs no table.
+*
+* Return:
+*  0 if the acquisition can't be scheduled (SEVEN_PHASE and PROG_WAIT need
+*  the stage handshake, TIMED_MODE needs TIME_CNT and TIMED_STOP_EXACT or
+*  else T_ISR decides when it ends, a plane table needs T_ISR for the
+*  per plane exposure and moves, an exposure table needs EXPO_DMA, channels that differ in BLANKING_DELAY
+*  need T_ISR to switch it, or it does not fit SCHED_MAX); the caller uses
+*  T_ISR instead.  A timed schedule runs as free run until TIME_CNT gates
+*  the trigger.
+*
+*******************************************************************************/
+uint8 sched_compile(void){
+    struct chan_cursor ch;
+    uint8 ph = 0;
+    uint16 z = 0;
+    uint32 cnt = 0;
+    uint16 n = 0;
+
+    sched_burst = sched_burst_fit();
+    if(sched_burst){
+        return 1;
+    }
+    if(!HW_SCHED_AVAILABLE || simMode == SEVEN_PHASE
+        || (mode == TIMED_MODE && (!HW_TIME_CNT_AVAILABLE || timedStop != TIMED_STOP_EXACT))
+        || seq_plane_table()
+        || (expoActive && simMode != SIM_PROGRAM && !HW_SCHED_EXPO_AVAILABLE)
+        || !chan_schedulable(SCHED_ROUTE_MASK)){
+        return 0;
+    }
+
+    sched_cyclic = 0;
+    sched_fin = 0;
+    sched_expo_len = 0;
+    if(simMode == SIM_PROGRAM){
+        n = sched_compile_prog();
+        if(!sched_fin && !sched_cyclic){
+            return 0;
+        }
+        sched_len = n;
+        return 1;
+    }
+    if(expoActive){
+        uint8 blocks = (chanOrder == CHAN_PER_FRAME) ? 1u : chanCount;
+
+        sched_expo_len = (uint16)blocks * phase_max + 1u;
+        if(chanOrder == CHAN_PER_FRAME){
+            sched_expo_len *= chanCount;
+        }
+    }
+    chan_rewind(&ch);
+    sched_expo_put(n, 0, 0);
+    sched_table[n++] = chanTable[0].sel | SCHED_NEXT;
+
+    while(n < SCHED_MAX){
+        if(ph < phase_max){
+            ph = chan_advance(&ch, ph, phase_max, phase_angle);
+            sched_expo_put(n, ph, ch.chan);
+            sched_table[n++] = chanTable[ch.chan].sel | SCHED_NEXT;
+        } else {
+            uint8 route;
+
+            ph = 0;
+            chan_set_end(&ch);
+            route = chanTable[ch.chan].sel;
+            sched_expo_put(n, 0, ch.chan);
+            if(mode == Z_MODE){
+                if(z < zSteps){
+                    z++;
+                    sched_table[n++] = route | SCHED_STAGE | SCHED_NEXT;
+                } else {
+                    sched_table[n++] = route;
+                    sched_fin = Z_FIN;
+                    break;
+                }
+            } else if(mode == COUNT_MODE){
+                if(cnt < frameCount){
+                    cnt++;
+                    sched_table[n++] = route | SCHED_NEXT;
+                } else {
+                    sched_table[n++] = route;
+                    sched_fin = COUNT_FIN;
+                    break;
+                }
+            } else {
+                /* Next set starts exactly like entry 0; with CHAN_PER_FRAME
+                *  only if the set length comes round to channel 0
+                */
+                if(ch.chan != 0){
+                    return 0;
+                }
+                sched_cyclic = 1;
+                break;
+            }
+        }
+    }
+
+    if(!sched_fin && !sched_cyclic){
+        return 0;
+    }
+    sched_len = n;
+    if(sched_expo_len > n){
+        sched_expo_len = n;
+    }
+    return 1;
+}
+
+/* Only valid after a successful sched_compile() with the trigger stopped.
+*  The first frame goes to channel 0, wherever T_ISR last left the route.
+*/
+void sched_start(void){
+    HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+    sched_running = 1;
+    ts_mark_start();
+    frames_reset();
+    seq_timed_arm();
+    chan_apply(0);
+    if(sched_burst){
+        HW_BURST_START(sched_burst_frames);
+        return;
+    }
+    if(sched_expo_len){
+        /* Entry 0's period in place before SCHED_DMA starts the frame */
+        sched_expo_armed = 1;
+        HW_SCHED_EXPO_ARM(sched_expo, sched_expo_len);
+    }
+    HW_SCHED_ARM(sched_table, sched_len, sched_cyclic);
+}
+
+void sched_stop(void){
+    if(sched_running){
+        HW_SCHED_DISARM();
+        HW_BURST_STOP();
+        sched_running = 0;
+    }
+    sched_expo_end();
+}
+
+/* Main loop: returns Z_FIN / COUNT_FIN once the DMA has played the last entry */
+uint8 sched_poll(void){
+    if(sched_running && !(sched_burst ? HW_BURST_BUSY() : HW_SCHED_BUSY())){
+        sched_running = 0;
+        sched_expo_end();
+        return sched_fin;
+    }
+    return 0;
+}
+
+/* [] END OF FILE */
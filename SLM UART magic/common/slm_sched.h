@@ -0,0 +1,56 @@
+/*******************************************************************************
+* File Name: slm_sched.h
+*
+* Description:
+*   Precomputed trigger schedule.  On START_CAPTURE the whole acquisition is
+*   compiled into one byte per frame and replayed by DMA into SCHED_REG at
+*   every SLM_TRIG terminal count, so T_ISR is not in the per-frame path.
+*
+*   SCHED_REG bits (written by SCHED_DMA, one entry per chain end):
+*     SCHED_ROUTE_MASK  CAM_SEL_REG value for the next frame
+*     SCHED_STAGE       pulse STAGE_REG before the next frame
+*     SCHED_NEXT        restart TRG_CNT; an entry without it ends the run
+*
+*   With an exposure table (slm_expo.h) sched_expo holds the TRG_CNT period
+*   of each frame, played cyclically by EXPO_DMA on the same request ahead
+*   of SCHED_DMA.  The (phase, channel) walk repeats every set, or every
+*   chanCount sets with CHAN_PER_FRAME, so one such cycle is enough.
+*
+*   Burst mode goes further when every frame looks the same to the
+*   hardware (one channel, no stage steps, no exposure table): the SLM_TRIG
+*   terminal count restarts TRG_CNT by itself and BURST_CNT counts the
+*   frames down, so nothing runs per frame, not even a DMA request.
+*   sched_compile() picks it ahead of the table for free run, COUNT_MODE
+*   and a TIME_CNT gated TIMED_MODE; sched_burst says which one it took.
+*
+*******************************************************************************/
+
+#ifndef SLM_SCHED_H
+#define SLM_SCHED_H
+
+#include "slm_hw.h"
+#include "slm_expo.h"
+
+#define SCHED_ROUTE_MASK (0x07)
+#define SCHED_STAGE (0x08)
+#define SCHED_NEXT (0x10)
+
+#define SCHED_MAX (2048u)   // one entry per frame, must stay below the 4095 byte TD limit
+#define SCHED_EXPO_MAX (CHAN_MAX * EXPO_POS_MAX)  // the longest set walk cycle
+
+extern uint8 sched_table[SCHED_MAX];
+extern uint16 sched_len;
+extern uint32 sched_expo[SCHED_EXPO_MAX];
+extern uint16 sched_expo_len;
+extern uint8 sched_burst;
+extern uint32 sched_burst_frames;
+extern uint8 sched_cyclic;
+
+uint8 sched_compile(void);
+void sched_start(void);
+void sched_stop(void);
+uint8 sched_poll(void);
+
+#endif /* SLM_SCHED_H */
+
+/* [] END OF FILE */
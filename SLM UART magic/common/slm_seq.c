@@ -0,0 +1,617 @@
+/*******************************************************************************
+* File Name: slm_seq.c
+*
+* Description:
+*   Per-frame trigger sequencing, split out of T_ISR so it can be exercised
+*   on a workstation.  seq_frame_done() is the whole body of T_ISR.
+*
+*******************************************************************************/
+
+#include "slm_seq.h"
+#include "slm_timing.h"
+#include "slm_ts.h"
+#include "slm_prog.h"
+#include "slm_chan.h"
+#include "slm_frames.h"
+#include "slm_plane.h"
+#include "slm_expo.h"
+#include "slm_check.h"
+
+/******** The Land Of Globals ********/
+volatile uint8 phases = 0;
+volatile uint8 angles = 0;
+volatile uint8 axCount = 0;
+volatile uint16 zCount = 0;
+volatile uint32 frameCount = 1;
+volatile uint32 count_itt = 0;
+volatile uint32 time_ticks_rem = 0;
+uint32 time_ticks = 0;
+volatile uint8 mode = COUNT_MODE;
+volatile uint8 simMode = THREE_BEAM;
+volatile uint16 zSteps = 0;
+volatile uint8 msgFlag = 0;
+volatile uint8 phase_max = THREE_BEAM_MAX;
+volatile uint8 phase_angle = THREE_BEAM_MAX / ANGLE_MAX;
+volatile uint8 laser_conf = BLUE_LASER;
+volatile uint8 stageHandshake = STAGE_HS_USB;
+volatile uint8 stageWait = 0;
+volatile uint8 timedStop = TIMED_STOP_EXACT;
+/* Set while the DMA schedule replays (slm_sched.c); here so the UART
+*  builds, which don't link the scheduler, see it stay 0
+*/
+volatile uint8 sched_running = 0;
+
+static struct prog_cursor progCursor;
+static struct chan_cursor chanCursor;
+static uint8 progStages;
+static volatile uint8 timeUp;
+static uint8 stagePulses;       // plane move pulses still to go, STAGE_HS_HW
+static uint8 seqTiming;         // TRG_CNT / SLM_WAIT hold a plane or exposure table period
+static uint32 planeExpo;        // TRG_CNT of the current table plane, 0 outside one
+
+/* Trigger stays off until seq_stage_ready() */
+static void stage_request(uint8 plane){
+    stageWait = 1;
+    if(stageHandshake == STAGE_HS_HW){
+        ts_record(TS_STAGE, plane);
+        frames_stage();
+        HW_STAGE_REG_WRITE(REG_ON);
+        HW_STAGE_REG_WRITE(REG_OFF);
+    } else {
+        msgFlag |= STAGE_REQ;
+    }
+}
+
+/* Exposure table: TRG_CNT for the next frame, pattern position pos on chan */
+static void expo_frame(uint8 pos, uint8 chan){
+    if(expoActive && simMode != SIM_PROGRAM){
+        HW_TRG_CNT_WRITE_PERIOD(expo_ticks(pos, chan, planeExpo ? planeExpo : exposureTicks));
+        seqTiming = 1;
+    }
+}
+
+/*******************************************************************************
+* Function Name: plane_enter
+********************************************************************************
+*
+* Summary:
+*  Z_MODE with a plane table: exposure, set shape and stage move for plane
+*  z, ahead of its first frame.  More than one pulse goes through the stage
+*  handshake; with STAGE_HS_HW seq_stage_ready() sends the rest one at a
+*  time.
+*
+* Return:
+*  0 if the trigger has to wait for the stage handshake.
+*
+*******************************************************************************/
+static uint8 plane_enter(uint8 z){
+    const struct z_plane* pl = &planeTable[z];
+    uint32 expTicks = plane_exposure(z);
+
+    HW_TRG_CNT_WRITE_PERIOD(expTicks);
+    HW_SLM_WAIT_WRITE_PERIOD(waitTicks(expTicks));
+    seqTiming = 1;
+    planeExpo = expTicks;
+    if(pl->flags & PLANE_NO_SIM){
+        /* The next frame closes the set */
+        phases = phase_max;
+    }
+    expo_frame(phases, chanCursor.chan);
+    if(pl->pulses == 1u){
+        ts_record(TS_STAGE, z);
+        frames_stage();
+        HW_STAGE_REG_WRITE(REG_ON);
+        HW_STAGE_REG_WRITE(REG_OFF);
+    } else if(pl->pulses > 1u){
+        stagePulses = (stageHandshake == STAGE_HS_HW) ? pl->pulses - 1u : 0u;
+        stage_request(z);
+        return 0;
+    }
+    return 1;
+}
+
+/* Back to the global exposure once a plane table or exposure table capture is over */
+static void seq_timing_end(void){
+    planeExpo = 0;
+    if(seqTiming){
+        seqTiming = 0;
+        HW_TRG_CNT_WRITE_PERIOD(exposureTicks);
+        HW_SLM_WAIT_WRITE_PERIOD(wait_time_ticks);
+    }
+}
+
+/* Software TIMED_MODE clock, per frame started; with TIME_CNT the deadline
+*  costs T_ISR nothing.
+*/
+static void timed_frame(void){
+    if(HW_TIME_CNT_AVAILABLE || mode != TIMED_MODE){
+        return;
+    }
+    if(time_ticks_rem > frameTicks){
+        time_ticks_rem -= frameTicks;
+    } else {
+        time_ticks_rem = 0;
+        timeUp = 1;
+        if(timedStop == TIMED_STOP_EXACT){
+            HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+            msgFlag |= TIMED_FIN;
+        }
+    }
+}
+
+/* Route and stage steps ahead of a program frame, 0 if it has to wait */
+static uint8 prog_frame_setup(uint8 acts){
+    if(progCursor.chan != chanActive){
+        chan_apply(progCursor.chan);
+    }
+    if(acts & PROG_A_STAGE){
+        ts_record(TS_STAGE, progStages++);
+        frames_stage();
+        HW_STAGE_REG_WRITE(REG_ON);
+        HW_STAGE_REG_WRITE(REG_OFF);
+    }
+    if(acts & PROG_A_WAIT){
+        stage_request(axCount++);
+        return 0;
+    }
+    return 1;
+}
+
+/*******************************************************************************
+* Function Name: prog_frame_done
+********************************************************************************
+*
+* Summary:
+*  SIM_PROGRAM part of T_ISR.  The program decides the next frame; at the
+*  end of a set the run mode decides whether another set follows, as for
+*  the fixed SIM modes.
+*
+*******************************************************************************/
+static void prog_frame_done(void){
+    uint8 acts = prog_advance(&progCursor);
+
+    if(acts & PROG_A_END){
+        phases = 0;
+        if(mode == Z_MODE){
+            if(zCount < zSteps){
+                zCount++;
+                acts |= PROG_A_STAGE;
+            } else {
+                zCount = 0;
+                msgFlag |= Z_FIN;
+                return;
+            }
+        } else if(mode == COUNT_MODE){
+            if(count_itt < frameCount){
+                count_itt += 1;
+            } else {
+                count_itt = 0;
+                msgFlag |= COUNT_FIN;
+                return;
+            }
+        } else if(mode == TIMED_MODE && timeUp){
+            msgFlag |= TIMED_FIN;
+            return;
+        }
+        acts |= prog_advance(&progCursor);
+    } else {
+        phases++;
+    }
+    if(!prog_frame_setup(acts)){
+        return;
+    }
+    HW_TRIG_CNT_RST_WRITE(REG_ON);
+    HW_TRIG_CNT_RST_WRITE(REG_OFF);
+    HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+    timed_frame();
+}
+
+
+/*******************************************************************************
+* Function Name: seq_frame_done
+********************************************************************************
+*
+* Summary:
+*  Called at the end of every trigger chain (TRIG_ISR).  Controls the trigger
+*  periods and which device gets the next trigger pulse.
+*
+*******************************************************************************/
+void seq_frame_done(void){
+
+    frames_isr();
+    ts_record(TS_FRAME, (((simMode == SEVEN_PHASE) ? angles : phases) & TS_INFO_PHASE)
+                        | TS_INFO_CHAN(chanActive));
+    timing_commit();
+    HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+    HW_TRIG_ISR_CLEAR_PENDING();
+    switch(simMode){
+        case SEVEN_PHASE:
+            if (angles < ANGLE_MAX) {
+                angles = chan_advance(&chanCursor, angles, ANGLE_MAX, 1u);
+                if(chanCount > 1u){
+                    chan_apply(chanCursor.chan);
+                }
+                expo_frame(angles, chanCursor.chan);
+
+                HW_TRIG_CNT_RST_WRITE(REG_ON);
+                HW_TRIG_CNT_RST_WRITE(REG_OFF);
+                HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+            } else {
+                angles = 0;
+                chan_set_end(&chanCursor);
+                if(chanCursor.chan != chanActive){
+                    chan_apply(chanCursor.chan);
+                }
+                expo_frame(0, chanCursor.chan);
+                if (axCount < AXIAL_MAX) {
+                    stage_request(axCount);
+                    axCount++;
+                } else {
+                    HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+                    axCount = 0;
+                    msgFlag |= Z_FIN;
+                }
+            }
+            break;
+        case SIM_PROGRAM:
+            prog_frame_done();
+            break;
+        default:
+            if (phases < phase_max) {
+                phases = chan_advance(&chanCursor, phases, phase_max, phase_angle);
+                if(chanCount > 1u){
+                    chan_apply(chanCursor.chan);
+                }
+                expo_frame(phases, chanCursor.chan);
+
+                HW_TRIG_CNT_RST_WRITE(REG_ON);
+                HW_TRIG_CNT_RST_WRITE(REG_OFF);
+                HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+                timed_frame();
+            } else {
+                phases = 0;
+                chan_set_end(&chanCursor);
+                if(chanCursor.chan != chanActive){
+                    chan_apply(chanCursor.chan);
+                }
+                expo_frame(0, chanCursor.chan);
+                if(mode == Z_MODE && planeCount){
+                    if(zCount + 1u < planeCount){
+                        zCount++;
+                        if(plane_enter((uint8)zCount)){
+                            HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+                        }
+                    } else {
+                        HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+                        zCount = 0;
+                        seq_timing_end();
+                        msgFlag |= Z_FIN;
+                    }
+                } else if(mode == Z_MODE){
+                    if (zCount < zSteps) {
+                        ts_record(TS_STAGE, (uint8)zCount);
+                        frames_stage();
+                        HW_STAGE_REG_WRITE(REG_ON);
+                        HW_STAGE_REG_WRITE(REG_OFF);
+                        zCount++;
+                        HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+                    } else {
+                        HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+                        zCount = 0;
+                        msgFlag |= Z_FIN;
+                    }
+                } else if(mode == COUNT_MODE){
+                    if(count_itt < frameCount){
+                        count_itt += 1;
+                        HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+                        HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+                    } else {
+                        count_itt = 0;
+                        HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+                        msgFlag |= COUNT_FIN;
+                    }
+                } else if(mode == TIMED_MODE && timeUp){
+                    HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+                    msgFlag |= TIMED_FIN;
+                } else {
+                    HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+                    HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+                    timed_frame();
+                }
+            }
+            break;
+    }
+}
+
+/*******************************************************************************
+* Function Name: seq_start
+********************************************************************************
+*
+* Summary:
+*  START_CAPTURE: rewinds the sequence if the trigger was stopped and turns
+*  the trigger on, or leaves that to the stage handshake when the first
+*  frame waits for one.  A program that prog_check() rejects leaves the
+*  trigger off.
+*
+* Return:
+*  1 if the capture started (or was running), 0 if it was refused.
+*
+*******************************************************************************/
+uint8 seq_start(void){
+    if(!HW_ENBL_TRIG_ISR_READ()){
+        count_itt = 0;
+        phases = 0;
+        angles = 0;
+        zCount = 0;
+        axCount = 0;
+        stageWait = 0;
+        stagePulses = 0;
+        chan_rewind(&chanCursor);
+        chan_apply(0);
+        frames_reset();
+        /* A program changed since SET_SIM_MODE and not finished doesn't start */
+        if(simMode == SIM_PROGRAM && !prog_check(progTable, progLen, chanCount)){
+            return 0;
+        }
+        ts_mark_start();
+        seq_timed_arm();
+        if(simMode == SIM_PROGRAM){
+            progStages = 0;
+            prog_rewind(&progCursor, 0);
+            if(!prog_frame_setup(prog_advance(&progCursor))){
+                return 1;
+            }
+        }
+        seq_timing_end();
+        if(seq_plane_table()){
+            if(!plane_enter(0)){
+                return 1;
+            }
+        } else {
+            expo_frame(0, 0);
+        }
+    }
+    HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+    return 1;
+}
+
+void seq_stop(void){
+    stageWait = 0;
+    stagePulses = 0;
+    HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+    HW_TIME_STOP();
+    seq_timing_end();
+}
+
+/* The plane table drives this capture: Z_MODE with a fixed SIM mode */
+uint8 seq_plane_table(void){
+    return planeCount && mode == Z_MODE && simMode != SEVEN_PHASE && simMode != SIM_PROGRAM;
+}
+
+/* SET_RUN_MODE: TIMED_TO_SET_END picks the TIMED_MODE stop */
+void seq_set_run_mode(uint8 runMode){
+    mode = runMode & RUN_MODE_MASK;
+    timedStop = (runMode & TIMED_TO_SET_END) ? TIMED_STOP_SET : TIMED_STOP_EXACT;
+}
+
+/*******************************************************************************
+* Function Name: seq_timed_arm
+********************************************************************************
+*
+* Summary:
+*  Starts the TIMED_MODE clock at capture start, from T_ISR or the schedule.
+*  With TIME_CNT (HW_TIME_CNT_AVAILABLE) the deadline is a hardware one
+*  shot; for TIMED_STOP_EXACT its latch also blocks any trigger after it.
+*  Any other run mode leaves TIME_CNT stopped.
+*
+*******************************************************************************/
+void seq_timed_arm(void){
+    timeUp = 0;
+    time_ticks_rem = time_ticks;
+    if(mode == TIMED_MODE){
+        HW_TIME_START(time_ticks ? time_ticks : 1u, timedStop == TIMED_STOP_EXACT);
+    } else {
+        HW_TIME_STOP();
+    }
+}
+
+/* TIME_ISR, TIME_CNT terminal count: the deadline has passed */
+void seq_time_up(void){
+    if(mode != TIMED_MODE){
+        return;
+    }
+    timeUp = 1;
+    if(timedStop == TIMED_STOP_EXACT){
+        HW_ENBL_TRIG_ISR_WRITE(REG_OFF);
+        msgFlag |= TIMED_FIN;
+    }
+}
+
+/*******************************************************************************
+* Function Name: seq_set_stage_handshake
+********************************************************************************
+*
+* Summary:
+*  Selects how a SEVEN_PHASE acquisition moves on to the next plane.
+*  STAGE_HS_HW needs the STAGE_READY input (HW_STAGE_READY_AVAILABLE).
+*
+* Return:
+*  The handshake in use, STAGE_HS_USB if STAGE_HS_HW isn't available.
+*
+*******************************************************************************/
+uint8 seq_set_stage_handshake(uint8 hs){
+    stageHandshake = (hs == STAGE_HS_HW && HW_STAGE_READY_AVAILABLE) ? STAGE_HS_HW : STAGE_HS_USB;
+    return stageHandshake;
+}
+
+/* STAGE_READY rising edge or STAGE_MOVE_COMPLETE: next plane, if one is due */
+void seq_stage_ready(void){
+    if(stageWait && stagePulses){
+        /* Multi pulse plane move, STAGE_HS_HW */
+        stagePulses--;
+        ts_record(TS_STAGE, (uint8)zCount);
+        frames_stage();
+        HW_STAGE_REG_WRITE(REG_ON);
+        HW_STAGE_REG_WRITE(REG_OFF);
+    } else if(stageWait){
+        stageWait = 0;
+        HW_ENBL_TRIG_ISR_WRITE(REG_ON);
+    }
+}
+
+/* STAGE_MOVE_COMPLETE from the main loop: seq_stage_ready() with S_ISR and
+*  T_ISR held off, ts_record() is not reentrant
+*/
+void seq_stage_move_complete(void){
+    uint8 state = HW_ENTER_CRITICAL();
+
+    seq_stage_ready();
+    HW_EXIT_CRITICAL(state);
+}
+
+void seq_set_sim_mode(uint8 sim){
+
+    simMode = sim;
+
+    if(simMode == TWO_BEAM){
+        phase_max = TWO_BEAM_MAX;
+        phase_angle = TWO_BEAM_MAX / ANGLE_MAX;
+    } else if(simMode == THREE_BEAM) {
+        phase_max = THREE_BEAM_MAX;
+        phase_angle = THREE_BEAM_MAX / ANGLE_MAX;
+    } else if (simMode == NO_SIM_Z_ONLY){
+        phase_max = NO_BEAM_MAX;
+        phase_angle = NO_BEAM_MAX;
+    } else if (simMode == SINGLE_ANGLE) {
+        phase_max = SINGLE_ANGLE_MAX;
+        phase_angle = SINGLE_ANGLE_MAX;
+    } else if (simMode == SEVEN_PHASE){
+        /* A frame per angle */
+        phase_max = SEVEN_PHASE_MAX;
+        phase_angle = 1;
+    } else if (simMode == SEVEN_FREE){
+        phase_max = SEVEN_PHASE_MAX;
+        phase_angle = SEVEN_PHASE_MAX / ANGLE_MAX;
+    } else if (simMode == SIM_PROGRAM && prog_check(progTable, progLen, chanCount)){
+        /* Not used, the program has the set length */
+        phase_max = 0;
+        phase_angle = 0;
+    } else {
+        simMode = NO_SIM_Z_ONLY;
+        phase_max = NO_BEAM_MAX;
+        phase_angle = NO_BEAM_MAX;
+    }
+}
+
+/* PROGRAM_STEP / CMD_PROG: the table can't change under a running program */
+uint8 seq_set_prog_step(uint8 index, uint8 op, uint8 arg){
+    if(HW_ENBL_TRIG_ISR_READ() || stageWait){
+        return 0;
+    }
+    return prog_set_step(index, op, arg);
+}
+
+/* A capture is under way: T_ISR armed, a stage move pending or the DMA
+*  schedule replaying
+*/
+uint8 seq_running(void){
+    return HW_ENBL_TRIG_ISR_READ() || stageWait || sched_running;
+}
+
+/* SET_CHANNEL / CMD_CHAN, chan_set() refuses it under a running capture */
+uint8 seq_set_chan(uint8 index, uint8 sel, uint16 blankDelay, uint8 order){
+    return chan_set(index, sel, blankDelay, order);
+}
+
+/* SET_PLANE / CMD_PLANE: the table can't change under a running capture */
+uint8 seq_set_plane(uint8 index, uint8 pulses, uint8 flags, uint32 exposure){
+    if(HW_ENBL_TRIG_ISR_READ() || stageWait){
+        return 0;
+    }
+    return plane_set(index, pulses, flags, exposure);
+}
+
+/* SET_EXPO_SLOT / CMD_EXPO: the table can't change under a running capture */
+uint8 seq_set_expo(uint8 pos, uint8 chan, uint32 ticks){
+    if(HW_ENBL_TRIG_ISR_READ() || stageWait){
+        return 0;
+    }
+    return expo_set(pos, chan, ticks);
+}
+
+/* Most STAGE_REG pulses the sequence sends for one move, each of which
+*  STAGE_TRIG + STAGE_WAIT hold the next frame for; 0 if it never steps
+*/
+static uint8 seq_stage_steps(void){
+    uint8 most = 0;
+    uint8 i;
+
+    if(simMode == SEVEN_PHASE){
+        return stageHandshake == STAGE_HS_HW;
+    }
+    if(seq_plane_table()){
+        /* With STAGE_HS_USB the host makes the moves of more than one pulse */
+        for(i = 0; i < planeCount; i++){
+            uint8 pulses = planeTable[i].pulses;
+
+            if(pulses > 1u && stageHandshake != STAGE_HS_HW){
+                pulses = 0;
+            }
+            if(pulses > most){
+                most = pulses;
+            }
+        }
+        return most;
+    }
+    if(simMode == SIM_PROGRAM){
+        for(i = 0; i < progLen; i++){
+            if(progTable[i].op == PROG_STAGE || (progTable[i].op == PROG_WAIT && stageHandshake == STAGE_HS_HW)){
+                return 1;
+            }
+        }
+    }
+    return mode == Z_MODE && zSteps;
+}
+
+/*******************************************************************************
+* Function Name: seq_check_timing
+********************************************************************************
+*
+* Summary:
+*  START_CAPTURE's static timing check (slm_check.h) of the configured
+*  sequence: the staged periods, every channel of the table and, when the
+*  sequence steps the stage, STAGE_WAIT and the longest move.
+*
+* Return:
+*  The CHECK_BIT()s that failed, 0 if the capture may start.
+*
+*******************************************************************************/
+uint8 seq_check_timing(struct timing_verdict* v){
+    struct timing_config cfg;
+    uint8 i;
+
+    cfg.frame = frameTicks;
+    cfg.exposure = exposureTicks;
+    cfg.wait = wait_time_ticks;
+    cfg.readout = readOutTicks;
+    cfg.stageWait = stageWaitTicks;
+    cfg.stageSettle = STAGE_SETTLE_TICKS;
+    cfg.stagePulse = STAGE_PULSE_TICKS;
+    cfg.chanCount = chanCount;
+    for(i = 0; i < chanCount; i++){
+        cfg.blankDelay[i] = chanBlankDelay(i);
+    }
+    cfg.stageSteps = seq_stage_steps();
+    return timing_check(&cfg, v);
+}
+
+/* Fetch and clear msgFlag in one go so a bit set by T_ISR is never lost */
+uint8 seq_take_events(void){
+    uint8 state = HW_ENTER_CRITICAL();
+    uint8 events = msgFlag;
+    msgFlag = 0;
+    HW_EXIT_CRITICAL(state);
+    return events;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,112 @@
+/*******************************************************************************
+* File Name: slm_seq.h
+*
+* Description:
+*   Hardware independent trigger sequencer.  Decides, once per frame, which
+*   device gets the next trigger (camera route, stage) and when an acquisition
+*   is finished.  All register access goes through slm_hw.h so the same code
+*   runs inside T_ISR on the PSoC and inside the Linux simulator.
+*
+*******************************************************************************/
+
+#ifndef SLM_SEQ_H
+#define SLM_SEQ_H
+
+#include "slm_hw.h"
+#include "slm_check.h"
+
+#define REG_ON (1u)
+#define REG_OFF (0u)
+
+/* Run modes */
+#define FREE_RUN (0u)
+#define Z_MODE (1u)
+#define COUNT_MODE (2u)
+#define TIMED_MODE (3u)    // free run until time_ticks after START_CAPTURE
+#define RUN_MODE_MASK (0x7F)
+#define TIMED_TO_SET_END (0x80) // with TIMED_MODE: the SIM set running at the deadline finishes
+
+/* TIMED_MODE, what happens at the deadline */
+#define TIMED_STOP_EXACT (0u)   // no trigger after it, the frame in flight completes
+#define TIMED_STOP_SET (1u)     // the current SIM set is finished first
+
+/* SIM modes */
+#define THREE_BEAM (0x0)
+#define TWO_BEAM (0x1)
+#define NO_SIM_Z_ONLY (0x2)
+#define SINGLE_ANGLE (0x4)
+#define SEVEN_PHASE (0x8)
+#define SEVEN_FREE (0x10)
+#define SIM_PROGRAM (0x20)  // set shape from the uploaded sequence program (slm_prog.h)
+#define SINGLE_ANGLE_MAX (5u)
+#define THREE_BEAM_MAX (15u)
+#define SEVEN_PHASE_MAX (21u)
+#define TWO_BEAM_MAX (9u)
+#define NO_BEAM_MAX (1u)
+#define TWO_CAM_MIN (2u)
+#define ANGLE_MAX (3u)
+#define AXIAL_MAX (6u)
+
+/* Laser / camera route selection (SET_LASER_MODE), see slm_chan.h for more */
+#define BLUE_LASER (0u)
+#define GREEN_LASER (1u)
+#define BOTH_LASERS (2u)
+
+/* Events raised by the sequencer for the main loop (msgFlag) */
+#define COUNT_FIN 0x01
+#define Z_FIN     0x02
+#define STAGE_REQ 0x04  // SEVEN_PHASE or multi pulse plane done, host has to move the stage
+#define TIMED_FIN 0x08
+
+/* bonus after START_CAPTURE, beside the failed CHECK_BIT()s (slm_check.h):
+*  seq_start() refused an unfinished program, the trigger stays off
+*/
+#define SEQ_REFUSED (0x80)
+
+/* SEVEN_PHASE and multi pulse plane stage handshake, who restarts the trigger */
+#define STAGE_HS_USB (0u)   // host moves the stage, sends STAGE_MOVE_COMPLETE
+#define STAGE_HS_HW (1u)    // STAGE_REG pulse steps the stage, STAGE_READY input restarts
+
+/******** Sequencer state ********/
+extern volatile uint8 phases;
+extern volatile uint8 angles;
+extern volatile uint8 axCount;
+extern volatile uint16 zCount;
+extern volatile uint32 frameCount;
+extern volatile uint32 count_itt;
+extern volatile uint32 time_ticks_rem;
+extern uint32 time_ticks;
+extern volatile uint8 mode;
+extern volatile uint8 simMode;
+extern volatile uint16 zSteps;
+extern volatile uint8 msgFlag;
+extern volatile uint8 phase_max;
+extern volatile uint8 phase_angle;  // phases per angle, CHAN_PER_ANGLE blocks
+extern volatile uint8 laser_conf;
+extern volatile uint8 stageHandshake;
+extern volatile uint8 stageWait;
+extern volatile uint8 timedStop;
+extern volatile uint8 sched_running;
+
+void seq_frame_done(void);
+uint8 seq_start(void);
+void seq_stop(void);
+void seq_set_sim_mode(uint8 sim);
+uint8 seq_set_prog_step(uint8 index, uint8 op, uint8 arg);
+uint8 seq_running(void);
+uint8 seq_set_chan(uint8 index, uint8 sel, uint16 blankDelay, uint8 order);
+uint8 seq_set_plane(uint8 index, uint8 pulses, uint8 flags, uint32 exposure);
+uint8 seq_plane_table(void);
+uint8 seq_set_expo(uint8 pos, uint8 chan, uint32 ticks);
+uint8 seq_set_stage_handshake(uint8 hs);
+void seq_stage_ready(void);
+void seq_stage_move_complete(void);
+void seq_set_run_mode(uint8 runMode);
+void seq_timed_arm(void);
+void seq_time_up(void);
+uint8 seq_check_timing(struct timing_verdict* v);
+uint8 seq_take_events(void);
+
+#endif /* SLM_SEQ_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,273 @@
+/*******************************************************************************
+* File Name: slm_timing.c
+*
+* Description:
+*   Exposure / SLM wait computation shared by the firmware and the simulator.
+*
+*******************************************************************************/
+
+#include "slm_seq.h"
+#include "slm_timing.h"
+#include "slm_chan.h"
+#include "slm_check.h"
+
+uint16 vert = CAM_VERT_DEFAULT;
+uint8 capMode = CAM_MODE_DEFAULT;
+uint32 readOutTicks = 0;
+volatile uint32 frameTicks = CAM_FRAME_DEFAULT;
+volatile uint32 exposureTicks = TEN_EXP;
+volatile float exposure = 0.0386f;
+volatile uint32 exposureMaxTicks = 7720u;
+uint32 exposureReqTicks = 0;
+uint32 wait_time_ticks = 0;
+volatile float fps_in = CAM_FPS_DEFAULT;
+volatile uint8 timingMsg = 0;
+volatile uint8 frameLimit = LIMIT_NONE;
+uint32 stageWaitTicks = STAGE_SETTLE_TICKS;
+volatile uint8 timingPending = 0;
+
+/* Staged counter periods, see timing_stage() */
+static volatile uint32 shadowExposure;
+static volatile uint32 shadowWait;
+static volatile uint32 shadowStage;
+
+#define MAX_SEC (2147.0f)   // secToTicks() saturates here, 2^32 ticks
+
+/* Longest exposure that fits a frame of the given length, negative if none */
+static int32 exposureLimit(uint32 frame){
+    return (int32)frame - (int32)readOutTicks - (int32)(SLM_CNTR_TICKS + SLM_TRG_TICKS);
+}
+
+/* Shortest exposure that outlasts the BLANKING_DELAY of every channel */
+uint32 laserMinTicks(void){
+    uint32 laserTicks = 0;
+    uint8 i;
+
+    for(i = 0; i < chanCount; i++){
+        if(chanBlankDelay(i) + 1u > laserTicks){
+            laserTicks = chanBlankDelay(i) + 1u;
+        }
+    }
+    return laserTicks;
+}
+
+/*******************************************************************************
+* Function Name: minFrameTicks
+********************************************************************************
+*
+* Summary:
+*  The shortest frame, in whole ticks, that exposureLimit() accepts for an
+*  exposure of expTicks: the exposure, the readout and the SLM reload back
+*  to back.  The exposure is raised to outlast the longest BLANKING_DELAY
+*  of the channel table, or that laser would never come on.  Needs
+*  readOutTicks to be current (readTime()).
+*
+* Parameters:
+*  limit: set to the LIMIT_* of the longest of those parts.
+*
+*******************************************************************************/
+uint32 minFrameTicks(uint32 expTicks, uint8* limit){
+    uint32 laserTicks = laserMinTicks();
+    uint32 slmTicks = SLM_CNTR_TICKS + SLM_TRG_TICKS;
+    uint32 longest = expTicks;
+
+    *limit = LIMIT_EXPOSURE;
+    if(expTicks < laserTicks){
+        expTicks = longest = laserTicks;
+        *limit = LIMIT_LASER;
+    }
+    if(readOutTicks > longest){
+        longest = readOutTicks;
+        *limit = LIMIT_READOUT;
+    }
+    if(slmTicks > longest){
+        *limit = LIMIT_SLM;
+    }
+    if(expTicks > 0xFFFFFFFFu - readOutTicks - slmTicks){
+        return 0xFFFFFFFFu;
+    }
+    return expTicks + readOutTicks + slmTicks;
+}
+
+/* For messages */
+const char* limitName(uint8 limit){
+    static const char* const names[] = {"none", "exposure", "laser", "readout", "slm"};
+
+    return (limit <= LIMIT_SLM) ? names[limit] : "?";
+}
+
+/*******************************************************************************
+* Function Name: setExposure
+********************************************************************************
+*
+* Summary:
+*  Uses the longest exposure that fits frameTicks and stages it with the
+*  SLM wait for the next frame.  When the readout does not fit the frame,
+*  the frame becomes the fastest one minFrameTicks() finds for the exposure
+*  the host last asked for (exposureReqTicks), so that exposure is kept
+*  unless the laser needs a longer one, and frameLimit says why.
+*
+*******************************************************************************/
+void setExposure(void){
+    int32 maxTicks;
+
+    readTime();
+    frameLimit = LIMIT_NONE;
+    maxTicks = exposureLimit(frameTicks);
+    if(maxTicks < 0){
+        frameTicks = minFrameTicks(exposureReqTicks, (uint8*)&frameLimit);
+        fps_in = ticksToFps(frameTicks);
+        timingMsg |= FPS_CHANGED;
+        maxTicks = exposureLimit(frameTicks);
+    }
+
+    exposureMaxTicks = (uint32)maxTicks;
+    exposureTicks = exposureMaxTicks;
+    exposure = ticksToSec(exposureTicks);
+    timingMsg |= EXP_CHANGED;
+    setWaitTime();
+    timing_stage();
+
+}
+
+/*******************************************************************************
+* Function Name: userSetExposure
+********************************************************************************
+*
+* Summary:
+*  Applies a host requested exposure.  Without arbExp the exposure is clamped
+*  to exposureMaxTicks, with arbExp the frame rate follows the exposure
+*  instead.  The request is kept in exposureReqTicks for setExposure().
+*
+*******************************************************************************/
+void userSetExposure(uint8 arbExp){
+    uint32 ticks = secToTicks(exposure);
+
+    exposureReqTicks = ticks;
+
+    if(!arbExp){
+        int32 maxTicks = exposureLimit(frameTicks);
+
+        exposureMaxTicks = (maxTicks < 0) ? 0u : (uint32)maxTicks;
+        if(exposureMaxTicks < ticks){
+            ticks = exposureMaxTicks;
+            exposure = ticksToSec(ticks);
+            timingMsg |= EXP_CHANGED;
+        }
+    } else {
+        /* The frame the chain runs with the shortest SLM_WAIT, so
+        *  timing_check() finds it kept
+        */
+        frameTicks = ticks + timing_wait(0, ticks, readOutTicks) + SLM_TRG_TICKS;
+        fps_in = ticksToFps(frameTicks);
+        timingMsg |= FPS_CHANGED;
+    }
+    exposureTicks = ticks;
+    setWaitTime();
+    timing_stage();
+
+}
+
+void setWaitTime(void){
+    wait_time_ticks = waitTicks(exposureTicks);
+}
+
+/* SLM_WAIT after an exposure of expTicks: the readout, stretched to fill
+*  frameTicks.  Also used by T_ISR for the planes of a Z table.
+*/
+uint32 waitTicks(uint32 expTicks){
+    return timing_wait(frameTicks, expTicks, readOutTicks);
+}
+
+/* Readout of vert rows in the active readout mode */
+void readTime(void){
+    readOutTicks = timing_readout(CAM_ACTIVE(), vert);
+}
+
+/* BLANKING_DELAY of a channel, the camera's value for its route unless set */
+uint16 chanBlankDelay(uint8 chan){
+    return timing_blank_delay(CAM_ACTIVE(), &chanTable[chan]);
+}
+
+/* Laser blanking follows the camera on the channel in use, T_ISR switches
+*  it per frame
+*/
+void setBlankingDelay(void){
+    timing_stage();
+}
+
+/*******************************************************************************
+* Function Name: timing_stage
+********************************************************************************
+*
+* Summary:
+*  Stages exposureTicks, wait_time_ticks and stageWaitTicks as one set.
+*  While T_ISR runs the trigger the set waits for timing_commit() at the
+*  end of the current frame; a set staged twice in one frame only leaves
+*  the newer one.  With the trigger stopped it is written now and TRG_CNT
+*  reloaded.  The schedule DMA has no T_ISR to commit it, so under
+*  SCHED_CAPTURE the periods are written straight away and each counter
+*  takes its new period at its next reload.
+*
+*******************************************************************************/
+void timing_stage(void){
+    uint8 state = HW_ENTER_CRITICAL();
+
+    shadowExposure = exposureTicks;
+    shadowWait = wait_time_ticks;
+    shadowStage = stageWaitTicks;
+    timingPending = 1;
+    if(HW_ENBL_TRIG_ISR_READ() && !sched_running){
+        HW_EXIT_CRITICAL(state);
+        return;
+    }
+    timing_commit();
+    HW_EXIT_CRITICAL(state);
+    if(!sched_running){
+        HW_TRIG_CNT_RST_WRITE(REG_ON);
+        HW_TRIG_CNT_RST_WRITE(REG_OFF);
+    }
+}
+
+/* T_ISR, frame boundary: the staged set, if there is one */
+void timing_commit(void){
+    if(!timingPending){
+        return;
+    }
+    timingPending = 0;
+    HW_TRG_CNT_WRITE_PERIOD(shadowExposure);
+    HW_SLM_WAIT_WRITE_PERIOD(shadowWait);
+    HW_BLANKING_DELAY_WRITE_PERIOD(chanBlankDelay(chanActive));
+    HW_STAGE_WAIT_WRITE_PERIOD(shadowStage);
+}
+
+/* Host boundary: the protocol carries seconds and fps as float */
+uint32 secToTicks(float sec){
+    if(sec <= 0.0f){
+        return 0;
+    }
+    if(sec >= MAX_SEC){
+        return 0xFFFFFFFFu;
+    }
+    return (uint32)(sec * (float)TICKS_PER_SEC + 0.5f);
+}
+
+float ticksToSec(uint32 ticks){
+    return (float)ticks * COUNT_PERIOD;
+}
+
+uint32 fpsToTicks(float fps){
+    if(fps <= 0.0f){
+        return 0;
+    }
+    return secToTicks(1.0f / fps);
+}
+
+float ticksToFps(uint32 ticks){
+    if(ticks == 0){
+        return 0.0f;
+    }
+    return (float)TICKS_PER_SEC / (float)ticks;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,105 @@
+/*******************************************************************************
+* File Name: slm_timing.h
+*
+* Description:
+*   Frame timing for the trigger counter chain.  Converts the requested frame
+*   rate / exposure into TRG_CNT (exposure) and SLM_WAIT (readout + SLM
+*   reload) periods for the camera in use.  The camera comes from the build
+*   (slm_camera.h), the readout mode from capMode.
+*
+*   Everything is worked out in integer 2MHz ticks; the Cortex-M3 has no FPU
+*   and the old double math went through soft-float on every FPS / exposure /
+*   laser / readout change.  Float only appears at the USB boundary, where
+*   the host sends and expects fps and seconds (secToTicks() etc.).
+*
+*   The main loop never writes a counter period of a running acquisition.
+*   timing_stage() copies exposure, SLM wait and stage wait into a shadow
+*   that T_ISR commits with timing_commit() at the next frame boundary,
+*   together with the BLANKING_DELAY of the channel in use, so a frame is
+*   always timed by one consistent set.  With the trigger stopped the set
+*   is written at once.
+*
+*******************************************************************************/
+
+#ifndef SLM_TIMING_H
+#define SLM_TIMING_H
+
+#include "slm_hw.h"
+#include "slm_camera.h"
+
+#define COUNT_PERIOD (0.0000005f) // 2MHz counter ticks 500ns
+#define SLM_CNTR_TICKS (5360u)    // 1.18ms + 1.5ms
+#define SLM_TRG_TICKS (200u)      // 50us
+//#define ANDOR_READ_TIME (2000u)   // 1MHz worst case is 1ms
+#define THIRTY_FPS (66667u)       // 33.3ms
+#define THIRTY_EXP (40955u)       // 33.3ms - 1ms - 1.18ms * 2
+#define THIRTY (30.0f)
+#define TEN (10.0f)
+#define TEN_FPS (200000u)
+#define TEN_EXP (77200u)        // 100ms - 1ms - 1.18ms * 2 - 56.8ms work damn you!
+#define FIFTEEN (15.0f)
+#define FIFTEEN_FPS (133333u)
+#define TWENTY_FOUR (24.0f)
+#define TWENTY (20.0f)
+#define TWENTY_FPS (100000u)
+#define TWENTY_FOUR_FPS (83333u)
+#define TWENTY_EXP (3940u)       // 50ms - 1ms -1.18ms*2 - 39ms -4.43ms = 1.97ms
+#define FOURTY_EIGHT (48.0f)
+#define FOURTY_EIGHT_FPS (41666u)
+#define TWENTY_SIX_FPS (76923u)
+#define TWENTY_SIX (26.0f)
+#define STAGE_TICKS (180000u)     // Xms for stage trigger
+#define STAGE_SETTLE_TICKS (38000u) // STAGE_WAIT, stage move and settle
+#define STAGE_PULSE_TICKS (12000u)  // STAGE_TRIG, stage step pulse
+//#define STAGE_TICKS (12000u)
+#define STUPID (0u)//(200000u)
+
+/* Timing changes the host has to be told about (timingMsg) */
+#define FPS_CHANGED 0x01
+#define EXP_CHANGED 0x02
+
+/* What set the frame when the requested one did not fit (frameLimit), the
+*  longest part of the fastest frame minFrameTicks() found
+*/
+#define LIMIT_NONE (0u)       // the requested frame fits
+#define LIMIT_EXPOSURE (1u)   // the exposure asked for
+#define LIMIT_LASER (2u)      // exposure raised to outlast BLANKING_DELAY
+#define LIMIT_READOUT (3u)    // camera readout, vert rows at the row time
+#define LIMIT_SLM (4u)        // SLM reload and trigger
+
+extern uint16 vert;
+extern uint8 capMode;
+extern uint32 readOutTicks;
+extern volatile uint32 frameTicks;
+extern volatile uint32 exposureTicks;
+extern volatile float exposure;
+extern volatile uint32 exposureMaxTicks;
+extern uint32 exposureReqTicks;     // last host requested exposure, 0 for none
+extern uint32 wait_time_ticks;
+extern volatile float fps_in;
+extern volatile uint8 timingMsg;
+extern volatile uint8 frameLimit;
+extern uint32 stageWaitTicks;
+extern volatile uint8 timingPending;
+
+void setExposure(void);
+void userSetExposure(uint8 arbExp);
+void setWaitTime(void);
+uint32 waitTicks(uint32 expTicks);
+void readTime(void);
+void setBlankingDelay(void);
+uint16 chanBlankDelay(uint8 chan);
+void timing_stage(void);
+void timing_commit(void);
+uint32 minFrameTicks(uint32 expTicks, uint8* limit);
+uint32 laserMinTicks(void);
+const char* limitName(uint8 limit);
+
+uint32 secToTicks(float sec);
+float ticksToSec(uint32 ticks);
+uint32 fpsToTicks(float fps);
+float ticksToFps(uint32 ticks);
+
+#endif /* SLM_TIMING_H */
+
+/* [] END OF FILE */
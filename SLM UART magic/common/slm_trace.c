@@ -0,0 +1,130 @@
+/*******************************************************************************
+* File Name: slm_trace.c
+*
+* Description:
+*   USB session trace ring, see slm_trace.h.  Only the main loop writes and
+*   drains it, so no critical sections are needed.
+*
+*******************************************************************************/
+
+#include "slm_trace.h"
+#include "slm_timing.h"
+
+/******** The Land Of Globals ********/
+volatile uint8 traceOn = 0;
+
+static uint8 traceRing[TRACE_RING_SIZE];
+static uint16 traceHead = 0;
+static uint16 traceTail = 0;
+static uint32 traceDropped = 0;
+static uint32 traceReported = 0;
+
+static void trace_put(const uint8* data, uint16 len){
+    while(len--){
+        traceRing[traceHead] = *data++;
+        traceHead = (traceHead + 1u) & (TRACE_RING_SIZE - 1u);
+    }
+}
+
+static void put32(uint8* p, uint32 v){
+    p[0] = (uint8)v;
+    p[1] = (uint8)(v >> 8);
+    p[2] = (uint8)(v >> 16);
+    p[3] = (uint8)(v >> 24);
+}
+
+/* Starts a capture with an empty ring and a TRACE_CLOCK record */
+void trace_start(void){
+    uint8 hz[4];
+
+    traceHead = traceTail = 0;
+    traceDropped = traceReported = 0;
+    traceOn = 1;
+    put32(hz, HW_TS_HZ);
+    trace_packet(TRACE_CLOCK, hz, sizeof(hz));
+}
+
+/* What is in the ring still goes out */
+void trace_stop(void){
+    traceOn = 0;
+}
+
+/*******************************************************************************
+* Function Name: trace_packet
+********************************************************************************
+*
+* Summary:
+*  Appends one record, stamped with time.  A record that does not fit in the
+*  ring is dropped whole, so the stream stays parseable.
+*
+*******************************************************************************/
+void trace_packet_at(uint32 time, uint8 kind, const uint8* data, uint16 len){
+    uint8 hdr[TRACE_REC_HDR];
+    uint16 used = (traceHead - traceTail) & (TRACE_RING_SIZE - 1u);
+
+    if(!traceOn){
+        return;
+    }
+    if(len > 0xFFu){
+        len = 0xFFu;
+    }
+    if(used + TRACE_REC_HDR + len >= TRACE_RING_SIZE){
+        traceDropped++;
+        return;
+    }
+    put32(hdr, time);
+    hdr[4] = kind;
+    hdr[5] = (uint8)len;
+    trace_put(hdr, TRACE_REC_HDR);
+    trace_put(data, len);
+}
+
+/* Appends one record stamped now */
+void trace_packet(uint8 kind, const uint8* data, uint16 len){
+    trace_packet_at(HW_TS_NOW(), kind, data, len);
+}
+
+/* After a command packet has been applied */
+void trace_state(void){
+    uint8 s[12];
+
+    if(!traceOn){
+        return;
+    }
+    put32(&s[0], frameTicks);
+    put32(&s[4], exposureTicks);
+    put32(&s[8], wait_time_ticks);
+    trace_packet(TRACE_STATE, s, sizeof(s));
+}
+
+/*******************************************************************************
+* Function Name: trace_fill
+********************************************************************************
+*
+* Summary:
+*  Moves up to TRACE_PER_PACKET bytes of the record stream into p.  Records
+*  may be split over packets.
+*
+* Return:
+*  0 if there is nothing to send, neither bytes nor new drops.
+*
+*******************************************************************************/
+uint8 trace_fill(struct trace_packet* p){
+    uint8 n = 0;
+
+    while(traceTail != traceHead && n < TRACE_PER_PACKET){
+        p->data[n++] = traceRing[traceTail];
+        traceTail = (traceTail + 1u) & (TRACE_RING_SIZE - 1u);
+    }
+    if(n == 0 && traceDropped == traceReported){
+        return 0;
+    }
+    p->magic = TRACE_MAGIC;
+    p->len = n;
+    p->flags = 0;
+    p->dropped = (traceDropped - traceReported > 0xFFFFu) ? 0xFFFFu : (uint16)(traceDropped - traceReported);
+    traceReported = traceDropped;
+    return 1;
+}
+
+/* [] END OF FILE */
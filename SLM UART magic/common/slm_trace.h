@@ -0,0 +1,71 @@
+/*******************************************************************************
+* File Name: slm_trace.h
+*
+* Description:
+*   USB session trace.  While capturing (TRACE_CAPTURE / CMD_TRACE) the
+*   main loop logs every OUT packet, stamped with its arrival, the timing the
+*   core ended up with after applying it, and every ack or event carrying
+*   status packet it sends.  The packet that starts a capture is included.  Plain status packets without one-shot flags are left out, they
+*   would fill the ring at the host's poll rate.
+*
+*   Records are packed into a byte ring and streamed to the host in struct
+*   trace_packet IN packets, which take turns with the status like the
+*   timestamps do.  The host appends their data to a trace file as is.  The
+*   host client (host/slm_client.h) writes the same format from its own
+*   side of the link, and sim/slm_replay plays either kind back.
+*
+*   Trace file, little endian:
+*     struct trace_file_hdr, then records of
+*     [time:4][kind:1][len:1][data:len] back to back.
+*   time is in the tick rate of the last TRACE_CLOCK record and wraps at 32
+*   bits; each capture starts with a TRACE_CLOCK.
+*
+*******************************************************************************/
+
+#ifndef SLM_TRACE_H
+#define SLM_TRACE_H
+
+#include "slm_hw.h"
+
+#define TRACE_MAGIC (0x524D4C53u)     // "SLMR", file header and IN packets
+#define TRACE_VERSION (1u)
+#define TRACE_RING_SIZE (1024u)       // bytes, power of two
+#define TRACE_PER_PACKET (56u)
+#define TRACE_REC_HDR (6u)            // time + kind + len
+
+/* Record kinds */
+#define TRACE_CLOCK (0x01)    // data = uint32 ticks per second
+#define TRACE_OUT (0x02)      // data = OUT packet
+#define TRACE_IN (0x03)       // data = IN packet
+#define TRACE_STATE (0x04)    // data = uint32 frameTicks, exposureTicks, wait_time_ticks
+
+/* struct trace_file_hdr flags */
+#define TRACE_FROM_DEVICE (0x01)    // recorded by the firmware, has TRACE_STATE
+#define TRACE_FROM_HOST (0x02)      // recorded by the host client
+
+struct trace_file_hdr{
+    uint32 magic;
+    uint16 version;
+    uint16 flags;
+};
+
+struct trace_packet{
+    uint32 magic;
+    uint8 len;          // bytes of data used
+    uint8 flags;
+    uint16 dropped;     // records lost to a full ring since the last packet
+    uint8 data[TRACE_PER_PACKET];
+};
+
+extern volatile uint8 traceOn;
+
+void trace_start(void);
+void trace_stop(void);
+void trace_packet(uint8 kind, const uint8* data, uint16 len);
+void trace_packet_at(uint32 time, uint8 kind, const uint8* data, uint16 len);
+void trace_state(void);
+uint8 trace_fill(struct trace_packet* p);
+
+#endif /* SLM_TRACE_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,98 @@
+/*******************************************************************************
+* File Name: slm_ts.c
+*
+* Description:
+*   Trigger timestamp ring, see slm_ts.h.  ts_record() runs in T_ISR, the
+*   drain in the main loop; each side only moves its own index.
+*
+*******************************************************************************/
+
+#include "slm_ts.h"
+
+/******** The Land Of Globals ********/
+volatile uint32 tsDropped = 0;
+
+static struct ts_entry tsRing[TS_RING_SIZE];
+static volatile uint16 tsHead = 0;
+static volatile uint16 tsTail = 0;
+static uint16 tsSeq = 0;
+static uint32 tsReported = 0;
+
+void ts_init(void){
+    HW_TS_START();
+    tsHead = tsTail = 0;
+    tsSeq = 0;
+    tsDropped = tsReported = 0;
+}
+
+static void ts_put(uint8 kind, uint8 info, uint32 time){
+    uint16 head = tsHead;
+    uint16 next = (head + 1u) & (TS_RING_SIZE - 1u);
+
+    if(next == tsTail){
+        tsDropped++;
+        tsSeq++;
+        return;
+    }
+    tsRing[head].time = time;
+    tsRing[head].seq = tsSeq++;
+    tsRing[head].kind = kind;
+    tsRing[head].info = info;
+    tsHead = next;
+}
+
+/*******************************************************************************
+* Function Name: ts_record
+********************************************************************************
+*
+* Summary:
+*  Stamps one event.  Called from T_ISR, or with interrupts off.
+*
+*******************************************************************************/
+void ts_record(uint8 kind, uint8 info){
+    ts_put(kind, info, HW_TS_NOW());
+}
+
+/* START_CAPTURE, from the main loop */
+void ts_mark_start(void){
+    uint8 s = HW_ENTER_CRITICAL();
+
+    ts_put(TS_CLOCK, 0, HW_TS_HZ);
+    ts_record(TS_START, 0);
+    HW_EXIT_CRITICAL(s);
+}
+
+/*******************************************************************************
+* Function Name: ts_fill
+********************************************************************************
+*
+* Summary:
+*  Moves up to TS_PER_PACKET entries from the ring into p.
+*
+* Return:
+*  0 if there is nothing to send, neither entries nor new drops.
+*
+*******************************************************************************/
+uint8 ts_fill(struct ts_packet* p){
+    uint16 tail = tsTail;
+    uint16 head = tsHead;
+    uint32 dropped = tsDropped;
+    uint8 n = 0;
+
+    while(tail != head && n < TS_PER_PACKET){
+        p->entry[n++] = tsRing[tail];
+        tail = (tail + 1u) & (TS_RING_SIZE - 1u);
+    }
+    if(n == 0 && dropped == tsReported){
+        return 0;
+    }
+    tsTail = tail;
+    p->magic = USB_TS_MAGIC;
+    p->count = n;
+    p->flags = 0;
+    p->dropped = (dropped - tsReported > 0xFFFFu) ? 0xFFFFu : (uint16)(dropped - tsReported);
+    tsReported = dropped;
+    return 1;
+}
+
+/* [] END OF FILE */
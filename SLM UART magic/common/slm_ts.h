@@ -0,0 +1,61 @@
+/*******************************************************************************
+* File Name: slm_ts.h
+*
+* Description:
+*   Trigger timestamp ring.  T_ISR stamps every finished frame and every
+*   STAGE_REG pulse with the free-running HW_TS_NOW() counter into an SRAM
+*   ring, the main loop drains it to the host in struct ts_packet IN packets
+*   (slm_usb.c).  The ring never overwrites, a full ring counts the event as
+*   dropped and the gap shows up in the entry sequence numbers.
+*
+*   Times are in HW_TS_HZ units and wrap at 32 bits.  A TS_CLOCK entry,
+*   written at every capture start, carries HW_TS_HZ in its time field so the
+*   host does not have to know the bus clock.  DMA schedule replays
+*   (slm_sched.h) have no T_ISR and are only marked by their TS_START.
+*
+*******************************************************************************/
+
+#ifndef SLM_TS_H
+#define SLM_TS_H
+
+#include "slm_hw.h"
+
+#define TS_RING_SIZE (256u)     // entries, power of two, 2kB
+#define TS_PER_PACKET (7u)
+
+#define USB_TS_MAGIC (0x544D4C53u)  // "SLMT"
+
+/* Entry kinds */
+#define TS_FRAME (0x01)     // T_ISR, info = phase (angle in SEVEN_PHASE) | TS_INFO_CHAN
+#define TS_STAGE (0x02)     // STAGE_REG pulse, info = low byte of the plane
+#define TS_START (0x03)     // START_CAPTURE enabled the trigger
+#define TS_CLOCK (0x04)     // time = HW_TS_HZ
+
+#define TS_INFO_PHASE (0x1F)            // low bits of the phase
+#define TS_INFO_CHAN(c) ((uint8)((c) << 5))   // channel the frame went out on (slm_chan.h)
+
+struct ts_entry{
+    uint32 time;
+    uint16 seq;
+    uint8 kind;
+    uint8 info;
+};
+
+struct ts_packet{
+    uint32 magic;
+    uint8 count;
+    uint8 flags;
+    uint16 dropped;     // events lost to a full ring since the last packet
+    struct ts_entry entry[TS_PER_PACKET];
+};
+
+extern volatile uint32 tsDropped;
+
+void ts_init(void);
+void ts_record(uint8 kind, uint8 info);
+void ts_mark_start(void);
+uint8 ts_fill(struct ts_packet* p);
+
+#endif /* SLM_TS_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,441 @@
+/*******************************************************************************
+* File Name: slm_usb.c
+*
+* Description:
+*   Non-blocking IN / OUT endpoint handling for the vendor bulk protocol,
+*   command batch framing and acks.  See slm_usb.h.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "slm_usb.h"
+#include "slm_frames.h"
+
+volatile struct usb_data incoming;
+volatile struct usb_data outgoing;
+
+static uint8 outState = USB_OUT_IDLE;
+static uint8 outBuffer[USB_EP_SIZE];
+static uint16 outLen;
+static uint32 outTime;
+static uint16 rxPos;
+
+/* IN DMA reads from here, so outgoing can change while the host is slow.
+*  It also holds the last status sent, to tell whether the next one is news.
+*/
+static struct usb_status inBuffer;
+static struct usb_status statusNext;
+static uint32 statusPeriod = USB_STATUS_PERIOD_MS * (HW_TS_HZ / 1000u);
+static uint32 statusTime;
+static uint8 statusDue;
+static uint16 statusLen = sizeof(struct usb_data);     // sizeof(struct usb_status) after STATUS_COUNTERS
+static struct usb_ack ackBuffer;
+static struct usb_ack ackPending;
+static struct ts_packet tsBuffer;
+static struct isr_stats_packet histBuffer;
+static struct trace_packet traceBuffer;
+static uint8 histPending;
+static uint8 traceTurn;
+#if (TS_EP_NUM == 0u)
+static uint8 tsShared;
+static uint8 tsTurn;
+#endif
+
+static uint16 get16(const uint8* p){
+    return (uint16)(p[0] | (p[1] << 8));
+}
+
+static uint32 get32(const uint8* p){
+    return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static float getFloat(const uint8* p){
+    uint32 bits = get32(p);
+    float f;
+
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/* (Re)arm the OUT endpoint, after enumeration or a configuration change */
+void usb_link_init(void){
+    outState = USB_OUT_IDLE;
+    ackPending.count = 0;
+    ackPending.flags = 0;
+    histPending = 0;
+    statusDue = 1;
+    statusLen = sizeof(struct usb_data);
+#if (TS_EP_NUM == 0u)
+    tsShared = 0;
+#endif
+    HW_USB_ENABLE_OUT_EP(OUT_EP_NUM);
+}
+
+/* Acks usb_cmd_next() would queue for the batch in outBuffer: one per
+*  record up to the first it can't frame, and one for that
+*/
+static uint8 batch_acks(void){
+    uint16 pos = sizeof(uint32);
+    uint8 n = 0;
+
+    while(pos + USB_CMD_HDR <= outLen){
+        n++;
+        if(outBuffer[pos] >= CMD_COUNT || pos + USB_CMD_HDR + usbCmdLen[outBuffer[pos]] > outLen){
+            break;
+        }
+        pos += USB_CMD_HDR + usbCmdLen[outBuffer[pos]];
+    }
+    return n;
+}
+
+/*******************************************************************************
+* Function Name: usb_link_poll_out
+********************************************************************************
+*
+* Summary:
+*  Starts the DMA copy of a received OUT packet, and on a later pass, once
+*  the copy is done, re-arms the endpoint and classifies the packet.
+*
+* Return:
+*  USB_RX_LEGACY when incoming holds a new struct usb_data, USB_RX_BATCH
+*  when usb_cmd_next() has records to hand out, USB_RX_NONE otherwise.
+*
+*******************************************************************************/
+uint8 usb_link_poll_out(void){
+    uint8 state = HW_USB_EP_STATE(OUT_EP_NUM);
+
+    if(outState == USB_OUT_IDLE){
+        if(state == HW_USB_OUT_BUFFER_FULL){
+            outLen = HW_USB_EP_COUNT(OUT_EP_NUM);
+            if(outLen > USB_EP_SIZE){
+                outLen = USB_EP_SIZE;
+            }
+            HW_USB_READ_OUT_EP(OUT_EP_NUM, outBuffer, outLen);
+            outState = USB_OUT_COPY;
+        }
+        return USB_RX_NONE;
+    }
+
+    /* USB_OUT_COPY: the endpoint reads FULL until the DMA has finished */
+    if(state == HW_USB_OUT_BUFFER_FULL){
+        return USB_RX_NONE;
+    }
+    HW_USB_ENABLE_OUT_EP(OUT_EP_NUM);
+    outState = USB_OUT_IDLE;
+    outTime = HW_TS_NOW();
+
+    if(outLen >= sizeof(uint32) && get32(outBuffer) == USB_CMD_MAGIC){
+        rxPos = sizeof(uint32);
+        if(batch_acks() > USB_ACK_MAX){
+            usb_cmd_ack(get16(&outBuffer[rxPos + 1u]), CMD_BAD_BATCH);
+            rxPos = outLen;
+        }
+        return USB_RX_BATCH;
+    }
+    memcpy((void*)&incoming, outBuffer, outLen < sizeof(struct usb_data) ? outLen : sizeof(struct usb_data));
+    /* A legacy host reads a status packet back for every packet it writes */
+    statusDue = 1;
+    return USB_RX_LEGACY;
+}
+
+/* Logs the packet usb_link_poll_out() returned, once it has been applied,
+*  so a packet that starts a trace capture is in the trace too.
+*/
+void usb_link_trace_out(void){
+    trace_packet_at(outTime, TRACE_OUT, outBuffer, outLen);
+}
+
+/*******************************************************************************
+* Function Name: status_poll
+********************************************************************************
+*
+* Summary:
+*  Loads outgoing with the frame counters on ep if it differs from the last
+*  status sent, a reply is due, or the heartbeat period is up, and clears
+*  the one-shot flags that went with it.  Only its struct usb_data goes
+*  out until the host sets STATUS_COUNTERS.
+*
+* Return:
+*  1 if a packet was loaded.
+*
+*******************************************************************************/
+static uint8 status_poll(uint8 ep){
+    struct frame_counts fc;
+    uint32 now = HW_TS_NOW();
+
+    frames_read(&fc);
+    outgoing.count = fc.triggers;
+    statusNext.d = *(struct usb_data*)&outgoing;
+    if(fc.late || fc.skipped){
+        statusNext.d.flags |= LATE_FRAMES;
+    }
+    statusNext.slm = fc.slm;
+    statusNext.stage = fc.stage;
+    statusNext.late = fc.late;
+    statusNext.skipped = fc.skipped;
+    statusNext.lateMax = fc.lateMax;
+    statusNext.reserved = 0;
+    if(!statusDue && !memcmp(&statusNext, &inBuffer, statusLen)
+        && (statusPeriod == 0 || now - statusTime < statusPeriod)){
+        return 0;
+    }
+    inBuffer = statusNext;
+    statusDue = 0;
+    statusTime = now;
+    if(inBuffer.d.flags & USB_ONE_SHOT){
+        trace_packet(TRACE_IN, (const uint8*)&inBuffer.d, sizeof(struct usb_data));
+    }
+    HW_USB_LOAD_IN_EP(ep, (uint8*)&inBuffer, statusLen);
+    outgoing.flags &= ~USB_ONE_SHOT;
+    return 1;
+}
+
+/*******************************************************************************
+* Function Name: usb_link_poll_in
+********************************************************************************
+*
+* Summary:
+*  If the host has read the last IN packet, sends the pending batch acks or
+*  T_ISR histogram, or else a status packet if one is due (status_poll()).
+*  Timestamps go out on their own endpoint, or take every other packet
+*  once the host has set STATUS_TS.  Trace packets take every other of the turns left.
+*
+* Return:
+*  1 if a packet was loaded.
+*
+*******************************************************************************/
+uint8 usb_link_poll_in(void){
+#if (TS_EP_NUM != 0u)
+    if(HW_USB_EP_STATE(TS_EP_NUM) == HW_USB_IN_BUFFER_EMPTY && ts_fill(&tsBuffer)){
+        HW_USB_LOAD_IN_EP(TS_EP_NUM, (uint8*)&tsBuffer, sizeof(struct ts_packet));
+    }
+#endif
+#if (STATUS_EP_NUM != 0u)
+    if(HW_USB_EP_STATE(STATUS_EP_NUM) == HW_USB_IN_BUFFER_EMPTY){
+        status_poll(STATUS_EP_NUM);
+    }
+#endif
+    if(HW_USB_EP_STATE(IN_EP_NUM) != HW_USB_IN_BUFFER_EMPTY){
+        return 0;
+    }
+    if(ackPending.count || ackPending.flags){
+        ackBuffer = ackPending;
+        ackBuffer.magic = USB_ACK_MAGIC;
+        ackPending.count = 0;
+        ackPending.flags = 0;
+        trace_packet(TRACE_IN, (const uint8*)&ackBuffer, sizeof(struct usb_ack));
+        HW_USB_LOAD_IN_EP(IN_EP_NUM, (uint8*)&ackBuffer, sizeof(struct usb_ack));
+        return 1;
+    }
+    if(histPending){
+        histPending = 0;
+        HW_USB_LOAD_IN_EP(IN_EP_NUM, (uint8*)&histBuffer, sizeof(struct isr_stats_packet));
+        return 1;
+    }
+#if (TS_EP_NUM == 0u)
+    tsTurn ^= 1u;
+    if(tsShared && tsTurn && ts_fill(&tsBuffer)){
+        HW_USB_LOAD_IN_EP(IN_EP_NUM, (uint8*)&tsBuffer, sizeof(struct ts_packet));
+        return 1;
+    }
+#endif
+    traceTurn ^= 1u;
+    if(traceTurn && trace_fill(&traceBuffer)){
+        HW_USB_LOAD_IN_EP(IN_EP_NUM, (uint8*)&traceBuffer, sizeof(struct trace_packet));
+        return 1;
+    }
+#if (STATUS_EP_NUM == 0u)
+    return status_poll(IN_EP_NUM);
+#else
+    return 0;
+#endif
+}
+
+/* SET_STATUS_RATE / CMD_STATUS_RATE / CMD_STATUS_MODE: returns the period
+*  in use, ms.  STATUS_TS and STATUS_COUNTERS are kept until the next call
+*  or usb_link_init().
+*/
+uint16 usb_set_status_period(uint32 ms, uint8 mode){
+    if(ms > USB_STATUS_PERIOD_MAX){
+        ms = USB_STATUS_PERIOD_MAX;
+    }
+    statusPeriod = ms * (HW_TS_HZ / 1000u);
+    statusDue = 1;
+    statusLen = (mode & STATUS_COUNTERS) ? sizeof(struct usb_status) : sizeof(struct usb_data);
+#if (TS_EP_NUM == 0u)
+    tsShared = (mode & STATUS_TS) ? 1u : 0u;
+#else
+    (void)mode;
+#endif
+    return (uint16)ms;
+}
+
+/* READ_ISR_STATS: snapshot now, sent ahead of the next status packet */
+void usb_queue_isr_stats(void){
+    isr_stats_fill(&histBuffer);
+    histPending = 1;
+}
+
+/*******************************************************************************
+* Function Name: usb_cmd_next
+********************************************************************************
+*
+* Summary:
+*  Hands out the next record of the batch read by usb_link_poll_out().  An
+*  unknown opcode or a truncated record is acked as bad and ends the batch,
+*  since the rest of the packet can't be framed any more.
+*
+* Return:
+*  1 if cmd was filled in, 0 at the end of the batch.
+*
+*******************************************************************************/
+uint8 usb_cmd_next(struct usb_cmd* cmd){
+    if(rxPos + USB_CMD_HDR > outLen){
+        rxPos = outLen;
+        return 0;
+    }
+    cmd->op = outBuffer[rxPos];
+    cmd->seq = get16(&outBuffer[rxPos + 1u]);
+    cmd->payload = &outBuffer[rxPos + USB_CMD_HDR];
+    if(cmd->op >= CMD_COUNT){
+        usb_cmd_ack(cmd->seq, CMD_BAD_OP);
+        rxPos = outLen;
+        return 0;
+    }
+    if(rxPos + USB_CMD_HDR + usbCmdLen[cmd->op] > outLen){
+        usb_cmd_ack(cmd->seq, CMD_BAD_LEN);
+        rxPos = outLen;
+        return 0;
+    }
+    rxPos += USB_CMD_HDR + usbCmdLen[cmd->op];
+    return 1;
+}
+
+/*******************************************************************************
+* Function Name: usb_cmd_load
+********************************************************************************
+*
+* Summary:
+*  Turns a record into the struct usb_data / flags form the command handlers
+*  already understand, one flag per record.
+*
+* Return:
+*  CMD_OK, or CMD_BAD_OP for an opcode this firmware does not handle.
+*
+*******************************************************************************/
+uint8 usb_cmd_load(const struct usb_cmd* cmd, volatile struct usb_data* buf){
+    const uint8* p = cmd->payload;
+
+    buf->flags = 0;
+    buf->mode = 0;
+    switch(cmd->op){
+        case CMD_NOP:
+            break;
+        case CMD_FPS:
+            buf->fps = getFloat(p);
+            buf->flags = CHANGE_FPS;
+            break;
+        case CMD_Z_STEPS:
+            buf->steps = get16(p);
+            buf->flags = CHANGE_Z_STEPS;
+            break;
+        case CMD_READOUT:
+            buf->flags = SET_READOUT_SPEED | (p[0] ? SLOW_READOUT : 0u);
+            break;
+        case CMD_LASER:
+            buf->mode = p[0];
+            buf->flags = SET_LASER_MODE;
+            break;
+        case CMD_RUN_MODE:
+            buf->mode = p[0];
+            buf->count = get32(&p[1]);
+            buf->flags = SET_RUN_MODE;
+            break;
+        case CMD_SIM_MODE:
+            buf->mode = p[0];
+            buf->flags = SET_SIM_MODE;
+            break;
+        case CMD_EXPOSURE:
+            buf->exposure = getFloat(p);
+            buf->mode = p[4] ? ARB_EXP : 0u;
+            buf->flags = SET_EXPOSURE;
+            break;
+        case CMD_BLANKING:
+            buf->mode = p[0] ? START_BLANKING : STOP_BLANKING;
+            buf->flags = TOGGLE_BLANKING;
+            break;
+        case CMD_START:
+            buf->flags = START_CAPTURE | (p[0] ? SCHED_CAPTURE : 0u);
+            break;
+        case CMD_STOP:
+            buf->flags = STOP_CAPTURE;
+            break;
+        case CMD_STAGE_DONE:
+            buf->flags = STAGE_MOVE_COMPLETE;
+            break;
+        case CMD_ISR_STATS:
+            buf->flags = READ_ISR_STATS | (p[0] ? RESET_ISR_STATS : 0u);
+            break;
+        case CMD_STAGE_HS:
+            buf->mode = p[0];
+            buf->flags = SET_STAGE_HANDSHAKE;
+            break;
+        case CMD_TRACE:
+            buf->mode = p[0];
+            buf->flags = TRACE_CAPTURE;
+            break;
+        case CMD_PROG:
+            buf->steps = p[0];
+            buf->mode = p[1];
+            buf->bonus = p[2];
+            buf->flags = PROGRAM_STEP;
+            break;
+        case CMD_CHAN:
+            buf->steps = p[0];
+            buf->mode = p[1];
+            buf->count = (uint32)p[2] | ((uint32)p[3] << 8);
+            buf->bonus = p[4];
+            buf->flags = SET_CHANNEL;
+            break;
+        case CMD_STATUS_RATE:
+            buf->count = get16(p);
+            buf->flags = SET_STATUS_RATE;
+            break;
+        case CMD_STATUS_MODE:
+            buf->count = get16(p);
+            buf->mode = p[2];
+            buf->flags = SET_STATUS_RATE;
+            break;
+        case CMD_PLANE:
+            buf->steps = p[0];
+            buf->mode = p[1];
+            buf->bonus = p[2];
+            buf->count = get32(&p[3]);
+            buf->flags = SET_PLANE;
+            break;
+        case CMD_EXPO:
+            buf->steps = p[0];
+            buf->mode = p[1];
+            buf->count = get32(&p[2]);
+            buf->flags = SET_EXPO_SLOT;
+            break;
+        default:
+            return CMD_BAD_OP;
+    }
+    return CMD_OK;
+}
+
+/* Queued for the next IN packet; if the host is not reading, the oldest go */
+void usb_cmd_ack(uint16 seq, uint8 status){
+    if(ackPending.count >= USB_ACK_MAX){
+        memmove(&ackPending.seq[0], &ackPending.seq[1], (USB_ACK_MAX - 1u) * sizeof(uint16));
+        memmove(&ackPending.status[0], &ackPending.status[1], USB_ACK_MAX - 1u);
+        ackPending.count--;
+        ackPending.flags |= ACK_OVERFLOW;
+    }
+    ackPending.seq[ackPending.count] = seq;
+    ackPending.status[ackPending.count] = status;
+    ackPending.count++;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,266 @@
+/*******************************************************************************
+* File Name: slm_usb.h
+*
+* Description:
+*   Vendor bulk protocol of the USB firmware and the non-blocking endpoint
+*   state machine that moves it.
+*
+*   An OUT packet is either a legacy struct usb_data (one parameter set per
+*   packet, selected by flags) or a command batch:
+*     uint32 USB_CMD_MAGIC, then records of
+*     [opcode:1][seq:2][payload:usbCmdLen[opcode]] packed back to back.
+*   Every record of a batch is applied in order and acknowledged with its
+*   sequence number in a struct usb_ack IN packet (sent ahead of the next
+*   status packet), so a whole acquisition is set up in one round trip.
+*   A batch that needs more than USB_ACK_MAX acks is not applied at all.
+*   Multi-byte fields are little endian.
+*
+*   The main loop calls usb_link_poll_out() and usb_link_poll_in() every
+*   pass.  Neither waits on the host: the OUT side hands over a command
+*   packet once its DMA copy has finished, the IN side loads a packet
+*   whenever the host has taken the previous one.  A host that stops
+*   reading IN therefore only stops status updates, commands such as
+*   STOP_CAPTURE or STAGE_MOVE_COMPLETE are still applied.
+*
+*   A status packet only goes out when it differs from the last one sent,
+*   after a legacy command packet (its reply), or once the heartbeat period
+*   (SET_STATUS_RATE / CMD_STATUS_RATE, USB_STATUS_PERIOD_MS by default)
+*   has passed without one.  Between those the endpoint NAKs, so a host
+*   that keeps a read pending is woken only by news.
+*
+*   Status packets go out on the interrupt endpoint STATUS_EP_NUM, or on
+*   IN_EP_NUM after any acks and histograms with STATUS_EP_NUM 0.
+*   Trigger timestamps (struct ts_packet, slm_ts.h) go out on TS_EP_NUM.
+*   With TS_EP_NUM 0 they only go out once the host has asked for them with
+*   STATUS_TS (SET_STATUS_RATE / CMD_STATUS_MODE), then on IN_EP_NUM every
+*   other packet while the ring has entries.  A host that never asks, like
+*   one that reads every IN packet as a struct usb_data, only gets status
+*   packets there, plus the acks, histograms and traces it asked for.
+*   Session trace packets (struct
+*   trace_packet, slm_trace.h) take every other of the remaining turns while
+*   a capture is draining.  Ack, histogram, timestamp, trace and status
+*   packets are told apart by their first word: USB_ACK_MAGIC,
+*   USB_HIST_MAGIC, USB_TS_MAGIC, TRACE_MAGIC, or a float fps.
+*
+*   A status packet is outgoing, a 20 byte struct usb_data with count
+*   holding the camera triggers of the capture, as every host has read it.
+*   Once the host has set STATUS_COUNTERS (SET_STATUS_RATE / CMD_STATUS_MODE)
+*   it is a struct usb_status instead: the same struct usb_data followed by
+*   the rest of the frame counters (slm_frames.h).  sim/dev_test checks
+*   both.
+*
+*******************************************************************************/
+
+#ifndef SLM_USB_H
+#define SLM_USB_H
+
+#include "slm_hw.h"
+#include "slm_ts.h"
+#include "slm_isr_stats.h"
+#include "slm_trace.h"
+
+/* Active endpoints of USB device. */
+#define IN_EP_NUM     (1u)
+#define OUT_EP_NUM    (2u)
+
+/* Set to a bulk IN endpoint once the USBFS descriptor has one for the
+*  timestamp stream; 0 sends it on IN_EP_NUM, after STATUS_TS.
+*/
+#ifndef TS_EP_NUM
+#define TS_EP_NUM     (0u)
+#endif
+
+/* Set to an interrupt IN endpoint once the USBFS descriptor has one for the
+*  status packets; 0 sends them on IN_EP_NUM.
+*/
+#ifndef STATUS_EP_NUM
+#define STATUS_EP_NUM (0u)
+#endif
+
+/* Status heartbeat, ms; the DWT counter behind HW_TS_NOW() wraps after
+*  53 s at 80MHz, so longer periods are clamped.
+*/
+#define USB_STATUS_PERIOD_MS (100u)
+#define USB_STATUS_PERIOD_MAX (50000u)
+
+//Stuff for USB communication
+#define CHANGE_FPS 0x1      // from the device: mode holds the LIMIT_* (slm_timing.h) that set fps
+#define CHANGE_Z_STEPS 0x2
+#define SET_READOUT_SPEED 0x4
+#define SLOW_READOUT 0x8
+#define SET_LASER_MODE 0x10
+#define COUNTING 0x20
+#define STOP_COUNT 0x40
+#define SET_CHANNEL 0x80    // steps: index, mode: CAM_SEL value, count: BLANKING_DELAY, bonus: order (slm_chan.h), 1 back in bonus if taken
+#define SET_RUN_MODE 0x100
+#define SET_SIM_MODE 0x200
+#define SCHED_CAPTURE 0x400 // with START_CAPTURE: run from the DMA schedule if it fits
+#define START_CAPTURE 0x800     // bonus: CHECK_BIT()s (slm_check.h) that kept it from starting, 0 if it started
+#define STOP_CAPTURE 0x1000
+#define READ_ISR_STATS 0x2000   // queue a struct isr_stats_packet
+#define RESET_ISR_STATS 0x4000  // clear the T_ISR histograms, after the read
+#define SET_STAGE_HANDSHAKE 0x8000  // mode: STAGE_HS_USB / STAGE_HS_HW, the one in use comes back in bonus
+#define TRACE_CAPTURE 0x10000       // mode: 1 starts a session trace, 0 stops it
+#define PROGRAM_STEP 0x20000        // steps: index, mode: PROG_* op, bonus: arg (slm_prog.h), 1 back in bonus if taken
+#define STAGE_TRIGG_ENABLE 0x40000
+#define STAGE_TRIGG_DISABLE 0x80000
+#define SEND_TRIGG 0x100000
+#define SET_EXPOSURE 0x200000
+#define START_LIVE 0x100000
+#define LIVE_RUNNING 0x200000
+#define STOP_LIVE 0x400000
+#define STAGE_MOVE_COMPLETE 0x800000
+#define Z_STACK_RUNNING 0x1000000
+#define STOP_Z_STACK 0x2000000
+#define TOGGLE_BLANKING 0x4000000
+#define TOGGLE_DIG_MOD 0x8000000
+#define LATE_FRAMES 0x10000000      // from the device: this capture has late or skipped frames
+#define SET_STATUS_RATE 0x20000000  // count: status heartbeat in ms, 0 sends on changes only, mode: STATUS_TS | STATUS_COUNTERS
+#define SET_PLANE 0x40000000        // steps: index, mode: pulses, bonus: flags, count: exposure ticks (slm_plane.h), 1 back in bonus if taken
+#define SET_EXPO_SLOT 0x80000000    // steps: position, mode: channel, count: TRG_CNT ticks (slm_expo.h), 1 back in bonus if taken
+
+/* incoming.mode bits */
+#define STOP_BLANKING (0x0)
+#define START_BLANKING (0x1)
+#define ARB_EXP (0x4)
+
+/* SET_STATUS_RATE mode bits */
+#define STATUS_TS (0x1)     // timestamps on IN_EP_NUM too, with TS_EP_NUM 0
+#define STATUS_COUNTERS (0x2)   // status packets as struct usb_status, not struct usb_data
+
+/* Device -> host flags that are reported once and then cleared */
+#define USB_ONE_SHOT (STOP_Z_STACK|SEND_TRIGG|CHANGE_FPS|SET_EXPOSURE|STOP_COUNT)
+
+struct usb_data{
+    volatile float fps;
+    volatile float exposure;
+    volatile uint32 flags;
+    volatile uint16 steps;
+    volatile uint8 mode;
+    volatile uint8 bonus;
+    volatile uint32 count;
+};
+
+/* Status IN packet */
+struct usb_status{
+    struct usb_data d;
+    uint32 slm;         // SLM trigger pulses
+    uint32 stage;       // STAGE_REG pulses
+    uint16 late;        // frames T_ISR served FRAME_LATE_TICKS or more late
+    uint16 skipped;     // SLM pulses without a frame
+    uint16 lateMax;     // longest T_ISR latency, ticks
+    uint16 reserved;
+};
+
+#define USB_EP_SIZE (64u)
+
+/* Command batch opcodes, payload in brackets */
+#define CMD_NOP (0x00)          // []
+#define CMD_FPS (0x01)          // [float fps] as CHANGE_FPS
+#define CMD_Z_STEPS (0x02)      // [uint16 steps]
+#define CMD_READOUT (0x03)      // [uint8 slow] as SET_READOUT_SPEED
+#define CMD_LASER (0x04)        // [uint8 laser]
+#define CMD_RUN_MODE (0x05)     // [uint8 mode][uint32 count]
+#define CMD_SIM_MODE (0x06)     // [uint8 simMode]
+#define CMD_EXPOSURE (0x07)     // [float seconds][uint8 arb]
+#define CMD_BLANKING (0x08)     // [uint8 on]
+#define CMD_START (0x09)        // [uint8 sched] as START_CAPTURE (| SCHED_CAPTURE)
+#define CMD_STOP (0x0A)         // []
+#define CMD_STAGE_DONE (0x0B)   // [] as STAGE_MOVE_COMPLETE
+#define CMD_ISR_STATS (0x0C)    // [uint8 reset] as READ_ISR_STATS (| RESET_ISR_STATS)
+#define CMD_STAGE_HS (0x0D)     // [uint8 handshake] as SET_STAGE_HANDSHAKE
+#define CMD_TRACE (0x0E)        // [uint8 on] as TRACE_CAPTURE
+#define CMD_PROG (0x0F)         // [uint8 index][uint8 op][uint8 arg] as PROGRAM_STEP
+#define CMD_CHAN (0x10)         // [uint8 index][uint8 sel][uint16 blankDelay][uint8 order] as SET_CHANNEL
+#define CMD_STATUS_RATE (0x11)  // [uint16 ms] as SET_STATUS_RATE, mode 0
+#define CMD_PLANE (0x12)        // [uint8 index][uint8 pulses][uint8 flags][uint32 exposure] as SET_PLANE
+#define CMD_EXPO (0x13)         // [uint8 pos][uint8 chan][uint32 ticks] as SET_EXPO_SLOT
+#define CMD_STATUS_MODE (0x14)  // [uint16 ms][uint8 mode] as SET_STATUS_RATE
+#define CMD_COUNT (0x15)
+
+/* Payload bytes per opcode, one table for the firmware and the host client */
+static const uint8 usbCmdLen[CMD_COUNT] = {
+    0u,     // CMD_NOP
+    4u,     // CMD_FPS
+    2u,     // CMD_Z_STEPS
+    1u,     // CMD_READOUT
+    1u,     // CMD_LASER
+    5u,     // CMD_RUN_MODE
+    1u,     // CMD_SIM_MODE
+    5u,     // CMD_EXPOSURE
+    1u,     // CMD_BLANKING
+    1u,     // CMD_START
+    0u,     // CMD_STOP
+    0u,     // CMD_STAGE_DONE
+    1u,     // CMD_ISR_STATS
+    1u,     // CMD_STAGE_HS
+    1u,     // CMD_TRACE
+    3u,     // CMD_PROG
+    5u,     // CMD_CHAN
+    2u,     // CMD_STATUS_RATE
+    7u,     // CMD_PLANE
+    6u,     // CMD_EXPO
+    3u,     // CMD_STATUS_MODE
+};
+
+#define USB_CMD_MAGIC (0x314D4C53u)    // "SLM1"
+#define USB_ACK_MAGIC (0x414D4C53u)    // "SLMA"
+#define USB_CMD_HDR (3u)               // opcode + seq
+
+/* Ack status per record */
+#define CMD_OK (0u)
+#define CMD_BAD_OP (1u)
+#define CMD_BAD_LEN (2u)
+#define CMD_BAD_BATCH (3u)      // more than USB_ACK_MAX records, none applied
+
+/* struct usb_ack flags */
+#define ACK_OVERFLOW (0x01)     // acks were dropped, host should resync
+
+/* A packet holds up to USB_BATCH_MAX records (all CMD_NOP), but a
+*  struct usb_ack of that many would be 66 bytes; a batch that needs more
+*  than USB_ACK_MAX acks is refused whole, its first record acked
+*  CMD_BAD_BATCH.
+*/
+#define USB_ACK_MAX (19u)
+#define USB_BATCH_MAX ((USB_EP_SIZE - 4u) / USB_CMD_HDR)
+
+struct usb_ack{
+    uint32 magic;
+    uint8 count;
+    uint8 flags;
+    uint16 seq[USB_ACK_MAX];
+    uint8 status[USB_ACK_MAX];
+};
+
+struct usb_cmd{
+    uint8 op;
+    uint16 seq;
+    const uint8* payload;
+};
+
+/* usb_link_poll_out() results */
+#define USB_RX_NONE (0u)
+#define USB_RX_LEGACY (1u)      // incoming holds a struct usb_data
+#define USB_RX_BATCH (2u)       // read the records with usb_cmd_next()
+
+/* OUT endpoint states */
+#define USB_OUT_IDLE (0u)   // armed, waiting for the host
+#define USB_OUT_COPY (1u)   // ReadOutEP DMA in flight
+
+extern volatile struct usb_data incoming;
+extern volatile struct usb_data outgoing;
+
+void usb_link_init(void);
+uint8 usb_link_poll_out(void);
+uint8 usb_link_poll_in(void);
+void usb_link_trace_out(void);
+void usb_queue_isr_stats(void);
+uint16 usb_set_status_period(uint32 ms, uint8 mode);
+
+uint8 usb_cmd_next(struct usb_cmd* cmd);
+uint8 usb_cmd_load(const struct usb_cmd* cmd, volatile struct usb_data* buf);
+void usb_cmd_ack(uint16 seq, uint8 status);
+
+#endif /* SLM_USB_H */
+
+/* [] END OF FILE */
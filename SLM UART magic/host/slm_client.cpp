@@ -0,0 +1,654 @@
+/*******************************************************************************
+* File Name: slm_client.cpp
+*
+* Description:
+*   Command pipelining, ack matching and event futures for slm::Client.  See
+*   slm_client.h.
+*
+*******************************************************************************/
+
+#include <cstring>
+#include "slm_client.h"
+
+extern "C" {
+#include "slm_seq.h"
+#include "slm_timing.h"
+}
+
+namespace slm {
+
+static const uint32_t eventFlag[EV_COUNT] = {
+    SEND_TRIGG, STOP_Z_STACK, STOP_COUNT, CHANGE_FPS, SET_EXPOSURE
+};
+
+static void put16(uint8_t* p, uint16_t v){
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v){
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void putFloat(uint8_t* p, float f){
+    uint32_t bits;
+
+    memcpy(&bits, &f, sizeof(bits));
+    put32(p, bits);
+}
+
+static uint32_t get32(const uint8_t* p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+Client::Client(Transport& link, unsigned window)
+    : link_(link), window_(window ? window : 1u), nextSeq_(0), nextBatch_(0),
+      hostTrace_(0), devTrace_(0), running_(false), chans_(1u),
+      statusMs_(USB_STATUS_PERIOD_MS), statusMode_(STATUS_COUNTERS){
+    memset(&status_, 0, sizeof(status_));
+    memset(&counters_, 0, sizeof(counters_));
+    memset(events_, 0, sizeof(events_));
+    /* Status carries slm, stage and the late frame counts */
+    set_status_period(USB_STATUS_PERIOD_MS);
+}
+
+Client::~Client(){
+    stop();
+    capture(0);
+    if(devTrace_){
+        fclose(devTrace_);
+    }
+}
+
+/* I/O on a thread of our own until stop() */
+void Client::start(){
+    if(running_.exchange(true)){
+        return;
+    }
+    io_ = std::thread([this](){
+        while(running_.load()){
+            if(!poll()){
+                link_.idle();
+            }
+        }
+    });
+}
+
+void Client::stop(){
+    if(running_.exchange(false)){
+        io_.join();
+    }
+}
+
+/* One pass: an OUT packet if records are waiting and the window allows,
+*  then one IN packet.  Returns true if anything moved.
+*/
+bool Client::poll(){
+    bool out = pump_out();
+    bool in = pump_in();
+
+    return out || in;
+}
+
+std::future<Ack> Client::send(uint8_t op, const void* payload){
+    std::lock_guard<std::mutex> hold(lock_);
+    Record r;
+
+    r.op = op;
+    r.seq = nextSeq_++;
+    r.batch = 0;
+    r.sent_us = 0;
+    memset(r.payload, 0, sizeof(r.payload));
+    if(op < CMD_COUNT && payload){
+        memcpy(r.payload, payload, usbCmdLen[op]);
+    }
+    std::future<Ack> f = r.done.get_future();
+    if(op >= CMD_COUNT){
+        /* The firmware would end the batch on it, never send it */
+        Ack a = {r.seq, CMD_BAD_OP, 0, 0};
+        r.done.set_value(a);
+        return f;
+    }
+    counters_.commands++;
+    queue_.push_back(std::move(r));
+    return f;
+}
+
+std::future<Ack> Client::nop(){
+    return send(CMD_NOP);
+}
+
+std::future<Ack> Client::set_fps(float fps){
+    uint8_t p[4];
+
+    putFloat(p, fps);
+    return send(CMD_FPS, p);
+}
+
+std::future<Ack> Client::set_z_steps(uint16_t steps){
+    uint8_t p[2];
+
+    put16(p, steps);
+    return send(CMD_Z_STEPS, p);
+}
+
+std::future<Ack> Client::set_readout(bool slow){
+    uint8_t p = slow ? 1u : 0u;
+
+    return send(CMD_READOUT, &p);
+}
+
+std::future<Ack> Client::set_laser(uint8_t laser){
+    chans_ = (laser == BOTH_LASERS) ? 2u : 1u;
+    return send(CMD_LASER, &laser);
+}
+
+std::future<Ack> Client::set_run_mode(uint8_t mode, uint32_t count){
+    uint8_t p[5];
+
+    p[0] = mode;
+    put32(&p[1], count);
+    return send(CMD_RUN_MODE, p);
+}
+
+std::future<Ack> Client::set_sim_mode(uint8_t sim){
+    return send(CMD_SIM_MODE, &sim);
+}
+
+std::future<Ack> Client::set_exposure(float seconds, bool arb){
+    uint8_t p[5];
+
+    putFloat(p, seconds);
+    p[4] = arb ? 1u : 0u;
+    return send(CMD_EXPOSURE, p);
+}
+
+std::future<Ack> Client::set_blanking(bool on){
+    uint8_t p = on ? 1u : 0u;
+
+    return send(CMD_BLANKING, &p);
+}
+
+std::future<Ack> Client::start_capture(bool sched){
+    uint8_t p = sched ? 1u : 0u;
+
+    return send(CMD_START, &p);
+}
+
+std::future<Ack> Client::stop_capture(){
+    return send(CMD_STOP);
+}
+
+std::future<Ack> Client::stage_done(){
+    return send(CMD_STAGE_DONE);
+}
+
+std::future<Ack> Client::read_isr_stats(bool reset){
+    uint8_t p = reset ? 1u : 0u;
+
+    return send(CMD_ISR_STATS, &p);
+}
+
+std::future<Ack> Client::set_stage_handshake(uint8_t hs){
+    return send(CMD_STAGE_HS, &hs);
+}
+
+/* Period and mode go out together, each setter resends the other;
+*  STATUS_COUNTERS is always asked for
+*/
+std::future<Ack> Client::set_status_period(uint16_t ms){
+    uint8_t p[3];
+
+    statusMs_ = ms;
+    put16(p, ms);
+    p[2] = statusMode_;
+    return send(CMD_STATUS_MODE, p);
+}
+
+std::future<Ack> Client::set_timestamps(bool on){
+    uint8_t p[3];
+
+    statusMode_ = on ? (STATUS_COUNTERS | STATUS_TS) : STATUS_COUNTERS;
+    put16(p, statusMs_);
+    p[2] = statusMode_;
+    return send(CMD_STATUS_MODE, p);
+}
+
+/* Checked here first, a program the firmware would not run is not sent */
+std::future<Ack> Client::set_program(const struct prog_step* steps, uint8_t n){
+    std::future<Ack> last;
+
+    if(n == 0 || n > PROG_MAX || !prog_check(steps, n, chans_)){
+        return send(CMD_COUNT);
+    }
+    for(uint8_t i = 0; i < n; i++){
+        uint8_t p[3] = {i, steps[i].op, steps[i].arg};
+
+        last = send(CMD_PROG, p);
+    }
+    return last;
+}
+
+std::future<Ack> Client::set_channels(const struct laser_chan* chans, uint8_t n, uint8_t order){
+    std::future<Ack> last;
+
+    if(n == 0 || n > CHAN_MAX || order >= CHAN_ORDER_COUNT){
+        return send(CMD_COUNT);
+    }
+    for(uint8_t i = 0; i < n; i++){
+        uint8_t p[5] = {i, chans[i].sel, (uint8_t)chans[i].blankDelay,
+                        (uint8_t)(chans[i].blankDelay >> 8), order};
+
+        last = send(CMD_CHAN, p);
+    }
+    chans_ = n;
+    return last;
+}
+
+std::future<Ack> Client::set_planes(const struct z_plane* planes, uint8_t n){
+    std::future<Ack> last;
+
+    if(n == 0 || n > PLANE_MAX){
+        return send(CMD_COUNT);
+    }
+    for(uint8_t i = 0; i < n; i++){
+        if(planes[i].flags & ~PLANE_FLAGS){
+            return send(CMD_COUNT);
+        }
+    }
+    for(uint8_t i = 0; i < n; i++){
+        uint8_t p[7] = {i, planes[i].pulses, planes[i].flags};
+
+        put32(&p[3], planes[i].exposure);
+        last = send(CMD_PLANE, p);
+    }
+    return last;
+}
+
+std::future<Ack> Client::set_slot_exposure(uint8_t pos, uint8_t chan, uint32_t ticks){
+    uint8_t p[6] = {pos, chan};
+
+    put32(&p[2], ticks);
+    return send(CMD_EXPO, p);
+}
+
+/* Same config as seq_check_timing() builds on the device, from the same
+*  readout / wait / blanking code
+*/
+uint8_t Client::check_timing(uint32_t frame, uint32_t exposure, uint16_t vert, uint8_t cap_mode,
+                             const struct laser_chan* chans, uint8_t n, uint8_t stage_steps,
+                             uint32_t stage_wait, struct timing_verdict* v){
+    const struct cam_profile* cam = CAM_PROFILE(cap_mode);
+    struct timing_config cfg;
+
+    if(n > CHAN_MAX){
+        n = CHAN_MAX;
+    }
+    cfg.frame = frame;
+    cfg.exposure = exposure;
+    cfg.readout = timing_readout(cam, vert);
+    cfg.wait = timing_wait(frame, exposure, cfg.readout);
+    cfg.stageWait = stage_wait;
+    cfg.stageSettle = STAGE_SETTLE_TICKS;
+    cfg.stagePulse = STAGE_PULSE_TICKS;
+    cfg.chanCount = n;
+    for(uint8_t i = 0; i < n; i++){
+        cfg.blankDelay[i] = timing_blank_delay(cam, &chans[i]);
+    }
+    cfg.stageSteps = stage_steps;
+    return timing_check(&cfg, v);
+}
+
+std::future<Ack> Client::set_trace(bool on){
+    uint8_t p = on ? 1u : 0u;
+
+    return send(CMD_TRACE, &p);
+}
+
+FILE* Client::open_trace(const char* path, uint16_t flags){
+    uint8_t hdr[8];
+    FILE* f = fopen(path, "wb");
+
+    if(!f){
+        return 0;
+    }
+    put32(hdr, TRACE_MAGIC);
+    put16(&hdr[4], TRACE_VERSION);
+    put16(&hdr[6], flags);
+    fwrite(hdr, 1, sizeof(hdr), f);
+    return f;
+}
+
+bool Client::capture(const char* path){
+    std::lock_guard<std::mutex> hold(fileLock_);
+
+    if(hostTrace_){
+        fclose(hostTrace_);
+        hostTrace_ = 0;
+    }
+    if(!path){
+        return true;
+    }
+    hostTrace_ = open_trace(path, TRACE_FROM_HOST);
+    if(!hostTrace_){
+        return false;
+    }
+
+    uint8_t rec[TRACE_REC_HDR + 4];
+    put32(rec, (uint32_t)link_.now_us());
+    rec[4] = TRACE_CLOCK;
+    rec[5] = 4u;
+    put32(&rec[6], 1000000u);
+    fwrite(rec, 1, sizeof(rec), hostTrace_);
+    return true;
+}
+
+/* The tail of the firmware's ring keeps coming after the stop, the file is
+*  only closed by the next device_capture() or with the client.
+*/
+bool Client::device_capture(const char* path){
+    {
+        std::lock_guard<std::mutex> hold(fileLock_);
+
+        if(path){
+            if(devTrace_){
+                fclose(devTrace_);
+            }
+            devTrace_ = open_trace(path, TRACE_FROM_DEVICE);
+            if(!devTrace_){
+                return false;
+            }
+        }
+    }
+    set_trace(path != 0);
+    return true;
+}
+
+/* Record of the host side trace, time in transport microseconds */
+void Client::trace_host(uint8_t kind, const uint8_t* data, size_t len, double now){
+    std::lock_guard<std::mutex> hold(fileLock_);
+    uint8_t hdr[TRACE_REC_HDR];
+
+    if(!hostTrace_){
+        return;
+    }
+    put32(hdr, (uint32_t)now);
+    hdr[4] = kind;
+    hdr[5] = (uint8_t)len;
+    fwrite(hdr, 1, sizeof(hdr), hostTrace_);
+    fwrite(data, 1, len, hostTrace_);
+}
+
+/* Fulfilled by the next status packet carrying the event's flag */
+std::shared_future<Status> Client::wait_for(Event ev){
+    std::lock_guard<std::mutex> hold(lock_);
+
+    if(!waiters_[ev]){
+        waiters_[ev] = std::make_shared<std::promise<Status> >();
+        waitFutures_[ev] = waiters_[ev]->get_future().share();
+    }
+    return waitFutures_[ev];
+}
+
+uint64_t Client::event_count(Event ev) const{
+    std::lock_guard<std::mutex> hold(lock_);
+    return events_[ev];
+}
+
+Status Client::status() const{
+    std::lock_guard<std::mutex> hold(lock_);
+    return status_;
+}
+
+Counters Client::counters() const{
+    std::lock_guard<std::mutex> hold(lock_);
+    return counters_;
+}
+
+size_t Client::in_flight() const{
+    std::lock_guard<std::mutex> hold(lock_);
+    return queue_.size() + inflight_.size();
+}
+
+void Client::on_timestamps(std::function<void(const struct ts_packet&)> fn){
+    std::lock_guard<std::mutex> hold(lock_);
+    tsFn_ = fn;
+}
+
+void Client::on_isr_stats(std::function<void(const struct isr_stats_packet&)> fn){
+    std::lock_guard<std::mutex> hold(lock_);
+    histFn_ = fn;
+}
+
+/*******************************************************************************
+* Function Name: Client::pump_out
+********************************************************************************
+*
+* Summary:
+*  Packs queued records into one batch, as many as fit in USB_EP_SIZE, the
+*  ack window and one struct usb_ack, and offers it to the transport.  They only move to the
+*  in flight list once the device has taken the packet; on a NAK the same
+*  records go again next pass.  Only the I/O thread removes from queue_, so
+*  the lock is not held over the transport call.
+*
+*******************************************************************************/
+bool Client::pump_out(){
+    uint8_t buf[USB_EP_SIZE];
+    size_t len = sizeof(uint32_t);
+    size_t n = 0;
+
+    {
+        std::lock_guard<std::mutex> hold(lock_);
+
+        while(n < queue_.size() && n < USB_ACK_MAX && inflight_.size() + n < window_){
+            const Record& r = queue_[n];
+
+            if(len + USB_CMD_HDR + usbCmdLen[r.op] > USB_EP_SIZE){
+                break;
+            }
+            buf[len] = r.op;
+            put16(&buf[len + 1u], r.seq);
+            memcpy(&buf[len + USB_CMD_HDR], r.payload, usbCmdLen[r.op]);
+            len += USB_CMD_HDR + usbCmdLen[r.op];
+            n++;
+        }
+    }
+    if(n == 0){
+        return false;
+    }
+    put32(buf, USB_CMD_MAGIC);
+    if(!link_.write(buf, len)){
+        std::lock_guard<std::mutex> hold(lock_);
+        counters_.out_naks++;
+        return false;
+    }
+
+    double now = link_.now_us();
+    trace_host(TRACE_OUT, buf, len, now);
+
+    std::lock_guard<std::mutex> hold(lock_);
+    uint32_t batch = ++nextBatch_;
+
+    counters_.out_packets++;
+    while(n--){
+        queue_.front().batch = batch;
+        queue_.front().sent_us = now;
+        inflight_.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+    }
+    return true;
+}
+
+bool Client::pump_in(){
+    union{
+        struct usb_data status;
+        struct usb_status full;
+        struct usb_ack ack;
+        struct ts_packet ts;
+        struct isr_stats_packet hist;
+        struct trace_packet trace;
+        uint8_t raw[USB_EP_SIZE];
+    } in;
+    size_t n = link_.read(in.raw, sizeof(in.raw));
+    double now;
+    uint32_t magic;
+
+    if(n < sizeof(uint32_t)){
+        return n != 0;
+    }
+    now = link_.now_us();
+    magic = get32(in.raw);
+    {
+        std::lock_guard<std::mutex> hold(lock_);
+        counters_.in_packets++;
+    }
+    if(magic == TRACE_MAGIC && n >= sizeof(struct trace_packet)){
+        uint8_t len = in.trace.len < TRACE_PER_PACKET ? in.trace.len : TRACE_PER_PACKET;
+        {
+            std::lock_guard<std::mutex> hold(lock_);
+            counters_.trace_bytes += len;
+            counters_.trace_dropped += in.trace.dropped;
+        }
+        std::lock_guard<std::mutex> hold(fileLock_);
+        if(devTrace_){
+            fwrite(in.trace.data, 1, len, devTrace_);
+        }
+        return true;
+    }
+    /* Plain status packets stay out of the trace, as in the firmware's */
+    if(magic == USB_ACK_MAGIC || magic == USB_TS_MAGIC || magic == USB_HIST_MAGIC
+        || (n >= sizeof(struct usb_data) && (in.status.flags & USB_ONE_SHOT))){
+        trace_host(TRACE_IN, in.raw, n, now);
+    }
+    if(magic == USB_ACK_MAGIC && n >= sizeof(struct usb_ack)){
+        take_acks(in.ack, now);
+    } else if(magic == USB_TS_MAGIC && n >= sizeof(struct ts_packet)){
+        std::function<void(const struct ts_packet&)> fn;
+        {
+            std::lock_guard<std::mutex> hold(lock_);
+            counters_.ts_packets++;
+            fn = tsFn_;
+        }
+        if(fn){
+            fn(in.ts);
+        }
+    } else if(magic == USB_HIST_MAGIC && n >= sizeof(struct isr_stats_packet)){
+        std::function<void(const struct isr_stats_packet&)> fn;
+        {
+            std::lock_guard<std::mutex> hold(lock_);
+            fn = histFn_;
+        }
+        if(fn){
+            fn(in.hist);
+        }
+    } else if(n >= sizeof(struct usb_data)){
+        take_status(in.full, n);
+    }
+    return true;
+}
+
+void Client::finish(Record& r, uint8_t status, double now){
+    Ack a = {r.seq, status, r.sent_us, now};
+
+    counters_.acked++;
+    r.done.set_value(a);
+}
+
+/*******************************************************************************
+* Function Name: Client::take_acks
+********************************************************************************
+*
+* Summary:
+*  The firmware acks records in the order it applies them.  Records in
+*  flight ahead of an acked one were applied too, their acks were pushed out
+*  of a full ack queue (ACK_LOST).  A bad record ends its batch, the rest of
+*  that batch is never applied (ACK_NOT_RUN).
+*
+*******************************************************************************/
+void Client::take_acks(const struct usb_ack& ack, double now){
+    std::lock_guard<std::mutex> hold(lock_);
+    uint8_t count = ack.count < USB_ACK_MAX ? ack.count : USB_ACK_MAX;
+    uint8_t i;
+
+    if(ack.flags & ACK_OVERFLOW){
+        counters_.ack_overflows++;
+    }
+    for(i = 0; i < count; i++){
+        uint16_t seq = ack.seq[i];
+        size_t k;
+
+        for(k = 0; k < inflight_.size() && inflight_[k].seq != seq; k++){
+        }
+        if(k == inflight_.size()){
+            continue;   // not ours, or already settled
+        }
+        while(inflight_.front().seq != seq){
+            finish(inflight_.front(), ACK_LOST, now);
+            inflight_.pop_front();
+        }
+        uint32_t batch = inflight_.front().batch;
+        uint8_t status = ack.status[i];
+
+        finish(inflight_.front(), status, now);
+        inflight_.pop_front();
+        if(status != CMD_OK){
+            while(!inflight_.empty() && inflight_.front().batch == batch){
+                finish(inflight_.front(), ACK_NOT_RUN, now);
+                inflight_.pop_front();
+            }
+        }
+    }
+}
+
+/* Firmware older than LATE_FRAMES, or a status sent before our
+*  STATUS_COUNTERS was applied, is a bare struct usb_data
+*/
+void Client::take_status(const struct usb_status& pkt, size_t n){
+    std::shared_ptr<std::promise<Status> > fire[EV_COUNT];
+    Status s;
+    unsigned ev;
+
+    s.fps = pkt.d.fps;
+    s.exposure = pkt.d.exposure;
+    s.flags = pkt.d.flags;
+    s.steps = pkt.d.steps;
+    s.mode = pkt.d.mode;
+    s.bonus = pkt.d.bonus;
+    s.count = pkt.d.count;
+    s.slm = 0;
+    s.stage = 0;
+    s.late = 0;
+    s.skipped = 0;
+    s.late_max = 0;
+    if(n >= sizeof(struct usb_status)){
+        s.slm = pkt.slm;
+        s.stage = pkt.stage;
+        s.late = pkt.late;
+        s.skipped = pkt.skipped;
+        s.late_max = pkt.lateMax;
+    }
+    {
+        std::lock_guard<std::mutex> hold(lock_);
+
+        status_ = s;
+        counters_.status_packets++;
+        for(ev = 0; ev < EV_COUNT; ev++){
+            if(s.flags & eventFlag[ev]){
+                events_[ev]++;
+                fire[ev].swap(waiters_[ev]);
+            }
+        }
+    }
+    for(ev = 0; ev < EV_COUNT; ev++){
+        if(fire[ev]){
+            fire[ev]->set_value(s);
+        }
+    }
+}
+
+} // namespace slm
+
+/* [] END OF FILE */
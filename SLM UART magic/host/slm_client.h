@@ -0,0 +1,248 @@
+/*******************************************************************************
+* File Name: slm_client.h
+*
+* Description:
+*   Host side client for the vendor bulk protocol of the USB firmware
+*   (common/slm_usb.h).  Every parameter goes out as a command batch record
+*   and comes back as a std::future that is fulfilled by the record's ack,
+*   so callers never build struct usb_data images or touch the flag bits.
+*
+*   Commands are pipelined: records queued from any thread are packed into
+*   as few OUT packets as fit, with up to `window` of them waiting for an
+*   ack.  The default window is USB_ACK_MAX, the firmware's ack queue, so
+*   acks are not dropped even if IN is read late.
+*
+*   Status packets are kept (status()) and their one-shot flags are turned
+*   into events; wait_for() returns a future for the next one.  Arm it
+*   before the command that causes it:
+*
+*       auto done = client.wait_for(slm::EV_COUNT_DONE);
+*       client.start_capture();
+*       done.wait();
+*
+*   The I/O runs either on a thread owned by the client (start() / stop())
+*   or from the caller's loop with poll().  Only that thread touches the
+*   transport.
+*
+*   capture() writes the packets the client moves to a session trace
+*   (common/slm_trace.h) timed by the transport clock.  device_capture()
+*   turns on the firmware's own trace, which adds the timing the core
+*   computed for every command, and streams it into a file.  Both play back
+*   with sim/slm_replay.
+*
+*******************************************************************************/
+
+#ifndef SLM_CLIENT_H
+#define SLM_CLIENT_H
+
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "slm_transport.h"
+
+extern "C" {
+#include "slm_usb.h"
+#include "slm_trace.h"
+#include "slm_prog.h"
+#include "slm_chan.h"
+#include "slm_plane.h"
+#include "slm_expo.h"
+#include "slm_check.h"
+}
+
+namespace slm {
+
+/* Ack status on top of CMD_OK / CMD_BAD_OP / CMD_BAD_LEN / CMD_BAD_BATCH */
+#define ACK_LOST (0x80)     // applied, but its ack was dropped (ACK_OVERFLOW)
+#define ACK_NOT_RUN (0x81)  // an earlier record of the same batch was bad
+
+struct Ack{
+    uint16_t seq;
+    uint8_t status;
+    double sent_us;     // transport clock when the OUT packet was taken
+    double done_us;     // and when the ack was read
+};
+
+struct Status{
+    float fps;
+    float exposure;
+    uint32_t flags;
+    uint16_t steps;
+    uint8_t mode;
+    uint8_t bonus;
+    uint32_t count;     // camera triggers since START_CAPTURE
+    /* From here on STATUS_COUNTERS, which the client asks for when created */
+    uint32_t slm;       // SLM triggers
+    uint32_t stage;     // STAGE_REG pulses
+    uint16_t late;      // frames whose T_ISR ran late (LATE_FRAMES)
+    uint16_t skipped;   // SLM triggers T_ISR never saw
+    uint16_t late_max;  // worst T_ISR latency, ticks
+};
+
+/* Events, from the one-shot status flags */
+enum Event{
+    EV_STAGE_REQ = 0,   // SEND_TRIGG, SEVEN_PHASE plane done (USB handshake)
+    EV_Z_DONE,          // STOP_Z_STACK
+    EV_COUNT_DONE,      // STOP_COUNT, count and timed mode
+    EV_FPS_CHANGED,     // CHANGE_FPS, the firmware changed the frame rate, mode = LIMIT_*
+    EV_EXPOSURE_CHANGED,// SET_EXPOSURE, the firmware changed the exposure
+    EV_COUNT
+};
+
+struct Counters{
+    uint64_t commands;      // records queued
+    uint64_t acked;
+    uint64_t out_packets;
+    uint64_t out_naks;
+    uint64_t in_packets;
+    uint64_t status_packets;
+    uint64_t ts_packets;
+    uint64_t ack_overflows;
+    uint64_t trace_bytes;   // device trace stream received
+    uint64_t trace_dropped; // device trace records lost to a full ring
+};
+
+class Client{
+public:
+    explicit Client(Transport& link, unsigned window = USB_ACK_MAX);
+    ~Client();
+
+    void start();
+    void stop();
+    bool poll();
+
+    /* Any batch opcode, payload of usbCmdLen[op] bytes */
+    std::future<Ack> send(uint8_t op, const void* payload = 0);
+
+    std::future<Ack> nop();
+    std::future<Ack> set_fps(float fps);
+    std::future<Ack> set_z_steps(uint16_t steps);
+    std::future<Ack> set_readout(bool slow);
+    std::future<Ack> set_laser(uint8_t laser);
+    /* count: SIM sets for COUNT_MODE, 2MHz ticks for TIMED_MODE; TIMED_MODE |
+    *  TIMED_TO_SET_END finishes the set running at the deadline
+    */
+    std::future<Ack> set_run_mode(uint8_t mode, uint32_t count = 0);
+    std::future<Ack> set_sim_mode(uint8_t sim);
+    std::future<Ack> set_exposure(float seconds, bool arb = false);
+    std::future<Ack> set_blanking(bool on);
+    std::future<Ack> start_capture(bool sched = false);
+    std::future<Ack> stop_capture();
+    std::future<Ack> stage_done();
+    std::future<Ack> read_isr_stats(bool reset = false);
+    std::future<Ack> set_stage_handshake(uint8_t hs);
+    std::future<Ack> set_trace(bool on);
+    /* Status heartbeat in ms; status packets still go out on every change */
+    std::future<Ack> set_status_period(uint16_t ms);
+    /* Trigger timestamps for on_timestamps(); off until asked for, a host
+    *  that reads IN as status packets only never gets them
+    */
+    std::future<Ack> set_timestamps(bool on);
+
+    /* Uploads a sequence program (slm_prog.h), then set_sim_mode(SIM_PROGRAM).
+    *  The future is the last step's; CMD_BAD_OP without sending anything if
+    *  prog_check() fails.
+    */
+    std::future<Ack> set_program(const struct prog_step* steps, uint8_t n);
+
+    /* Uploads a channel table (slm_chan.h), replacing the one set_laser()
+    *  made.  CMD_BAD_OP without sending anything if n or order is out of
+    *  range.  set_program() checks PROG_LASER steps against the last table.
+    */
+    std::future<Ack> set_channels(const struct laser_chan* chans, uint8_t n, uint8_t order);
+
+    /* Uploads a Z plane table (slm_plane.h) for Z_MODE; set_z_steps() drops
+    *  it again, so it goes after that.  CMD_BAD_OP without sending anything
+    *  if n or a flag is out of range.
+    */
+    std::future<Ack> set_planes(const struct z_plane* planes, uint8_t n);
+
+    /* One slot of the exposure table (slm_expo.h), 2MHz ticks for the
+    *  frames at pattern position pos on channel chan, 0 for the plain
+    *  exposure.  pos EXPO_CLEAR drops the table.
+    */
+    std::future<Ack> set_slot_exposure(uint8_t pos, uint8_t chan, uint32_t ticks);
+
+    /* START_CAPTURE's timing check (slm_check.h), run here before anything
+    *  is sent: frame and exposure in 2MHz ticks, the readout of vert rows
+    *  in readout mode cap_mode of the build's camera, SLM_WAIT as
+    *  setWaitTime() makes it and the BLANKING_DELAY of each channel.
+    *  stage_steps is the most STAGE_REG pulses of one move, 0 if the
+    *  sequence never steps, and stage_wait the device's STAGE_WAIT in ticks
+    *  (STAGE_SETTLE_TICKS on the USB firmware).  Returns the CHECK_BIT()s
+    *  that fail, as the device reports them in bonus.
+    */
+    static uint8_t check_timing(uint32_t frame, uint32_t exposure, uint16_t vert, uint8_t cap_mode,
+                                const struct laser_chan* chans, uint8_t n, uint8_t stage_steps,
+                                uint32_t stage_wait, struct timing_verdict* v);
+
+    /* Session traces, a null path stops.  false if the file can't be opened */
+    bool capture(const char* path);
+    bool device_capture(const char* path);
+
+    std::shared_future<Status> wait_for(Event ev);
+    uint64_t event_count(Event ev) const;
+    Status status() const;
+    Counters counters() const;
+    size_t in_flight() const;
+
+    /* Called on the I/O thread */
+    void on_timestamps(std::function<void(const struct ts_packet&)> fn);
+    void on_isr_stats(std::function<void(const struct isr_stats_packet&)> fn);
+
+private:
+    struct Record{
+        uint8_t op;
+        uint16_t seq;
+        uint8_t payload[8];
+        uint32_t batch;
+        double sent_us;
+        std::promise<Ack> done;
+    };
+
+    Client(const Client&);
+    Client& operator=(const Client&);
+
+    bool pump_out();
+    bool pump_in();
+    void take_acks(const struct usb_ack& ack, double now);
+    void take_status(const struct usb_status& pkt, size_t n);
+    void finish(Record& r, uint8_t status, double now);
+    void trace_host(uint8_t kind, const uint8_t* data, size_t len, double now);
+    static FILE* open_trace(const char* path, uint16_t flags);
+
+    Transport& link_;
+    unsigned window_;
+    mutable std::mutex lock_;
+    std::deque<Record> queue_;      // not sent yet
+    std::deque<Record> inflight_;   // sent, waiting for the ack
+    uint16_t nextSeq_;
+    uint32_t nextBatch_;
+    Status status_;
+    Counters counters_;
+    std::shared_ptr<std::promise<Status> > waiters_[EV_COUNT];
+    std::shared_future<Status> waitFutures_[EV_COUNT];
+    uint64_t events_[EV_COUNT];
+    std::function<void(const struct ts_packet&)> tsFn_;
+    std::function<void(const struct isr_stats_packet&)> histFn_;
+    std::mutex fileLock_;
+    FILE* hostTrace_;
+    FILE* devTrace_;
+    std::thread io_;
+    std::atomic<bool> running_;
+    std::atomic<uint8_t> chans_;    // channel table size, for prog_check()
+    std::atomic<uint16_t> statusMs_;    // last set_status_period()
+    std::atomic<uint8_t> statusMode_;   // and set_timestamps(), as SET_STATUS_RATE mode
+};
+
+} // namespace slm
+
+#endif /* SLM_CLIENT_H */
+
+/* [] END OF FILE */
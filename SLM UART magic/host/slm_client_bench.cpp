@@ -0,0 +1,267 @@
+/*******************************************************************************
+* File Name: slm_client_bench.cpp
+*
+* Description:
+*   Latency and throughput of slm::Client against the firmware simulator.
+*     serial      one command at a time, each waits for its ack (window 1)
+*     pipelined   all commands queued at once, --window records in flight
+*     threaded    as pipelined, I/O on the client's thread, wall clock rate
+*     acquisition setup batch, START_CAPTURE and the STOP_COUNT future, and
+*                 what the LCD shows once the idle passes have drawn it;
+*                 status_packets is how many the host had to read meanwhile
+*   serial / pipelined / acquisition are timed on the simulator clock, so
+*   they are repeatable; threaded shows the library overhead on this box.
+*   --trace / --device-trace record the acquisition run as session traces
+*   for sim/slm_replay.
+*
+*   Build: make -C host        Run: host/slm_client_bench --help
+*
+*******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <getopt.h>
+
+#include "slm_client.h"
+#include "slm_sim_transport.h"
+
+extern "C" {
+#include "slm_seq.h"
+}
+
+static unsigned n_cmds = 1000;
+static unsigned window = USB_ACK_MAX;
+static uint32_t xfer_ticks = SIM_XFER_TICKS;
+static uint32_t idle_ticks = SIM_IDLE_TICKS;
+static const char* host_trace = 0;
+static const char* dev_trace = 0;
+static int status_ms = -1;
+
+/* Parameter traffic as a UI would send it */
+static std::future<slm::Ack> command(slm::Client& c, unsigned i){
+    switch(i % 4u){
+        case 0: return c.set_fps(10.0f + (float)(i % 5u));
+        case 1: return c.set_exposure(0.02f + 0.001f * (float)(i % 7u));
+        case 2: return c.set_z_steps((uint16_t)i);
+        default: return c.nop();
+    }
+}
+
+static void drive(slm::Client& c, slm::Transport& link, std::future<slm::Ack>& f){
+    while(f.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+        if(!c.poll()){
+            link.idle();
+        }
+    }
+}
+
+static void print_latency(const char* name, std::vector<double>& lat){
+    double sum = 0;
+    size_t n = lat.size();
+
+    if(n == 0){
+        return;
+    }
+    std::sort(lat.begin(), lat.end());
+    for(size_t i = 0; i < n; i++){
+        sum += lat[i];
+    }
+    printf("%s_latency_us: mean %.1f p50 %.1f p99 %.1f max %.1f\n", name,
+           sum / n, lat[n / 2u], lat[(n * 99u) / 100u], lat[n - 1u]);
+}
+
+static unsigned count_bad(std::vector<std::future<slm::Ack> >& fs, std::vector<double>* lat){
+    unsigned bad = 0;
+
+    for(size_t i = 0; i < fs.size(); i++){
+        slm::Ack a = fs[i].get();
+
+        bad += a.status != CMD_OK;
+        if(lat){
+            lat->push_back(a.done_us - a.sent_us);
+        }
+    }
+    return bad;
+}
+
+static unsigned run_serial(void){
+    slm::SimTransport link(xfer_ticks, idle_ticks);
+    slm::Client c(link, 1u);
+    std::vector<double> lat;
+    double t0 = link.now_us();
+    unsigned bad = 0, i;
+
+    for(i = 0; i < n_cmds; i++){
+        double issue = link.now_us();
+        std::future<slm::Ack> f = command(c, i);
+
+        drive(c, link, f);
+        slm::Ack a = f.get();
+        bad += a.status != CMD_OK;
+        lat.push_back(a.done_us - issue);
+    }
+    double span = link.now_us() - t0;
+
+    print_latency("serial", lat);
+    printf("serial_cmds_per_s: %.0f\n", n_cmds / (span * 1e-6));
+    printf("serial_out_packets: %llu\n", (unsigned long long)c.counters().out_packets);
+    return bad;
+}
+
+static unsigned run_pipelined(void){
+    slm::SimTransport link(xfer_ticks, idle_ticks);
+    slm::Client c(link, window);
+    std::vector<std::future<slm::Ack> > fs;
+    std::vector<double> lat;
+    double t0 = link.now_us();
+    unsigned bad, i;
+
+    for(i = 0; i < n_cmds; i++){
+        fs.push_back(command(c, i));
+    }
+    drive(c, link, fs.back());
+    double span = link.now_us() - t0;
+    bad = count_bad(fs, &lat);
+
+    slm::Counters k = c.counters();
+    print_latency("pipelined", lat);
+    printf("pipelined_cmds_per_s: %.0f\n", n_cmds / (span * 1e-6));
+    printf("pipelined_out_packets: %llu\n", (unsigned long long)k.out_packets);
+    printf("pipelined_ack_overflows: %llu\n", (unsigned long long)k.ack_overflows);
+    return bad;
+}
+
+static unsigned run_threaded(void){
+    slm::SimTransport link(xfer_ticks, idle_ticks);
+    slm::Client c(link, window);
+    std::vector<std::future<slm::Ack> > fs;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    unsigned bad, i;
+
+    c.start();
+    for(i = 0; i < n_cmds; i++){
+        fs.push_back(command(c, i));
+    }
+    bad = count_bad(fs, 0);
+    c.stop();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    printf("threaded_wall_cmds_per_s: %.0f\n", n_cmds / wall);
+    return bad;
+}
+
+static unsigned run_acquisition(void){
+    slm::SimTransport link(xfer_ticks, idle_ticks);
+    slm::Client c(link, window);
+    std::vector<std::future<slm::Ack> > fs;
+    unsigned frames = 0;
+
+    c.on_timestamps([&frames](const struct ts_packet& p){
+        for(uint8_t i = 0; i < p.count && i < TS_PER_PACKET; i++){
+            frames += p.entry[i].kind == TS_FRAME;
+        }
+    });
+    if(host_trace && !c.capture(host_trace)){
+        printf("can't write %s\n", host_trace);
+        return 1;
+    }
+    if(dev_trace && !c.device_capture(dev_trace)){
+        printf("can't write %s\n", dev_trace);
+        return 1;
+    }
+    std::shared_future<slm::Status> done = c.wait_for(slm::EV_COUNT_DONE);
+    double t0 = link.now_us();
+
+    if(status_ms >= 0){
+        fs.push_back(c.set_status_period((uint16_t)status_ms));
+    }
+    fs.push_back(c.set_timestamps(true));
+    fs.push_back(c.set_laser(BLUE_LASER));
+    fs.push_back(c.set_sim_mode(THREE_BEAM));
+    fs.push_back(c.set_run_mode(COUNT_MODE, 2u));
+    fs.push_back(c.set_fps(20.0f));
+    fs.push_back(c.start_capture());
+    drive(c, link, fs.back());
+    double setup = link.now_us() - t0;
+    while(done.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+        if(!c.poll()){
+            link.idle();
+        }
+    }
+    double total = link.now_us() - t0;
+    /* Let the last timestamps drain */
+    for(unsigned i = 0; i < 200u; i++){
+        if(!c.poll()){
+            link.idle();
+        }
+    }
+
+    printf("acquisition_setup_us: %.1f\n", setup);
+    printf("acquisition_done_ms: %.3f\n", total / 1000.0);
+    printf("acquisition_fps: %.3f\n", done.get().fps);
+    printf("acquisition_ts_frames: %u\n", frames);
+    printf("acquisition_status_packets: %llu\n", (unsigned long long)c.counters().status_packets);
+    printf("acquisition_status_frames: %u slm %u late %u skipped %u\n", c.status().count,
+           c.status().slm, c.status().late, c.status().skipped);
+    printf("acquisition_lcd: \"%s\" \"%s\"\n", sim_lcd_row(0), sim_lcd_row(1));
+    return count_bad(fs, 0);
+}
+
+static void usage(const char* prog){
+    printf("usage: %s [options]\n"
+           "  --commands N       commands per run (default 1000)\n"
+           "  --window N         records in flight (default %u)\n"
+           "  --xfer-ticks T     simulated bulk transaction time (default %u)\n"
+           "  --idle-ticks T     simulated host poll gap (default %u)\n"
+           "  --trace FILE       host side session trace of the acquisition run\n"
+           "  --device-trace FILE  firmware side session trace of the acquisition run\n"
+           "  --status-ms MS     status heartbeat for the acquisition run (default %u)\n",
+           prog, USB_ACK_MAX, SIM_XFER_TICKS, SIM_IDLE_TICKS, USB_STATUS_PERIOD_MS);
+}
+
+int main(int argc, char** argv){
+    static const struct option opts[] = {
+        {"commands", required_argument, 0, 'c'},
+        {"window", required_argument, 0, 'w'},
+        {"xfer-ticks", required_argument, 0, 'x'},
+        {"idle-ticks", required_argument, 0, 'i'},
+        {"trace", required_argument, 0, 't'},
+        {"device-trace", required_argument, 0, 'd'},
+        {"status-ms", required_argument, 0, 's'},
+        {"help", no_argument, 0, 'H'},
+        {0, 0, 0, 0}
+    };
+    unsigned bad = 0;
+    int c;
+
+    while((c = getopt_long(argc, argv, "", opts, NULL)) != -1){
+        switch(c){
+            case 'c': n_cmds = (unsigned)strtoul(optarg, NULL, 0); break;
+            case 'w': window = (unsigned)strtoul(optarg, NULL, 0); break;
+            case 'x': xfer_ticks = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'i': idle_ticks = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 't': host_trace = optarg; break;
+            case 'd': dev_trace = optarg; break;
+            case 's': status_ms = (int)strtoul(optarg, NULL, 0); break;
+            default: usage(argv[0]); return c == 'H' ? 0 : 1;
+        }
+    }
+    if(n_cmds == 0){
+        n_cmds = 1;
+    }
+
+    printf("commands: %u\n", n_cmds);
+    printf("window: %u\n", window);
+    bad += run_serial();
+    bad += run_pipelined();
+    bad += run_threaded();
+    bad += run_acquisition();
+    printf("failed_commands: %u\n", bad);
+    return bad ? 1 : 0;
+}
+
+/* [] END OF FILE */
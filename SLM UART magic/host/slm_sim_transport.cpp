@@ -0,0 +1,55 @@
+/*******************************************************************************
+* File Name: slm_sim_transport.cpp
+*
+* Description:
+*   Firmware simulator backend of slm::Transport, see slm_sim_transport.h.
+*
+*******************************************************************************/
+
+#include "slm_sim_transport.h"
+
+extern "C" {
+#include "slm_sim_dev.h"
+#include "slm_usb.h"
+}
+
+namespace slm {
+
+SimTransport::SimTransport(uint32_t xfer_ticks, uint32_t idle_ticks)
+    : xfer_(xfer_ticks), idle_(idle_ticks ? idle_ticks : 1u){
+    sim_dev_init();
+}
+
+bool SimTransport::write(const uint8_t* buf, size_t len){
+    sim_dev_run(xfer_);
+    return sim_usb_host_write(OUT_EP_NUM, buf, (uint16)len) != 0;
+}
+
+size_t SimTransport::read(uint8_t* buf, size_t len){
+    size_t n;
+
+    sim_dev_run(xfer_);
+    n = sim_usb_host_read(IN_EP_NUM, buf, (uint16)len);
+#if (STATUS_EP_NUM != 0u)
+    if(n == 0){
+        n = sim_usb_host_read(STATUS_EP_NUM, buf, (uint16)len);
+    }
+#endif
+    return n;
+}
+
+void SimTransport::idle(){
+    sim_dev_run(idle_);
+}
+
+double SimTransport::now_us(){
+    return (double)sim_now() * 0.5;
+}
+
+void SimTransport::run(uint64_t ticks){
+    sim_dev_run(ticks);
+}
+
+} // namespace slm
+
+/* [] END OF FILE */
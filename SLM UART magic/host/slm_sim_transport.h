@@ -0,0 +1,48 @@
+/*******************************************************************************
+* File Name: slm_sim_transport.h
+*
+* Description:
+*   slm::Transport on the firmware simulator (sim/slm_sim_dev.h).  The USB
+*   firmware main loop, T_ISR and the counter chain run in-process on the
+*   2MHz tick model; time only moves when the client calls into the
+*   transport:
+*     write() / read()   xfer_ticks, one bulk transaction on the bus
+*     idle()             idle_ticks, the host waiting before it polls again
+*   so a run is deterministic and as fast as the workstation allows.  The
+*   simulator is one set of globals, so only one SimTransport may exist at a
+*   time.
+*
+*******************************************************************************/
+
+#ifndef SLM_SIM_TRANSPORT_H
+#define SLM_SIM_TRANSPORT_H
+
+#include "slm_transport.h"
+
+namespace slm {
+
+#define SIM_XFER_TICKS (100u)   // 50us per bulk transaction, host stack included
+#define SIM_IDLE_TICKS (250u)   // 125us between polls when nothing moved
+
+class SimTransport : public Transport{
+public:
+    explicit SimTransport(uint32_t xfer_ticks = SIM_XFER_TICKS, uint32_t idle_ticks = SIM_IDLE_TICKS);
+
+    bool write(const uint8_t* buf, size_t len);
+    size_t read(uint8_t* buf, size_t len);
+    void idle();
+    double now_us();
+
+    /* Runs the device on its own, e.g. with the host away */
+    void run(uint64_t ticks);
+
+private:
+    uint32_t xfer_;
+    uint32_t idle_;
+};
+
+} // namespace slm
+
+#endif /* SLM_SIM_TRANSPORT_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,45 @@
+/*******************************************************************************
+* File Name: slm_transport.h
+*
+* Description:
+*   Packet transport under slm::Client.  One call moves at most one USB
+*   packet on the vendor bulk endpoints (slm_usb.h): write() is an OUT
+*   packet to OUT_EP_NUM, read() takes whatever the device has loaded on
+*   IN_EP_NUM, or else on STATUS_EP_NUM if the firmware has one.  Neither
+*   blocks for long; the client calls idle() when a pass moved nothing.
+*
+*   SimTransport (slm_sim_transport.h) runs the firmware model in-process,
+*   UsbTransport (slm_usb_transport.h, make LIBUSB=1) talks to the board.
+*
+*******************************************************************************/
+
+#ifndef SLM_TRANSPORT_H
+#define SLM_TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace slm {
+
+class Transport{
+public:
+    virtual ~Transport(){}
+
+    /* false if the device NAKed, the packet was not taken */
+    virtual bool write(const uint8_t* buf, size_t len) = 0;
+
+    /* Length of the IN packet read into buf, 0 if there was none */
+    virtual size_t read(uint8_t* buf, size_t len) = 0;
+
+    /* Nothing moved, give the device some time */
+    virtual void idle() = 0;
+
+    /* Transport clock, used to time commands */
+    virtual double now_us() = 0;
+};
+
+} // namespace slm
+
+#endif /* SLM_TRANSPORT_H */
+
+/* [] END OF FILE */
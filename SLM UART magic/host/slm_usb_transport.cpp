@@ -0,0 +1,79 @@
+/*******************************************************************************
+* File Name: slm_usb_transport.cpp
+*
+* Description:
+*   libusb-1.0 backend of slm::Transport, see slm_usb_transport.h.
+*
+*******************************************************************************/
+
+#include <chrono>
+#include <thread>
+#include <libusb-1.0/libusb.h>
+
+#include "slm_usb_transport.h"
+
+extern "C" {
+#include "slm_usb.h"
+}
+
+namespace slm {
+
+#define USB_INTERFACE (0)
+
+UsbTransport::UsbTransport(uint16_t vid, uint16_t pid) : ctx_(0), dev_(0){
+    if(libusb_init(&ctx_) != 0){
+        throw std::runtime_error("libusb_init failed");
+    }
+    dev_ = libusb_open_device_with_vid_pid(ctx_, vid, pid);
+    if(!dev_){
+        libusb_exit(ctx_);
+        throw std::runtime_error("SLM controller not found");
+    }
+    libusb_set_auto_detach_kernel_driver(dev_, 1);
+    if(libusb_claim_interface(dev_, USB_INTERFACE) != 0){
+        libusb_close(dev_);
+        libusb_exit(ctx_);
+        throw std::runtime_error("can't claim the SLM controller interface");
+    }
+}
+
+UsbTransport::~UsbTransport(){
+    libusb_release_interface(dev_, USB_INTERFACE);
+    libusb_close(dev_);
+    libusb_exit(ctx_);
+}
+
+bool UsbTransport::write(const uint8_t* buf, size_t len){
+    int done = 0;
+    int rc = libusb_bulk_transfer(dev_, OUT_EP_NUM | LIBUSB_ENDPOINT_OUT, const_cast<uint8_t*>(buf),
+                                  (int)len, &done, USB_XFER_TIMEOUT_MS);
+
+    return rc == 0 && done == (int)len;
+}
+
+size_t UsbTransport::read(uint8_t* buf, size_t len){
+    int got = 0;
+    int rc = libusb_bulk_transfer(dev_, IN_EP_NUM | LIBUSB_ENDPOINT_IN, buf, (int)len, &got,
+                                  USB_XFER_TIMEOUT_MS);
+
+#if (STATUS_EP_NUM != 0u)
+    if(got == 0){
+        rc = libusb_interrupt_transfer(dev_, STATUS_EP_NUM | LIBUSB_ENDPOINT_IN, buf, (int)len, &got,
+                                       USB_XFER_TIMEOUT_MS);
+    }
+#endif
+    return (rc == 0 || rc == LIBUSB_ERROR_TIMEOUT) ? (size_t)got : 0u;
+}
+
+void UsbTransport::idle(){
+    std::this_thread::sleep_for(std::chrono::microseconds(USB_IDLE_US));
+}
+
+double UsbTransport::now_us(){
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace slm
+
+/* [] END OF FILE */
@@ -0,0 +1,49 @@
+/*******************************************************************************
+* File Name: slm_usb_transport.h
+*
+* Description:
+*   slm::Transport on the board itself, through libusb-1.0.  Claims
+*   interface 0 of the first device with the given vendor / product id and
+*   uses the vendor bulk endpoints of slm_usb.h.  Only built with
+*   make LIBUSB=1.
+*
+*******************************************************************************/
+
+#ifndef SLM_USB_TRANSPORT_H
+#define SLM_USB_TRANSPORT_H
+
+#include <stdexcept>
+#include "slm_transport.h"
+
+struct libusb_context;
+struct libusb_device_handle;
+
+namespace slm {
+
+#define USB_XFER_TIMEOUT_MS (2u)    // a NAKed transfer gives up after this
+#define USB_IDLE_US (100u)
+
+class UsbTransport : public Transport{
+public:
+    /* Throws std::runtime_error if the device can't be opened */
+    UsbTransport(uint16_t vid, uint16_t pid);
+    ~UsbTransport();
+
+    bool write(const uint8_t* buf, size_t len);
+    size_t read(uint8_t* buf, size_t len);
+    void idle();
+    double now_us();
+
+private:
+    UsbTransport(const UsbTransport&);
+    UsbTransport& operator=(const UsbTransport&);
+
+    libusb_context* ctx_;
+    libusb_device_handle* dev_;
+};
+
+} // namespace slm
+
+#endif /* SLM_USB_TRANSPORT_H */
+
+/* [] END OF FILE */
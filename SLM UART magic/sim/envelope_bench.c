@@ -0,0 +1,226 @@
+/*******************************************************************************
+* File Name: envelope_bench.c
+*
+* Description:
+*   Frame rate envelope of the controller as CSV.  Sweeps camera rows,
+*   the readout modes of the build's camera profile, laser mode and SIM
+*   mode; for each point the frame is the fastest minFrameTicks() allows
+*   for the exposure (--exposure-ms, 0 for the shortest the laser
+*   blanking allows) and setExposure() / setWaitTime() program the chain
+*   exactly as CHANGE_FPS does.  Per row:
+*     frame_us     programmed chain period, TRG_CNT + SLM_WAIT + SLM_TRIG
+*     max_fps      its rate
+*     duty_cycle   exposure / frame period
+*     slm_share    SLM reload and trigger / frame period
+*     limit        what bound the frame (limitName())
+*     stack_ms     a Z_MODE stack of --planes planes through T_ISR on the
+*                  counter chain model, first exposure to last SLM trigger,
+*                  stage moves included (STAGE_HS_HW for SEVEN_PHASE, which
+*                  steps its own AXIAL_MAX planes), with its frame and
+*                  stage pulse counts
+*
+*   Every value is worked out in ticks, so the table only moves when the
+*   timing core does.  make envelope builds one bench per camera, writes
+*   envelope.csv and diffs it against envelope_baseline.csv; a change to
+*   readTime() / setWaitTime() fails there with the throughput delta.
+*   make envelope-baseline takes the new table.
+*
+*   Build: make -C sim envelope_bench_ANDOR   Run: sim/envelope_bench_ANDOR --help
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "slm_seq.h"
+#include "slm_timing.h"
+#include "slm_chan.h"
+
+#define ENV_SLICE_TICKS (100u)              // main loop granularity, 50us
+#define ENV_STAGE_PULSE (12000u)            // STAGE_TRIG as the firmware sets it
+#define ENV_TIMEOUT_TICKS (1200000000ull)   // 10 minutes
+#define ENV_PLANES (10u)
+#define TICKS_TO_US(t) ((double)(t) * COUNT_PERIOD * 1e6)
+
+struct env_cam{
+    const char* name;
+    uint8 cap_mode;
+};
+
+struct env_sim{
+    const char* name;
+    uint8 mode;
+};
+
+struct env_laser{
+    const char* name;
+    uint8 laser;
+};
+
+static const struct env_cam env_cams[] = {
+#if defined(SLM_CAMERA_HAMAMATSU)
+    {"hama_normal", CAP_MODE_NORMAL},
+    {"hama_slow", CAP_MODE_SLOW},
+#else
+    {"andor_30mhz", CAP_MODE_SLOW},
+#endif
+};
+
+static const struct env_sim env_sims[] = {
+    {"z", NO_SIM_Z_ONLY},
+    {"single", SINGLE_ANGLE},
+    {"two", TWO_BEAM},
+    {"three", THREE_BEAM},
+    {"seven", SEVEN_PHASE},
+};
+
+static const struct env_laser env_lasers[] = {
+    {"blue", BLUE_LASER},
+    {"green", GREEN_LASER},
+    {"both", BOTH_LASERS},
+};
+
+static const uint16 env_verts[] = {64u, 128u, 256u, 512u, 1024u, 2048u};
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+/* The stack as the chain model ran it */
+struct env_stack{
+    uint64_t frames;
+    uint64_t stage_pulses;
+    uint64_t first_start;
+    uint64_t last_end;
+};
+
+static struct env_stack stack;
+
+static void on_event(uint8 event, uint64_t tick){
+    if(event == SIM_EV_EXPOSE_START){
+        if(stack.frames++ == 0){
+            stack.first_start = tick;
+        }
+    } else if(event == SIM_EV_CHAIN_END){
+        stack.last_end = tick;
+    } else if(event == SIM_EV_STAGE_PULSE){
+        stack.stage_pulses++;
+    }
+}
+
+/* Power up, SET_LASER_MODE, SET_SIM_MODE, CHANGE_Z_STEPS, as the USB
+*  firmware applies them
+*/
+static void env_setup(const struct env_cam* cam, uint16 rows, uint8 laser, uint8 sim, uint16 planes){
+    sim_reset();
+    sim_set_isr(seq_frame_done);
+    sim_set_stage_isr(seq_stage_ready);
+    sim_set_time_isr(seq_time_up);
+    sim_set_event_hook(on_event);
+    capMode = cam->cap_mode;
+    vert = rows;
+    readTime();
+    HW_SLM_TRIG_WRITE_PERIOD(SLM_TRG_TICKS);
+    stageWaitTicks = STAGE_SETTLE_TICKS;
+    HW_STAGE_TRIG_WRITE_PERIOD(ENV_STAGE_PULSE);
+    laser_conf = laser;
+    chan_set_laser(laser);
+    setBlankingDelay();
+    seq_set_sim_mode(sim);
+    seq_set_run_mode(Z_MODE);
+    seq_set_stage_handshake(STAGE_HS_HW);
+    zSteps = planes - 1u;
+}
+
+/* START_CAPTURE and the main loop until Z_FIN, 0 on timeout */
+static uint8 env_run_stack(void){
+    uint8 finished = 0;
+
+    stack.frames = stack.stage_pulses = 0;
+    stack.first_start = stack.last_end = 0;
+    seq_start();
+    while(!finished && sim_now() < ENV_TIMEOUT_TICKS){
+        sim_advance(ENV_SLICE_TICKS);
+        if(seq_take_events() & Z_FIN){
+            finished = 1;
+        }
+    }
+    /* Let the frame in flight complete */
+    while(sim_chain_busy() && sim_now() < ENV_TIMEOUT_TICKS){
+        sim_advance(ENV_SLICE_TICKS);
+    }
+    return finished;
+}
+
+static void usage(const char* prog){
+    printf("usage: %s [--exposure-ms ms] [--planes n] [--no-header]\n", prog);
+    printf("  --exposure-ms  exposure per frame, 0 (default) for the shortest the laser allows\n");
+    printf("  --planes       Z_MODE stack depth for stack_ms (default %u)\n", ENV_PLANES);
+    printf("  --no-header    CSV rows only, to append another camera build\n");
+}
+
+int main(int argc, char** argv){
+    static const struct option opts[] = {
+        {"exposure-ms", required_argument, 0, 'e'},
+        {"planes", required_argument, 0, 'z'},
+        {"no-header", no_argument, 0, 'N'},
+        {"help", no_argument, 0, 'H'},
+        {0, 0, 0, 0}
+    };
+    uint32 exp_ticks = 0;
+    uint16 planes = ENV_PLANES;
+    uint8 header = 1;
+    uint8 failed = 0;
+    unsigned c, v, l, s;
+    int opt;
+
+    while((opt = getopt_long(argc, argv, "", opts, NULL)) != -1){
+        switch(opt){
+            case 'e': exp_ticks = secToTicks(strtof(optarg, NULL) / 1000.0f); break;
+            case 'z': planes = (uint16)strtoul(optarg, NULL, 0); break;
+            case 'N': header = 0; break;
+            default: usage(argv[0]); return opt == 'H' ? 0 : 1;
+        }
+    }
+    if(planes == 0u){
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(header){
+        printf("camera,vert,laser,sim,limit,frame_us,max_fps,exposure_us,readout_us,"
+               "duty_cycle,slm_share,stack_frames,stack_stage_pulses,stack_ms\n");
+    }
+    for(c = 0; c < COUNT_OF(env_cams); c++){
+        for(v = 0; v < COUNT_OF(env_verts); v++){
+            for(l = 0; l < COUNT_OF(env_lasers); l++){
+                for(s = 0; s < COUNT_OF(env_sims); s++){
+                    uint8 limit;
+                    uint32 period;
+
+                    env_setup(&env_cams[c], env_verts[v], env_lasers[l].laser, env_sims[s].mode, planes);
+
+                    /* CHANGE_FPS to the fastest frame for the exposure */
+                    frameTicks = minFrameTicks(exp_ticks, &limit);
+                    fps_in = ticksToFps(frameTicks);
+                    setExposure();
+                    period = exposureTicks + wait_time_ticks + SLM_TRG_TICKS;
+
+                    if(!env_run_stack()){
+                        failed = 1;
+                    }
+                    printf("%s,%u,%s,%s,%s,%.1f,%.3f,%.1f,%.1f,%.4f,%.4f,%llu,%llu,%.3f\n",
+                           env_cams[c].name, env_verts[v], env_lasers[l].name, env_sims[s].name,
+                           limitName(limit), TICKS_TO_US(period), (double)TICKS_PER_SEC / period,
+                           TICKS_TO_US(exposureTicks), TICKS_TO_US(readOutTicks),
+                           (double)exposureTicks / period,
+                           (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) / period,
+                           (unsigned long long)stack.frames, (unsigned long long)stack.stage_pulses,
+                           TICKS_TO_US(stack.last_end - stack.first_start) / 1000.0);
+                }
+            }
+        }
+    }
+    return failed ? 2 : 0;
+}
+
+/* [] END OF FILE */
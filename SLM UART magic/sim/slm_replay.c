@@ -0,0 +1,314 @@
+/*******************************************************************************
+* File Name: slm_replay.c
+*
+* Description:
+*   Plays a USB session trace (common/slm_trace.h) back through the USB main
+*   loop model (slm_sim_dev.h).  Every recorded OUT packet is written to the
+*   OUT endpoint at its recorded time, retrying on NAK, while a host model
+*   reads IN every --poll-ticks.  Reported:
+*     apply_latency_us    OUT packet written to its first command applied
+*     start_latency_us    START_CAPTURE written to the first exposure
+*     state_divergences   frameTicks / exposureTicks / wait_time_ticks after a
+*                         packet that differ from the TRACE_STATE recorded
+*                         with it (device traces only), the first few listed
+*     events              one-shot status flags and acks, recorded vs replayed
+*   A trace recorded with one camera profile and replayed by a build for
+*   another shows where their timing differs.
+*
+*   Build: make -C sim slm_replay        Run: sim/slm_replay --help
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "slm_sim_dev.h"
+#include "slm_timing.h"
+#include "slm_usb.h"
+#include "slm_ts.h"
+#include "slm_isr_stats.h"
+#include "slm_trace.h"
+
+#define REPLAY_POLL_TICKS (250u)        // host IN poll, 125us
+#define REPLAY_APPLY_TIMEOUT (200000u)  // 100ms
+#define REPLAY_TAIL_TICKS (200000u)     // run on after the last record, 100ms
+#define REPLAY_SHOW_MAX (5u)
+#define TICKS_TO_US(t) ((double)(t) * 1e6 / HW_TS_HZ)
+
+/* Event counters, one per one-shot flag, then acks */
+#define EV_N (6u)
+static const uint32 evFlag[EV_N - 1u] = {SEND_TRIGG, STOP_Z_STACK, STOP_COUNT, CHANGE_FPS, SET_EXPOSURE};
+static const char* const evName[EV_N] = {"send_trigg", "stop_z_stack", "stop_count", "change_fps",
+                                          "set_exposure", "acks"};
+
+struct lat{
+    uint32 n;
+    double sum;
+    double max;
+};
+
+static uint32 poll_ticks = REPLAY_POLL_TICKS;
+static uint64_t tail_ticks = REPLAY_TAIL_TICKS;
+static uint64_t next_poll;
+static uint64_t recorded[EV_N];
+static uint64_t replayed[EV_N];
+static uint64_t start_issue;
+static uint8 start_pending;
+static struct lat apply_lat;
+static struct lat start_lat;
+
+static uint32 get32(const uint8* p){
+    return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static void lat_add(struct lat* l, uint64_t ticks){
+    double us = TICKS_TO_US(ticks);
+
+    l->n++;
+    l->sum += us;
+    if(us > l->max){
+        l->max = us;
+    }
+}
+
+static void lat_print(const char* name, const struct lat* l){
+    if(l->n == 0){
+        printf("%s_us: none\n", name);
+        return;
+    }
+    printf("%s_us: mean %.1f max %.1f (%u)\n", name, l->sum / l->n, l->max, l->n);
+}
+
+static void hook(uint8 event, uint64_t tick){
+    if(event == SIM_EV_EXPOSE_START && start_pending){
+        start_pending = 0;
+        lat_add(&start_lat, tick - start_issue);
+    }
+}
+
+/* Events carried by one IN packet */
+static void count_in(uint64_t* ev, const uint8* buf, uint16 len){
+    uint32 magic, flags;
+    uint8 i;
+
+    if(len < sizeof(uint32)){
+        return;
+    }
+    magic = get32(buf);
+    if(magic == USB_ACK_MAGIC && len >= sizeof(struct usb_ack)){
+        ev[EV_N - 1u] += buf[4] < USB_ACK_MAX ? buf[4] : USB_ACK_MAX;
+        return;
+    }
+    if(magic == USB_TS_MAGIC || magic == USB_HIST_MAGIC || magic == TRACE_MAGIC
+        || len < sizeof(struct usb_data)){
+        return;
+    }
+    flags = get32(&buf[8]);
+    for(i = 0; i < EV_N - 1u; i++){
+        ev[i] += (flags & evFlag[i]) != 0;
+    }
+}
+
+/* Main loop passes up to tick, the host reading IN on its schedule */
+static void run_to(uint64_t tick){
+    uint8 in[USB_EP_SIZE];
+
+    while(sim_now() < tick){
+        uint64_t left = tick - sim_now();
+        uint64_t pass;
+
+        sim_dev_pass();
+        if(sim_now() >= next_poll){
+            count_in(replayed, in, sim_usb_host_read(IN_EP_NUM, in, sizeof(in)));
+            next_poll = sim_now() + poll_ticks;
+        }
+        pass = SIM_DEV_LOOP_TICKS + sim_lcd_take_busy();
+        sim_advance(left < pass ? left : pass);
+    }
+}
+
+/* START_CAPTURE as a legacy flag or a batch record */
+static uint8 starts_capture(const uint8* buf, uint16 len){
+    uint16 pos = sizeof(uint32);
+
+    if(len < sizeof(uint32)){
+        return 0;
+    }
+    if(get32(buf) != USB_CMD_MAGIC){
+        return len >= sizeof(struct usb_data) && (get32(&buf[8]) & START_CAPTURE);
+    }
+    while(pos + USB_CMD_HDR <= len && buf[pos] < CMD_COUNT){
+        if(buf[pos] == CMD_START){
+            return 1;
+        }
+        pos += USB_CMD_HDR + usbCmdLen[buf[pos]];
+    }
+    return 0;
+}
+
+/* Writes one recorded OUT packet and runs until it has been applied */
+static void inject(const uint8* buf, uint16 len, uint32* retries){
+    uint32 before = sim_dev_commands();
+    uint64_t issue = sim_now();
+    uint64_t give_up;
+
+    while(!sim_usb_host_write(OUT_EP_NUM, buf, len)){
+        (*retries)++;
+        run_to(sim_now() + SIM_DEV_LOOP_TICKS);
+    }
+    if(starts_capture(buf, len)){
+        start_issue = issue;
+        start_pending = 1;
+    }
+    give_up = sim_now() + REPLAY_APPLY_TIMEOUT;
+    while(sim_dev_commands() == before && sim_now() < give_up){
+        run_to(sim_now() + SIM_DEV_LOOP_TICKS);
+    }
+    if(sim_dev_commands() != before){
+        lat_add(&apply_lat, sim_now() - issue);
+    }
+}
+
+static void usage(const char* prog){
+    printf("usage: %s [options] TRACE\n"
+           "  --poll-ticks T     host IN poll interval (default %u)\n"
+           "  --tail-ms T        run on after the last record (default 100)\n",
+           prog, REPLAY_POLL_TICKS);
+}
+
+int main(int argc, char** argv){
+    static const struct option opts[] = {
+        {"poll-ticks", required_argument, 0, 'p'},
+        {"tail-ms", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'H'},
+        {0, 0, 0, 0}
+    };
+    struct trace_file_hdr hdr;
+    uint8 rec[TRACE_REC_HDR + 0xFFu];
+    uint32 hz = HW_TS_HZ, last = 0, retries = 0, packets = 0, checks = 0, diverged = 0;
+    int64_t at = 0;
+    uint8 have_time = 0, check = 0;
+    uint32 state[3] = {0, 0, 0};
+    FILE* f;
+    uint8 i;
+    int c;
+
+    while((c = getopt_long(argc, argv, "", opts, NULL)) != -1){
+        switch(c){
+            case 'p': poll_ticks = (uint32)strtoul(optarg, NULL, 0); break;
+            case 't': tail_ticks = (uint64_t)(strtod(optarg, NULL) * HW_TS_HZ / 1000.0); break;
+            default: usage(argv[0]); return c == 'H' ? 0 : 1;
+        }
+    }
+    if(optind >= argc){
+        usage(argv[0]);
+        return 1;
+    }
+    f = fopen(argv[optind], "rb");
+    if(!f){
+        printf("can't read %s\n", argv[optind]);
+        return 1;
+    }
+    if(fread(rec, 1, sizeof(hdr), f) != sizeof(hdr) || get32(rec) != TRACE_MAGIC
+        || (rec[4] | (rec[5] << 8)) != TRACE_VERSION){
+        printf("%s is not a version %u session trace\n", argv[optind], TRACE_VERSION);
+        fclose(f);
+        return 1;
+    }
+    hdr.flags = (uint16)(rec[6] | (rec[7] << 8));
+    if(poll_ticks == 0){
+        poll_ticks = 1;
+    }
+
+    sim_dev_init();
+    sim_set_event_hook(hook);
+    next_poll = 0;
+    /* A device trace starts with the packet that turned it on, long after
+    *  the host read the power up status
+    */
+    if(hdr.flags & TRACE_FROM_DEVICE){
+        sim_dev_pass();
+        sim_usb_host_read(IN_EP_NUM, rec, USB_EP_SIZE);
+    }
+
+    /* Records in file order, times unwrapped and rebased on the first one */
+    while(fread(rec, 1, TRACE_REC_HDR, f) == TRACE_REC_HDR){
+        uint32 t = get32(rec);
+        uint8 kind = rec[4];
+        uint8 len = rec[5];
+        const uint8* data = &rec[TRACE_REC_HDR];
+        uint64_t tick;
+
+        if(fread(&rec[TRACE_REC_HDR], 1, len, f) != len){
+            break;
+        }
+        if(have_time){
+            at += (int32_t)(t - last);
+        }
+        have_time = 1;
+        last = t;
+        tick = at > 0 ? (uint64_t)at * HW_TS_HZ / hz : 0;
+        run_to(tick);
+
+        switch(kind){
+            case TRACE_CLOCK:
+                if(len >= sizeof(uint32) && get32(data) != 0){
+                    /* Rebase, later times are in the new clock */
+                    at = (int64_t)((double)tick * get32(data) / HW_TS_HZ);
+                    hz = get32(data);
+                }
+                break;
+            case TRACE_OUT:
+                packets++;
+                inject(data, len, &retries);
+                state[0] = frameTicks;
+                state[1] = exposureTicks;
+                state[2] = wait_time_ticks;
+                check = 1;
+                break;
+            case TRACE_IN:
+                count_in(recorded, data, len);
+                break;
+            case TRACE_STATE:
+                if(!check || len < sizeof(state)){
+                    break;
+                }
+                check = 0;
+                checks++;
+                if(get32(&data[0]) != state[0] || get32(&data[4]) != state[1]
+                    || get32(&data[8]) != state[2]){
+                    if(diverged < REPLAY_SHOW_MAX){
+                        printf("divergence: packet %u at %.1f us frame %u/%u exposure %u/%u wait %u/%u\n",
+                               packets, TICKS_TO_US(tick), get32(&data[0]), state[0],
+                               get32(&data[4]), state[1], get32(&data[8]), state[2]);
+                    }
+                    diverged++;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    fclose(f);
+    run_to(sim_now() + tail_ticks);
+
+    printf("trace: %s\n", (hdr.flags & TRACE_FROM_DEVICE) ? "device" : "host");
+    printf("trace_hz: %u\n", hz);
+    printf("out_packets: %u\n", packets);
+    printf("out_retries: %u\n", retries);
+    printf("commands_applied: %u\n", sim_dev_commands());
+    lat_print("apply_latency", &apply_lat);
+    lat_print("start_latency", &start_lat);
+    printf("state_checks: %u\n", checks);
+    printf("state_divergences: %u\n", diverged);
+    for(i = 0; i < EV_N; i++){
+        printf("events_%s: recorded %llu replayed %llu\n", evName[i],
+               (unsigned long long)recorded[i], (unsigned long long)replayed[i]);
+    }
+    printf("replay_ms: %.3f\n", TICKS_TO_US(sim_now()) / 1000.0);
+    return diverged ? 2 : 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,834 @@
+/*******************************************************************************
+* File Name: slm_sim.c
+*
+* Description:
+*   Linux front end for the trigger sequencer.  Configures common/ exactly
+*   like the USB firmware does on CHANGE_FPS / SET_SIM_MODE / START_CAPTURE,
+*   runs the counter chain model and reports the achieved frame period, dead
+*   time and per-set / per-acquisition duration.  The same frame period, as
+*   the host would see it in the timestamp stream (slm_ts.h), is reported
+*   from the drained ring.  --isr-stats prints the T_ISR latency and
+*   execution histograms (slm_isr_stats.h) as READ_ISR_STATS returns them.
+*   status_* are the frame counters of the status packet (slm_frames.h).
+*   For SEVEN_PHASE, plane_gap_us is the time from the last frame of a plane
+*   to the first exposure of the next, with the stage handshake picked by
+*   --stage-hs: usb (SEND_TRIGG, host moves the stage, STAGE_MOVE_COMPLETE)
+*   or hw (STAGE_REG pulse, STAGE_READY input).
+*   In timed mode, timed_frames_after_deadline counts exposures that began
+*   after --time had passed: --timed-stop exact should show none with the
+*   TIME_CNT deadline, --timed-clock isr keeps the time in T_ISR instead.
+*   --program runs a sequence program (slm_prog.h) as SIM_PROGRAM, written
+*   as comma separated steps, e.g. 5 phases x 3 angles with a stage step
+*   per angle: --program loop:3,frames:5,stage,next
+*   --planes runs a Z_MODE stack from a plane table (slm_plane.h), written
+*   as pulses[:exposure ms[:nosim]] per plane, e.g. deeper planes exposed
+*   longer and a widefield plane on top: --planes 0,1,2:80,2:120:nosim
+*   --expo sets exposure table slots (slm_expo.h), pos:ms[:chan] each, e.g.
+*   the five phases of the second angle at 60ms: --expo 5:60,6:60,7:60,8:60,9:60
+*   --sched takes a hardware burst where it fits (trigger_path burst),
+*   --no-burst leaves the board without one so the DMA schedule runs.
+*   timing_check is START_CAPTURE's static check (slm_check.h) with the
+*   slack of every constraint in ticks; a failed check doesn't run, as the
+*   firmware doesn't start.
+*
+*   Build: make -C sim        Run: sim/slm_sim --help
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "slm_seq.h"
+#include "slm_timing.h"
+#include "slm_sched.h"
+#include "slm_ts.h"
+#include "slm_isr_stats.h"
+#include "slm_prog.h"
+#include "slm_chan.h"
+#include "slm_frames.h"
+#include "slm_plane.h"
+#include "slm_expo.h"
+
+#define ARB_EXP (0x4)
+#define BLANK_ON (0u)
+#define BLANK_OFF (1u)
+
+#define SIM_SLICE_TICKS (100u)          // main loop granularity, 50us
+#define SIM_HOST_TICKS (4000u)          // USB round trip for STAGE_MOVE_COMPLETE
+#define SIM_STAGE_TICKS (38000u)        // stage move and settle, STAGE_WAIT as the firmware sets it
+#define SIM_STAGE_PULSE (12000u)        // STAGE_TRIG as the firmware sets it
+#define SIM_TIMEOUT_TICKS (1200000000ull) // 10 minutes
+#define TICKS_TO_US(t) ((double)(t) * COUNT_PERIOD * 1e6)
+#define SIM_PERIOD_BINS (8u)            // distinct frame periods kept for --retune
+
+struct sim_stats{
+    uint64_t frames;
+    uint64_t first_start;
+    uint64_t last_start;
+    uint64_t last_end;
+    uint64_t expose_start;
+    uint64_t expose_end;
+    uint64_t period_min;
+    uint64_t period_max;
+    uint64_t period_sum;
+    uint64_t dead_min;
+    uint64_t dead_max;
+    uint64_t dead_sum;
+    uint64_t exposure_sum;
+    uint64_t exposure_min;
+    uint64_t exposure_max;
+    uint64_t sets;
+    uint64_t set_start;
+    uint64_t set_sum;
+    uint64_t stage_pulses;
+    uint64_t set_frames;
+    uint8 plane_pending;
+    uint64_t planes;
+    uint64_t plane_min;
+    uint64_t plane_max;
+    uint64_t plane_sum;
+    uint64_t period_len[SIM_PERIOD_BINS];
+    uint64_t period_n[SIM_PERIOD_BINS];
+    uint64_t period_other;
+    uint64_t period_last;
+    uint64_t capture_start;
+    uint64_t timed_after;
+    uint32 plane_frames[PLANE_MAX];
+    uint64_t plane_exposure[PLANE_MAX];   // last exposure of each table plane
+};
+
+struct ts_stats{
+    uint32 frames;
+    uint32 chan_frames[CHAN_MAX];
+    uint32 stages;
+    uint32 dropped;
+    uint32 last;
+    uint32 interval_min;
+    uint32 interval_max;
+    uint64_t interval_sum;
+};
+
+static struct sim_stats stats;
+static struct ts_stats ts;
+static uint8 sched_mode = 0;
+static uint64_t frames_per_set = 1;
+static uint8 show_isr_stats = 0;
+static uint64_t prog_frames = 0;
+
+/* Frame periods by length; after a retune only the old and the new one should show */
+static void period_bin(uint64_t p){
+    uint8 i;
+
+    stats.period_last = p;
+    for(i = 0; i < SIM_PERIOD_BINS; i++){
+        if(stats.period_n[i] == 0 || stats.period_len[i] == p){
+            stats.period_len[i] = p;
+            stats.period_n[i]++;
+            return;
+        }
+    }
+    stats.period_other++;
+}
+
+/* Frames whose period is neither the first nor the last one seen */
+static uint64_t torn_frames(uint64_t last){
+    uint64_t n = stats.period_other;
+    uint8 i;
+
+    for(i = 1; i < SIM_PERIOD_BINS && stats.period_n[i]; i++){
+        if(stats.period_len[i] != last){
+            n += stats.period_n[i];
+        }
+    }
+    return n;
+}
+
+static void set_done(uint64_t tick){
+    stats.sets++;
+    stats.set_sum += tick - stats.set_start;
+    stats.set_start = tick;
+}
+
+static void on_event(uint8 event, uint64_t tick){
+    switch(event){
+        case SIM_EV_EXPOSE_START:
+            if(stats.plane_pending){
+                uint64_t gap = tick - stats.last_end;
+
+                stats.plane_pending = 0;
+                stats.plane_sum += gap;
+                if(stats.planes == 0 || gap < stats.plane_min){
+                    stats.plane_min = gap;
+                }
+                if(gap > stats.plane_max){
+                    stats.plane_max = gap;
+                }
+                stats.planes++;
+            }
+            if(stats.frames == 0){
+                stats.first_start = tick;
+                stats.set_start = tick;
+            } else {
+                uint64_t p = tick - stats.last_start;
+                uint64_t dead = tick - stats.expose_end;
+                stats.period_sum += p;
+                if(stats.frames == 1 || p < stats.period_min){
+                    stats.period_min = p;
+                }
+                if(p > stats.period_max){
+                    stats.period_max = p;
+                }
+                stats.dead_sum += dead;
+                if(stats.frames == 1 || dead < stats.dead_min){
+                    stats.dead_min = dead;
+                }
+                if(dead > stats.dead_max){
+                    stats.dead_max = dead;
+                }
+                period_bin(p);
+            }
+            if(mode == TIMED_MODE && tick >= stats.capture_start + time_ticks){
+                stats.timed_after++;
+            }
+            stats.last_start = tick;
+            stats.expose_start = tick;
+            stats.frames++;
+            if(seq_plane_table()){
+                stats.plane_frames[zCount]++;
+            }
+            break;
+        case SIM_EV_EXPOSE_END:
+            if(seq_plane_table()){
+                stats.plane_exposure[zCount] = tick - stats.expose_start;
+            }
+            if(stats.exposure_min == 0 || tick - stats.expose_start < stats.exposure_min){
+                stats.exposure_min = tick - stats.expose_start;
+            }
+            if(tick - stats.expose_start > stats.exposure_max){
+                stats.exposure_max = tick - stats.expose_start;
+            }
+            stats.exposure_sum += tick - stats.expose_start;
+            stats.expose_end = tick;
+            break;
+        case SIM_EV_CHAIN_END:
+            stats.last_end = tick;
+            /* No T_ISR to watch when the schedule DMA runs the sets */
+            if(sched_mode && ++stats.set_frames == frames_per_set){
+                stats.set_frames = 0;
+                set_done(tick);
+            }
+            break;
+        case SIM_EV_STAGE_PULSE:
+            stats.stage_pulses++;
+            break;
+        default:
+            break;
+    }
+}
+
+/* Host side of the timestamp stream */
+static void drain_ts(void){
+    struct ts_packet p;
+    uint8 i;
+
+    while(ts_fill(&p)){
+        ts.dropped += p.dropped;
+        for(i = 0; i < p.count; i++){
+            const struct ts_entry* e = &p.entry[i];
+
+            if(e->kind == TS_STAGE){
+                ts.stages++;
+            } else if(e->kind == TS_FRAME){
+                if(ts.frames){
+                    uint32 d = e->time - ts.last;
+
+                    ts.interval_sum += d;
+                    if(ts.frames == 1 || d < ts.interval_min){
+                        ts.interval_min = d;
+                    }
+                    if(d > ts.interval_max){
+                        ts.interval_max = d;
+                    }
+                }
+                ts.last = e->time;
+                ts.frames++;
+                ts.chan_frames[e->info >> 5]++;
+            }
+        }
+    }
+}
+
+/* T_ISR as the firmware installs it, plus SIM set bookkeeping */
+static void sim_isr(void){
+    uint8 wrap = (simMode == SEVEN_PHASE) ? (angles == ANGLE_MAX) : (phases == phase_max);
+    uint32 start = isr_stats_enter();
+
+    if(simMode == SIM_PROGRAM){
+        wrap = (++prog_frames % frames_per_set) == 0;
+    }
+    if(simMode == SEVEN_PHASE && wrap && axCount < AXIAL_MAX){
+        stats.plane_pending = 1;
+    }
+
+    seq_frame_done();
+    isr_stats_exit(start);
+    if(simMode == SIM_PROGRAM && stageWait){
+        stats.plane_pending = 1;
+    }
+
+    if(wrap){
+        set_done(sim_now());
+    }
+}
+
+/* START_CAPTURE's timing check (slm_check.h) */
+static void print_check(const struct timing_verdict* v){
+    uint8 i;
+
+    printf("timing_check: %s", v->failed ? "failed" : "ok");
+    for(i = 0; i < CHECK_COUNT; i++){
+        if(v->failed & CHECK_BIT(i)){
+            printf(" %s", checkName(i));
+        }
+    }
+    printf("\ntiming_slack_ticks:");
+    for(i = 0; i < CHECK_COUNT; i++){
+        if(v->checked & CHECK_BIT(i)){
+            printf(" %s %d", checkName(i), (int)v->slack[i]);
+        }
+    }
+    printf("\n");
+}
+
+static void print_hist(const char* name, const uint16* bins){
+    uint8 i;
+
+    printf("%s:", name);
+    for(i = 0; i < ISR_HIST_BINS; i++){
+        printf(" %u", bins[i]);
+    }
+    printf("\n");
+}
+
+static uint8 parse_sim_mode(const char* s){
+    if(!strcmp(s, "three")) return THREE_BEAM;
+    if(!strcmp(s, "two")) return TWO_BEAM;
+    if(!strcmp(s, "z")) return NO_SIM_Z_ONLY;
+    if(!strcmp(s, "single")) return SINGLE_ANGLE;
+    if(!strcmp(s, "seven")) return SEVEN_PHASE;
+    if(!strcmp(s, "sevenfree")) return SEVEN_FREE;
+    return (uint8)strtoul(s, NULL, 0);
+}
+
+static uint8 parse_run_mode(const char* s){
+    if(!strcmp(s, "free")) return FREE_RUN;
+    if(!strcmp(s, "z")) return Z_MODE;
+    if(!strcmp(s, "count")) return COUNT_MODE;
+    if(!strcmp(s, "timed")) return TIMED_MODE;
+    return (uint8)strtoul(s, NULL, 0);
+}
+
+static uint8 parse_stage_hs(const char* s){
+    if(!strcmp(s, "usb")) return STAGE_HS_USB;
+    if(!strcmp(s, "hw")) return STAGE_HS_HW;
+    return (uint8)strtoul(s, NULL, 0);
+}
+
+static uint8 parse_laser(const char* s){
+    if(!strcmp(s, "blue")) return BLUE_LASER;
+    if(!strcmp(s, "green")) return GREEN_LASER;
+    if(!strcmp(s, "both")) return BOTH_LASERS;
+    return (uint8)strtoul(s, NULL, 0);
+}
+
+/* "loop:3,frames:5,stage,next" into progTable, 0 if a step is unknown */
+static uint8 parse_program(const char* s){
+    static const char* const ops[PROG_OP_COUNT] = {"frames", "laser", "stage", "wait", "loop", "next", "end"};
+    uint8 n = 0;
+
+    while(*s){
+        size_t len = strcspn(s, ",:");
+        const char* arg = "";
+        uint8 op;
+
+        for(op = 0; op < PROG_OP_COUNT; op++){
+            if(strlen(ops[op]) == len && !strncmp(s, ops[op], len)){
+                break;
+            }
+        }
+        s += len;
+        if(*s == ':'){
+            arg = ++s;
+            s += strcspn(s, ",");
+        }
+        if(*s == ','){
+            s++;
+        }
+        if(op == PROG_OP_COUNT){
+            return 0;
+        }
+        if(!prog_set_step(n++, op, (uint8)strtoul(arg, NULL, 0))){
+            return 0;
+        }
+    }
+    return n;
+}
+
+/* "0,1,2:300" into the channel table, sel[:BLANKING_DELAY]; 0 if it doesn't fit */
+static uint8 parse_channels(const char* s, uint8 order){
+    uint8 n = 0;
+
+    while(*s){
+        char* end;
+        uint8 sel = (uint8)strtoul(s, &end, 0);
+        uint16 blank = 0;
+
+        if(*end == ':'){
+            blank = (uint16)strtoul(end + 1, &end, 0);
+        }
+        if(!chan_set(n++, sel, blank, order)){
+            return 0;
+        }
+        s = (*end == ',') ? end + 1 : end;
+        if(*end && *end != ','){
+            return 0;
+        }
+    }
+    return n;
+}
+
+/* "0,1,2:80:nosim" into the plane table, pulses[:exposure ms[:nosim]]; 0 if it doesn't fit */
+static uint8 parse_planes(const char* s){
+    uint8 n = 0;
+
+    while(*s){
+        char* end;
+        uint8 pulses = (uint8)strtoul(s, &end, 0);
+        uint32 ticks = 0;
+        uint8 flags = 0;
+
+        if(*end == ':' && strncmp(end, ":nosim", 6)){
+            ticks = secToTicks(strtof(end + 1, &end) / 1000.0f);
+        }
+        if(!strncmp(end, ":nosim", 6)){
+            flags |= PLANE_NO_SIM;
+            end += 6;
+        }
+        if(!plane_set(n++, pulses, flags, ticks)){
+            return 0;
+        }
+        s = (*end == ',') ? end + 1 : end;
+        if(*end && *end != ','){
+            return 0;
+        }
+    }
+    return n;
+}
+
+/* "5:60,6:60:1" into the exposure table, pos:ms[:chan]; 0 if a slot doesn't fit */
+static uint8 parse_expo(const char* s){
+    uint8 n = 0;
+
+    while(*s){
+        char* end;
+        uint8 pos = (uint8)strtoul(s, &end, 0);
+        uint32 ticks;
+        uint8 chan = 0;
+
+        if(*end != ':'){
+            return 0;
+        }
+        ticks = secToTicks(strtof(end + 1, &end) / 1000.0f);
+        if(*end == ':'){
+            chan = (uint8)strtoul(end + 1, &end, 0);
+        }
+        if(!expo_set(pos, chan, ticks)){
+            return 0;
+        }
+        n++;
+        s = (*end == ',') ? end + 1 : end;
+        if(*end && *end != ','){
+            return 0;
+        }
+    }
+    return n;
+}
+
+static uint8 parse_order(const char* s){
+    if(!strcmp(s, "frame")) return CHAN_PER_FRAME;
+    if(!strcmp(s, "phase")) return CHAN_PER_PHASE;
+    if(!strcmp(s, "angle")) return CHAN_PER_ANGLE;
+    if(!strcmp(s, "z")) return CHAN_PER_Z;
+    return (uint8)strtoul(s, NULL, 0);
+}
+
+static uint8 parse_timed_stop(const char* s){
+    if(!strcmp(s, "set")) return TIMED_TO_SET_END;
+    return 0;
+}
+
+static void usage(const char* prog){
+    printf("usage: %s [options]\n"
+           "  --fps F            requested frame rate (default 10)\n"
+           "  --exposure S       user exposure in seconds (SET_EXPOSURE)\n"
+           "  --arb              arbitrary exposure, frame rate follows (ARB_EXP)\n"
+           "  --vert N           camera rows (default %u)\n"
+           "  --sim MODE         three|two|z|single|seven|sevenfree\n"
+           "  --program STEPS    run a sequence program, e.g. loop:3,frames:5,stage,next\n"
+           "                     (laser:N selects channel N)\n"
+           "  --mode MODE        free|z|count|timed (default count)\n"
+           "  --z N              Z steps for z mode\n"
+           "  --planes LIST      plane table for z mode, pulses[:exposure ms[:nosim]] per plane,\n"
+           "                     e.g. 0,1,2:80,2:120:nosim\n"
+           "  --count N          SIM sets for count mode (frameCount)\n"
+           "  --time S           capture time in seconds for timed mode\n"
+           "  --timed-stop S     exact|set, stop at the deadline or at the end of that set\n"
+           "  --timed-clock C    hw|isr, TIME_CNT deadline or time counted by T_ISR (default hw)\n"
+           "  --laser L          blue|green|both\n"
+           "  --channels LIST    channel table, CAM_SEL[:BLANKING_DELAY] per channel, e.g. 1,0,2:300\n"
+           "  --order O          frame|phase|angle|z, channel interleave (default phase)\n"
+           "  --expo LIST        exposure table slots, pos:ms[:chan] each, e.g. 5:60,6:60\n"
+           "  --frames N         frame limit for free run (default 100)\n"
+           "  --isr-latency T    T_ISR entry latency in ticks (default %u)\n"
+           "  --isr-jitter T     extra random T_ISR latency, 0..T ticks\n"
+           "  --sched            run from the precomputed schedule (SCHED_CAPTURE)\n"
+           "  --no-burst         board without burst mode, --sched uses the DMA table\n"
+           "  --isr-stats        print the T_ISR latency / execution histograms\n"
+           "  --host-ticks T     host STAGE_MOVE_COMPLETE round trip (default %u)\n"
+           "  --stage-hs HS      usb|hw, SEVEN_PHASE / program stage handshake (default usb)\n"
+           "  --stage-ticks T    stage move and settle time (default %u)\n"
+           "  --retune-ms T      change the frame rate T ms into the capture (CHANGE_FPS)\n"
+           "  --retune-fps F     frame rate for --retune-ms\n",
+           prog, CAM_VERT_DEFAULT, SIM_ISR_LATENCY_DEFAULT, SIM_HOST_TICKS, SIM_STAGE_TICKS);
+}
+
+int main(int argc, char** argv){
+    static const struct option opts[] = {
+        {"fps", required_argument, 0, 'f'},
+        {"exposure", required_argument, 0, 'e'},
+        {"arb", no_argument, 0, 'a'},
+        {"vert", required_argument, 0, 'v'},
+        {"sim", required_argument, 0, 's'},
+        {"program", required_argument, 0, 'p'},
+        {"mode", required_argument, 0, 'm'},
+        {"z", required_argument, 0, 'z'},
+        {"planes", required_argument, 0, 'P'},
+        {"count", required_argument, 0, 'c'},
+        {"time", required_argument, 0, 't'},
+        {"timed-stop", required_argument, 0, 'T'},
+        {"timed-clock", required_argument, 0, 'K'},
+        {"laser", required_argument, 0, 'l'},
+        {"channels", required_argument, 0, 'C'},
+        {"order", required_argument, 0, 'o'},
+        {"expo", required_argument, 0, 'E'},
+        {"frames", required_argument, 0, 'n'},
+        {"isr-latency", required_argument, 0, 'i'},
+        {"host-ticks", required_argument, 0, 'h'},
+        {"isr-jitter", required_argument, 0, 'j'},
+        {"sched", no_argument, 0, 'S'},
+        {"no-burst", no_argument, 0, 'B'},
+        {"isr-stats", no_argument, 0, 'I'},
+        {"stage-hs", required_argument, 0, 'k'},
+        {"stage-ticks", required_argument, 0, 'w'},
+        {"retune-ms", required_argument, 0, 'R'},
+        {"retune-fps", required_argument, 0, 'F'},
+        {"help", no_argument, 0, 'H'},
+        {0, 0, 0, 0}
+    };
+    float fps = TEN;
+    double user_exposure = 0;
+    uint8 arb = 0;
+    uint8 sim = THREE_BEAM;
+    uint8 run_mode = COUNT_MODE;
+    uint8 timed_stop = 0;
+    uint8 laser = BLUE_LASER;
+    const char* channels = NULL;
+    const char* planes = NULL;
+    const char* expo = NULL;
+    uint8 order = CHAN_PER_PHASE;
+    uint16 steps = 0;
+    uint32 sets = 1;
+    uint64_t max_frames = 100;
+    uint32 host_ticks = SIM_HOST_TICKS;
+    uint32 stage_ticks = SIM_STAGE_TICKS;
+    uint8 stage_hs = STAGE_HS_USB;
+    uint64_t host_due = 0;
+    uint8 finished = 0;
+    uint64_t retune_at = 0;
+    float retune_fps = 0.0f;
+    uint8 retuned = 0;
+    struct timing_verdict verdict;
+    int c;
+
+    sim_reset();
+    while((c = getopt_long(argc, argv, "", opts, NULL)) != -1){
+        switch(c){
+            case 'f': fps = strtof(optarg, NULL); break;
+            case 'e': user_exposure = strtod(optarg, NULL); break;
+            case 'a': arb = ARB_EXP; break;
+            case 'v': vert = (uint16)strtoul(optarg, NULL, 0); break;
+            case 's': sim = parse_sim_mode(optarg); break;
+            case 'p':
+                if(!parse_program(optarg)){
+                    printf("bad program: %s\n", optarg);
+                    return 1;
+                }
+                sim = SIM_PROGRAM;
+                break;
+            case 'm': run_mode = parse_run_mode(optarg); break;
+            case 'z': steps = (uint16)strtoul(optarg, NULL, 0); break;
+            case 'P': planes = optarg; break;
+            case 'c': sets = (uint32)strtoul(optarg, NULL, 0); break;
+            case 't': time_ticks = secToTicks(strtof(optarg, NULL)); break;
+            case 'T': timed_stop = parse_timed_stop(optarg); break;
+            case 'K': sim_set_time_cnt(strcmp(optarg, "isr") != 0); break;
+            case 'l': laser = parse_laser(optarg); break;
+            case 'C': channels = optarg; break;
+            case 'o': order = parse_order(optarg); break;
+            case 'E': expo = optarg; break;
+            case 'n': max_frames = strtoull(optarg, NULL, 0); break;
+            case 'i': sim_set_isr_latency((uint32)strtoul(optarg, NULL, 0)); break;
+            case 'h': host_ticks = (uint32)strtoul(optarg, NULL, 0); break;
+            case 'j': sim_set_isr_jitter((uint32)strtoul(optarg, NULL, 0)); break;
+            case 'S': sched_mode = 1; break;
+            case 'B': sim_set_burst(0); break;
+            case 'I': show_isr_stats = 1; break;
+            case 'k': stage_hs = parse_stage_hs(optarg); break;
+            case 'w': stage_ticks = (uint32)strtoul(optarg, NULL, 0); break;
+            case 'R': retune_at = (uint64_t)(strtod(optarg, NULL) * TICKS_PER_SEC / 1000.0); break;
+            case 'F': retune_fps = strtof(optarg, NULL); break;
+            default: usage(argv[0]); return c == 'H' ? 0 : 1;
+        }
+    }
+
+    /* Power up, as in the USB firmware main() */
+    sim_set_isr(sim_isr);
+    sim_set_time_isr(seq_time_up);
+    sim_set_event_hook(on_event);
+    readTime();
+    setWaitTime();
+    HW_SLM_TRIG_WRITE_PERIOD(SLM_TRG_TICKS);
+    stageWaitTicks = stage_ticks;
+    HW_STAGE_TRIG_WRITE_PERIOD(SIM_STAGE_PULSE);
+    HW_BLANK_TOGGLE_WRITE(BLANK_OFF);
+
+    /* SET_LASER_MODE, SET_SIM_MODE, SET_RUN_MODE, CHANGE_Z_STEPS */
+    laser_conf = laser;
+    chan_set_laser(laser);
+    /* SET_CHANNEL per channel */
+    if(channels && !parse_channels(channels, order)){
+        printf("bad channel table: %s\n", channels);
+        return 1;
+    }
+    if(!channels && chanCount > 1u){
+        chanOrder = order;
+    }
+    /* SET_EXPO_SLOT per slot */
+    if(expo && !parse_expo(expo)){
+        printf("bad exposure table: %s\n", expo);
+        return 1;
+    }
+    setBlankingDelay();
+    seq_set_sim_mode(sim);
+    if(sim == SIM_PROGRAM && simMode != SIM_PROGRAM){
+        printf("program rejected by prog_check()\n");
+        return 1;
+    }
+    seq_set_run_mode(run_mode | timed_stop);
+    /* SET_STAGE_HANDSHAKE, STAGE_READY_ISR */
+    if(seq_set_stage_handshake(stage_hs) == STAGE_HS_HW){
+        sim_set_stage_isr(seq_stage_ready);
+    }
+    frameCount = sets;
+    zSteps = steps;
+    /* SET_PLANE per plane, after CHANGE_Z_STEPS */
+    if(planes && !parse_planes(planes)){
+        printf("bad plane table: %s\n", planes);
+        return 1;
+    }
+
+    /* CHANGE_FPS */
+    if(fps > 0.0f){
+        fps_in = fps;
+        frameTicks = fpsToTicks(fps_in);
+    }
+    setExposure();
+
+    /* SET_EXPOSURE */
+    if(user_exposure > 0){
+        exposure = user_exposure;
+        userSetExposure(arb);
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&ts, 0, sizeof(ts));
+    ts_init();
+    isr_stats_reset();
+    /* START_CAPTURE | SCHED_CAPTURE, refused as the firmware does */
+    if(seq_check_timing(&verdict)){
+        print_check(&verdict);
+        return 1;
+    }
+    stats.capture_start = sim_now();
+    if(simMode == SIM_PROGRAM){
+        frames_per_set = prog_check(progTable, progLen, chanCount);
+    }
+    if(sched_mode && sched_compile()){
+        if(simMode != SIM_PROGRAM){
+            uint8 n = (chanOrder == CHAN_PER_FRAME) ? 1u : chanCount;
+
+            frames_per_set = (uint64_t)n * phase_max + 1u;
+        }
+        sched_start();
+    } else {
+        sched_mode = 0;
+        if(!seq_start()){
+            printf("seq_start: refused\n");
+            return 1;
+        }
+    }
+
+    while(!finished && sim_now() < SIM_TIMEOUT_TICKS){
+        uint8 events;
+
+        sim_advance(SIM_SLICE_TICKS);
+        drain_ts();
+        events = seq_take_events() | sched_poll();
+        if(events & STAGE_REQ){
+            /* SEND_TRIGG to the host, stage move, STAGE_MOVE_COMPLETE back */
+            host_due = sim_now() + host_ticks + SIM_STAGE_PULSE + stage_ticks;
+        }
+        if(retune_at && retune_fps > 0.0f && sim_now() >= retune_at){
+            /* CHANGE_FPS while the capture runs */
+            retune_at = 0;
+            retuned = 1;
+            fps_in = retune_fps;
+            frameTicks = fpsToTicks(fps_in);
+            setExposure();
+        }
+        if(host_due && sim_now() >= host_due){
+            host_due = 0;
+            seq_stage_move_complete();
+        }
+        if(events & TIMED_FIN){
+            /* TIME_CNT gated a timed schedule off */
+            sched_stop();
+        }
+        if(events & (Z_FIN|COUNT_FIN|TIMED_FIN)){
+            finished = 1;
+        }
+        if(mode == FREE_RUN && stats.frames >= max_frames){
+            sched_stop();
+            seq_stop();
+            finished = 1;
+        }
+    }
+    /* Let the frame in flight complete */
+    while(sim_chain_busy() && sim_now() < SIM_TIMEOUT_TICKS){
+        sim_advance(SIM_SLICE_TICKS);
+    }
+    drain_ts();
+
+    printf("camera: %s\n", CAM_NAME);
+    printf("requested_fps: %.3f\n", fps);
+    printf("applied_fps: %.3f\n", fps_in);
+    printf("frame_limit: %s\n", limitName(frameLimit));
+    printf("frame_ticks: %u\n", frameTicks);
+    printf("exposure_ticks: %u\n", exposureTicks);
+    printf("wait_time_ticks: %u\n", wait_time_ticks);
+    print_check(&verdict);
+    printf("trigger_path: %s\n", !sched_mode ? "t_isr" : sched_burst ? "burst" : "sched_dma");
+    printf("frames: %llu\n", (unsigned long long)stats.frames);
+    if(stats.frames > 1){
+        uint64_t n = stats.frames - 1;
+        printf("frame_period_us: min %.1f mean %.1f max %.1f\n",
+               TICKS_TO_US(stats.period_min), TICKS_TO_US((double)stats.period_sum / n),
+               TICKS_TO_US(stats.period_max));
+        printf("dead_time_us: min %.1f mean %.1f max %.1f\n",
+               TICKS_TO_US(stats.dead_min), TICKS_TO_US((double)stats.dead_sum / n),
+               TICKS_TO_US(stats.dead_max));
+        printf("achieved_fps: %.3f\n", 1e6 / TICKS_TO_US((double)stats.period_sum / n));
+        if(expoActive){
+            printf("exposure_us: min %.1f mean %.1f max %.1f\n", TICKS_TO_US(stats.exposure_min),
+                   TICKS_TO_US((double)stats.exposure_sum / stats.frames), TICKS_TO_US(stats.exposure_max));
+        }
+        printf("duty_cycle: %.3f\n", (double)stats.exposure_sum / (double)(stats.last_end - stats.first_start));
+    }
+    if(stats.sets){
+        printf("sets: %llu\n", (unsigned long long)stats.sets);
+        printf("set_duration_ms: %.3f\n", TICKS_TO_US((double)stats.set_sum / stats.sets) / 1000.0);
+    }
+    if(retuned){
+        /* A frame timed partly by the old and partly by the new periods */
+        printf("retune_torn_frames: %llu\n", (unsigned long long)torn_frames(stats.period_last));
+    }
+    if(mode == TIMED_MODE){
+        printf("timed_clock: %s\n", HW_TIME_CNT_AVAILABLE ? "time_cnt" : "t_isr");
+        printf("timed_stop: %s\n", timedStop == TIMED_STOP_SET ? "set" : "exact");
+        printf("timed_deadline_ms: %.3f\n", TICKS_TO_US(time_ticks) / 1000.0);
+        printf("timed_last_end_ms: %.3f\n", TICKS_TO_US(stats.last_end - stats.capture_start) / 1000.0);
+        printf("timed_frames_after_deadline: %llu\n", (unsigned long long)stats.timed_after);
+    }
+    printf("stage_pulses: %llu\n", (unsigned long long)stats.stage_pulses);
+    if(stats.planes){
+        printf("stage_handshake: %s\n", stageHandshake == STAGE_HS_HW ? "hw" : "usb");
+        printf("plane_gap_us: min %.1f mean %.1f max %.1f\n",
+               TICKS_TO_US(stats.plane_min), TICKS_TO_US((double)stats.plane_sum / stats.planes),
+               TICKS_TO_US(stats.plane_max));
+        /* What the handshake adds on top of the stage itself */
+        printf("plane_overhead_us: %.1f\n",
+               TICKS_TO_US((double)stats.plane_sum / stats.planes - (SIM_STAGE_PULSE + stage_ticks)));
+    }
+    if(seq_plane_table()){
+        uint8 i;
+
+        printf("z_planes: %u\n", planeCount);
+        for(i = 0; i < planeCount; i++){
+            printf("plane%u: pulses %u exposure_us %.1f frames %u%s\n", i, planeTable[i].pulses,
+                   TICKS_TO_US(stats.plane_exposure[i]), stats.plane_frames[i],
+                   (planeTable[i].flags & PLANE_NO_SIM) ? " nosim" : "");
+        }
+    }
+    printf("ts_frames: %u\n", ts.frames);
+    if(ts.frames > 1){
+        printf("ts_frame_interval_us: min %.1f mean %.1f max %.1f\n",
+               TICKS_TO_US(ts.interval_min), TICKS_TO_US((double)ts.interval_sum / (ts.frames - 1u)),
+               TICKS_TO_US(ts.interval_max));
+    }
+    if(chanCount > 1u && ts.frames){
+        uint8 i;
+
+        printf("channels: %u\n", chanCount);
+        for(i = 0; i < chanCount; i++){
+            printf("ts_frames_chan%u: %u (sel %u, blanking %u)\n", i, ts.chan_frames[i],
+                   chanTable[i].sel, chanBlankDelay(i));
+        }
+    }
+    printf("ts_stage_pulses: %u\n", ts.stages);
+    printf("ts_dropped: %u\n", ts.dropped);
+    {
+        /* What the status packet reports */
+        struct frame_counts fc;
+
+        frames_read(&fc);
+        printf("status_counts: triggers %u slm %u stage %u\n", fc.triggers, fc.slm, fc.stage);
+        printf("status_late_frames: %u skipped %u late_max_us %.1f\n", fc.late, fc.skipped,
+               TICKS_TO_US(fc.lateMax));
+    }
+    if(show_isr_stats){
+        struct isr_stats_packet h;
+
+        isr_stats_fill(&h);
+        printf("isr_calls: %u\n", h.calls);
+        printf("isr_latency_ticks_max: %u\n", h.latency_max);
+        print_hist("isr_latency_log2_hist", h.latency);
+        printf("isr_exec_cycles_max: %u\n", h.exec_max);
+        print_hist("isr_exec_log2_hist", h.exec);
+    }
+    printf("acquisition_ms: %.3f\n", TICKS_TO_US(stats.last_end - stats.first_start) / 1000.0);
+    return finished ? 0 : 2;
+}
+
+/* [] END OF FILE */
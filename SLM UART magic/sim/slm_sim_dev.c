@@ -0,0 +1,281 @@
+/*******************************************************************************
+* File Name: slm_sim_dev.c
+*
+* Description:
+*   USB firmware main loop on the simulator, see slm_sim_dev.h.  Keep the
+*   handlers in step with apply_command() in the USB project.
+*
+*******************************************************************************/
+
+#include "slm_sim_dev.h"
+#include "slm_seq.h"
+#include "slm_timing.h"
+#include "slm_sched.h"
+#include "slm_ts.h"
+#include "slm_isr_stats.h"
+#include "slm_usb.h"
+#include "slm_trace.h"
+#include "slm_chan.h"
+#include "slm_plane.h"
+#include "slm_lcd.h"
+#include "slm_fmt.h"
+
+#define BLANK_ON (0u)
+#define BLANK_OFF (1u)
+#define TRIGG_ON "Trig: ON "
+#define TRIGG_OFF "Trig: OFF"
+#define TRIGG_BAD "Trig: BAD"
+
+static uint32 applied;
+static char line0[32];
+
+static void dev_isr(void){
+    uint32 start = isr_stats_enter();
+
+    seq_frame_done();
+    isr_stats_exit(start);
+}
+
+static void report_timing(void){
+    if(timingMsg & FPS_CHANGED){
+        outgoing.fps = fps_in;
+        outgoing.mode = frameLimit;
+        outgoing.flags |= CHANGE_FPS;
+    }
+    if(timingMsg & EXP_CHANGED){
+        outgoing.exposure = exposure;
+        outgoing.flags |= SET_EXPOSURE;
+    }
+    timingMsg = 0;
+}
+
+static void set_laser_mode(uint8 laser_mode){
+    if(!chan_set_laser(laser_mode)){
+        return;
+    }
+    laser_conf = laser_mode;
+    setBlankingDelay();
+    setExposure();
+}
+
+static void apply_command(void){
+    struct timing_verdict verdict;
+    char* p;
+
+    applied++;
+    if(incoming.flags & STAGE_MOVE_COMPLETE){
+        seq_stage_move_complete();
+    }
+    if(incoming.flags & SET_STAGE_HANDSHAKE){
+        outgoing.bonus = seq_set_stage_handshake(incoming.mode);
+    }
+    if(incoming.flags & TRACE_CAPTURE){
+        if(incoming.mode){
+            trace_start();
+        } else {
+            trace_stop();
+        }
+    }
+    if(incoming.flags & SET_STATUS_RATE){
+        usb_set_status_period(incoming.count, incoming.mode);
+    }
+    if(incoming.flags & PROGRAM_STEP){
+        outgoing.bonus = seq_set_prog_step((uint8)incoming.steps, incoming.mode, incoming.bonus);
+    }
+    if(incoming.flags & SET_CHANNEL){
+        outgoing.bonus = seq_set_chan((uint8)incoming.steps, incoming.mode,
+                                      (uint16)incoming.count, incoming.bonus);
+        setBlankingDelay();
+        setExposure();
+    }
+    if(incoming.flags & SET_PLANE){
+        outgoing.bonus = seq_set_plane((uint8)incoming.steps, incoming.mode,
+                                       incoming.bonus, incoming.count);
+    }
+    if(incoming.flags & SET_EXPO_SLOT){
+        outgoing.bonus = seq_set_expo((uint8)incoming.steps, incoming.mode, incoming.count);
+    }
+    if(incoming.flags & CHANGE_FPS){
+        outgoing.fps = incoming.fps;
+        if(incoming.fps > 0.0f){
+            fps_in = incoming.fps;
+            frameTicks = fpsToTicks(fps_in);
+        } else {
+            outgoing.fps = fps_in;
+            outgoing.mode = frameLimit;
+            outgoing.flags |= CHANGE_FPS;
+        }
+        setExposure();
+        fmt_fps(fmt_str(line0, "FPS: "), frameTicks, 1u);
+        lcd_print(0u, 11u, line0);
+    }
+    if(incoming.flags & CHANGE_Z_STEPS){
+        outgoing.steps = incoming.steps;
+        zSteps = incoming.steps;
+        plane_clear();
+    }
+    if(incoming.flags & SET_READOUT_SPEED){
+        capMode = (incoming.flags & SLOW_READOUT) ? CAP_MODE_SLOW : CAP_MODE_NORMAL;
+        setBlankingDelay();
+        setExposure();
+    }
+    if(incoming.flags & SET_RUN_MODE){
+        seq_set_run_mode(incoming.mode);
+        if(mode == FREE_RUN){
+            p = fmt_str(line0, "Mode: Free FPS: ");
+        } else if(mode == Z_MODE){
+            p = fmt_str(line0, "Mode: Z-St FPS: ");
+        } else if(mode == TIMED_MODE){
+            time_ticks = incoming.count;
+            p = fmt_str(line0, "Mode: Timed FPS: ");
+        } else {
+            frameCount = incoming.count;
+            p = fmt_str(line0, "Mode: Count FPS: ");
+        }
+        fmt_fps(p, frameTicks, 1u);
+        lcd_print(0u, 0u, line0);
+    }
+    if(incoming.flags & START_CAPTURE){
+        outgoing.bonus = seq_check_timing(&verdict);
+        if(outgoing.bonus){
+            lcd_print(1u, 0u, TRIGG_BAD);
+        } else if((incoming.flags & SCHED_CAPTURE) && !HW_ENBL_TRIG_ISR_READ()
+            && !sched_running && sched_compile()){
+            sched_start();
+            lcd_print(1u, 0u, TRIGG_ON);
+        } else if(seq_start()){
+            lcd_print(1u, 0u, TRIGG_ON);
+        } else {
+            outgoing.bonus = SEQ_REFUSED;
+            lcd_print(1u, 0u, TRIGG_BAD);
+        }
+    }
+    if(incoming.flags & STOP_CAPTURE){
+        sched_stop();
+        seq_stop();
+        lcd_print(1u, 0u, TRIGG_OFF);
+    }
+    if(incoming.flags & TOGGLE_BLANKING){
+        HW_BLANK_TOGGLE_WRITE((incoming.mode & START_BLANKING) ? BLANK_ON : BLANK_OFF);
+        lcd_print(1u, 10u, (incoming.mode & START_BLANKING) ? "Blank: On " : "Blank: Off");
+    }
+    if(incoming.flags & SET_SIM_MODE){
+        seq_set_sim_mode(incoming.mode);
+    }
+    if(incoming.flags & SET_EXPOSURE){
+        if(incoming.exposure > 0.0f){
+            exposure = incoming.exposure;
+            userSetExposure(incoming.mode & ARB_EXP);
+        } else {
+            outgoing.exposure = exposure;
+            outgoing.flags |= SET_EXPOSURE;
+        }
+    }
+    if(incoming.flags & SET_LASER_MODE){
+        set_laser_mode(incoming.mode);
+    }
+    if(incoming.flags & READ_ISR_STATS){
+        usb_queue_isr_stats();
+    }
+    if(incoming.flags & RESET_ISR_STATS){
+        isr_stats_reset();
+    }
+    incoming.flags = 0;
+    report_timing();
+}
+
+/* main() up to the for(;;), with the enumeration wait already over */
+void sim_dev_init(void){
+    sim_reset();
+    sim_set_isr(dev_isr);
+    sim_set_stage_isr(seq_stage_ready);
+    sim_set_time_isr(seq_time_up);
+    incoming.flags = outgoing.flags = 0;
+    incoming.fps = outgoing.fps = SIM_DEV_FPS;
+    outgoing.count = 0;
+    outgoing.exposure = exposure;
+    applied = 0;
+    trace_stop();
+    lcd_init();
+    ts_init();
+    isr_stats_reset();
+    usb_link_init();
+    readTime();
+    setWaitTime();
+    HW_SLM_TRIG_WRITE_PERIOD(SLM_TRG_TICKS);
+    setBlankingDelay();
+    stageWaitTicks = STAGE_SETTLE_TICKS;
+    HW_STAGE_TRIG_WRITE_PERIOD(STAGE_PULSE_TICKS);
+    HW_BLANK_TOGGLE_WRITE(BLANK_OFF);
+    lcd_print(0u, 0u, "Mode: Count");
+    lcd_print(0u, 11u, "FPS: 5.0");
+    lcd_print(1u, 0u, TRIGG_OFF);
+    lcd_print(1u, 10u, "Blank: Off");
+    setExposure();
+    report_timing();
+}
+
+/* One pass of the for(;;) */
+void sim_dev_pass(void){
+    struct usb_cmd cmd;
+    uint8 rx = usb_link_poll_out();
+    uint8 events;
+
+    if(rx == USB_RX_LEGACY){
+        apply_command();
+    } else if(rx == USB_RX_BATCH){
+        while(usb_cmd_next(&cmd)){
+            uint8 status = usb_cmd_load(&cmd, &incoming);
+
+            if(status == CMD_OK){
+                apply_command();
+            }
+            usb_cmd_ack(cmd.seq, status);
+        }
+    }
+    if(rx != USB_RX_NONE){
+        usb_link_trace_out();
+        trace_state();
+    }
+    events = seq_take_events() | sched_poll();
+    if(events & STAGE_REQ){
+        outgoing.flags |= SEND_TRIGG;
+    }
+    if(events & Z_FIN){
+        outgoing.flags |= STOP_Z_STACK;
+    }
+    if(events & (COUNT_FIN | TIMED_FIN)){
+        outgoing.flags |= STOP_COUNT;
+    }
+    if(events & TIMED_FIN){
+        sched_stop();
+    }
+    usb_link_poll_in();
+    if(rx == USB_RX_NONE && !events){
+        lcd_task();
+    }
+}
+
+/* Main loop passes every SIM_DEV_LOOP_TICKS plus the LCD accesses the pass
+*  busy-waited on, the chain model in between
+*/
+void sim_dev_run(uint64_t ticks){
+    uint64_t end = sim_now() + ticks;
+
+    while(sim_now() < end){
+        uint64_t left = end - sim_now();
+
+        uint64_t pass;
+
+        sim_dev_pass();
+        pass = SIM_DEV_LOOP_TICKS + sim_lcd_take_busy();
+        sim_advance(left < pass ? left : pass);
+    }
+}
+
+/* Commands applied since sim_dev_init(), legacy packets and batch records */
+uint32 sim_dev_commands(void){
+    return applied;
+}
+
+/* [] END OF FILE */
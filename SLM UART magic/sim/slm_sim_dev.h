@@ -0,0 +1,36 @@
+/*******************************************************************************
+* File Name: slm_sim_dev.h
+*
+* Description:
+*   The USB firmware (USB SLM_ANDOR_Fusion.cydsn/main.c) as a device model:
+*   the same power up, command handlers and event reporting on top of the
+*   counter chain, endpoint and LCD models, without the message text.
+*   A host side client drives it through sim_usb_host_write() /
+*   sim_usb_host_read() while sim_dev_run() moves time on.
+*
+*******************************************************************************/
+
+#ifndef SLM_SIM_DEV_H
+#define SLM_SIM_DEV_H
+
+#include "slm_sim_hw.h"
+
+#define SIM_DEV_LOOP_TICKS (20u)    // one pass of the main loop, 10us
+#define SIM_DEV_FPS (5.0f)          // DEFAULT_FPS of the firmware
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sim_dev_init(void);
+void sim_dev_pass(void);
+void sim_dev_run(uint64_t ticks);
+uint32 sim_dev_commands(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLM_SIM_DEV_H */
+
+/* [] END OF FILE */
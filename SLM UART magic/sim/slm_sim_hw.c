@@ -0,0 +1,490 @@
+/*******************************************************************************
+* File Name: slm_sim_hw.c
+*
+* Description:
+*   Event driven model of the trigger hardware at 2MHz tick resolution.  See
+*   slm_sim_hw.h for the modelled behaviour.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "slm_sched.h"
+
+static uint32 period[SIM_COUNTERS];
+static uint32 remain[SIM_COUNTERS];
+static uint8 running[SIM_COUNTERS];
+static uint8 regs[SIM_REGS];
+static uint64_t now;
+static uint8 irq_pending;
+static uint64_t irq_tick;
+static uint8 start_held;
+static uint8 stage_irq_pending;
+static uint64_t stage_irq_tick;
+static uint32 isr_latency = SIM_ISR_LATENCY_DEFAULT;
+static uint32 isr_jitter = 0;
+static uint32 isr_delay = SIM_ISR_LATENCY_DEFAULT;
+static uint32 jitter_seed = 1;
+static const uint8* sched_tab;
+static uint16 sched_n;
+static uint16 sched_idx;
+static uint8 sched_loop;
+static uint8 sched_armed;
+static const uint32* expo_tab;
+static uint16 expo_n;
+static uint16 expo_idx;
+static uint8 burst_present = 1;
+static uint8 burst_run;
+static uint32 burst_left;       // frames to go, 0 with burst_run: until stopped
+static uint8 dma_pending;
+static uint64_t dma_tick;
+static uint32 cycles;
+static uint32 edges[SIM_CNTS];
+static uint8 time_present = 1;
+static uint8 time_gate;
+static uint8 time_up;
+static uint8 time_irq_pending;
+static uint64_t time_irq_tick;
+static void (*isr_fn)(void);
+static void (*stage_isr_fn)(void);
+static void (*time_isr_fn)(void);
+static void (*event_hook)(uint8 event, uint64_t tick);
+
+static void emit(uint8 event){
+    if(event_hook){
+        event_hook(event, now);
+    }
+}
+
+static void counter_start(uint8 id){
+    running[id] = 1;
+    remain[id] = period[id];
+}
+
+static uint8 stage_busy(void){
+    return running[SIM_STAGE_TRIG] || running[SIM_STAGE_WAIT];
+}
+
+static void chain_stop(void){
+    running[SIM_TRG_CNT] = 0;
+    running[SIM_SLM_WAIT] = 0;
+    running[SIM_SLM_TRIG] = 0;
+    running[SIM_BLANKING_DELAY] = 0;
+}
+
+static void chain_go(void){
+    if(time_up){
+        /* TIME_UP latch, TIMED_STOP_EXACT */
+        return;
+    }
+    if(stage_busy()){
+        start_held = 1;
+        return;
+    }
+    chain_stop();
+    counter_start(SIM_TRG_CNT);
+    counter_start(SIM_BLANKING_DELAY);
+    edges[SIM_CNT_CAM]++;
+    emit(SIM_EV_EXPOSE_START);
+}
+
+static void chain_start(void){
+    if(regs[SIM_ENBL_TRIG_ISR]){
+        chain_go();
+    }
+}
+
+/* Extra ISR entry delay, e.g. T_ISR waiting behind a USBFS interrupt */
+static uint32 next_jitter(void){
+    if(!isr_jitter){
+        return 0;
+    }
+    jitter_seed = jitter_seed * 1103515245u + 12345u;
+    return (jitter_seed >> 16) % (isr_jitter + 1u);
+}
+
+static void start_stage(void){
+    counter_start(SIM_STAGE_TRIG);
+    edges[SIM_CNT_STAGE]++;
+    emit(SIM_EV_STAGE_PULSE);
+}
+
+static void sched_write(void){
+    uint8 entry = sched_tab[sched_idx++];
+
+    if(expo_n){
+        period[SIM_TRG_CNT] = expo_tab[expo_idx++];
+        if(expo_idx >= expo_n){
+            expo_idx = 0;
+        }
+    }
+
+    regs[SIM_CAM_SEL_REG] = entry & SCHED_ROUTE_MASK;
+    emit(SIM_EV_SCHED_WRITE);
+    if(entry & SCHED_STAGE){
+        start_stage();
+    }
+    if(entry & SCHED_NEXT){
+        chain_go();
+    }
+    if(sched_idx >= sched_n){
+        sched_idx = 0;
+        sched_armed = sched_loop;
+    }
+}
+
+static void terminal_count(uint8 id){
+    running[id] = 0;
+    switch(id){
+        case SIM_TRG_CNT:
+            emit(SIM_EV_EXPOSE_END);
+            running[SIM_BLANKING_DELAY] = 0;
+            counter_start(SIM_SLM_WAIT);
+            break;
+        case SIM_BLANKING_DELAY:
+            emit(SIM_EV_LASER_ON);
+            break;
+        case SIM_SLM_WAIT:
+            counter_start(SIM_SLM_TRIG);
+            edges[SIM_CNT_SLM]++;
+            emit(SIM_EV_SLM_TRIG);
+            break;
+        case SIM_SLM_TRIG:
+            emit(SIM_EV_CHAIN_END);
+            if(burst_run){
+                if(burst_left && --burst_left == 0){
+                    burst_run = 0;
+                } else {
+                    chain_go();
+                }
+            }
+            if(sched_armed){
+                dma_pending = 1;
+                dma_tick = now;
+            }
+            if(regs[SIM_ENBL_TRIG_ISR]){
+                irq_pending = 1;
+                irq_tick = now;
+                isr_delay = isr_latency + next_jitter();
+            }
+            break;
+        case SIM_STAGE_TRIG:
+            counter_start(SIM_STAGE_WAIT);
+            break;
+        case SIM_TIME_CNT:
+            emit(SIM_EV_TIME_UP);
+            time_up = time_gate;
+            if(time_isr_fn){
+                time_irq_pending = 1;
+                time_irq_tick = now;
+            }
+            break;
+        case SIM_STAGE_WAIT:
+            emit(SIM_EV_STAGE_READY);
+            if(stage_isr_fn){
+                stage_irq_pending = 1;
+                stage_irq_tick = now;
+            }
+            if(start_held){
+                start_held = 0;
+                chain_go();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void sim_write_period(uint8 counter, uint32 p){
+    cycles += SIM_ACCESS_CYCLES;
+    period[counter] = p;
+}
+
+uint32 sim_read_period(uint8 counter){
+    return period[counter];
+}
+
+void sim_reg_write(uint8 reg, uint8 val){
+    uint8 old = regs[reg];
+    regs[reg] = val;
+    cycles += SIM_ACCESS_CYCLES;
+
+    switch(reg){
+        case SIM_ENBL_TRIG_ISR:
+            if(!old && val && !sim_chain_busy()){
+                chain_start();
+            } else if(!val){
+                start_held = 0;
+            }
+            break;
+        case SIM_TRIG_CNT_RST:
+            if(!old && val){
+                chain_stop();
+                chain_start();
+            }
+            break;
+        case SIM_STAGE_REG:
+            if(!old && val){
+                start_stage();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+uint8 sim_reg_read(uint8 reg){
+    cycles += SIM_ACCESS_CYCLES;
+    return regs[reg];
+}
+
+void sim_set_time_cnt(uint8 present){
+    time_present = present;
+}
+
+uint8 sim_time_cnt(void){
+    return time_present;
+}
+
+/* hw_time_start(): TIME_REG off, period, TIME_REG on */
+void sim_time_start(uint32 ticks, uint8 gate){
+    if(!time_present){
+        return;
+    }
+    cycles += 3u * SIM_ACCESS_CYCLES;
+    period[SIM_TIME_CNT] = ticks;
+    time_gate = gate;
+    time_up = 0;
+    time_irq_pending = 0;
+    counter_start(SIM_TIME_CNT);
+}
+
+void sim_time_stop(void){
+    if(!time_present){
+        return;
+    }
+    cycles += SIM_ACCESS_CYCLES;
+    running[SIM_TIME_CNT] = 0;
+    time_up = 0;
+    time_irq_pending = 0;
+}
+
+uint32 sim_cnt_read(uint8 cnt){
+    cycles += SIM_ACCESS_CYCLES;
+    return edges[cnt];
+}
+
+void sim_isr_clear_pending(void){
+    irq_pending = 0;
+}
+
+void sim_reset(void){
+    memset(period, 0, sizeof(period));
+    memset(remain, 0, sizeof(remain));
+    memset(running, 0, sizeof(running));
+    memset(regs, 0, sizeof(regs));
+    memset(edges, 0, sizeof(edges));
+    now = 0;
+    cycles = 0;
+    irq_pending = 0;
+    irq_tick = 0;
+    start_held = 0;
+    stage_irq_pending = 0;
+    time_gate = 0;
+    time_up = 0;
+    time_irq_pending = 0;
+    sched_armed = 0;
+    dma_pending = 0;
+    expo_n = 0;
+    burst_run = 0;
+    sim_usb_reset();
+    sim_lcd_reset();
+}
+
+void sim_set_isr(void (*isr)(void)){
+    isr_fn = isr;
+}
+
+void sim_set_stage_isr(void (*isr)(void)){
+    stage_isr_fn = isr;
+}
+
+void sim_set_time_isr(void (*isr)(void)){
+    time_isr_fn = isr;
+}
+
+void sim_set_isr_latency(uint32 ticks){
+    isr_latency = ticks;
+}
+
+void sim_set_isr_jitter(uint32 ticks){
+    isr_jitter = ticks;
+}
+
+void sim_set_event_hook(void (*hook)(uint8 event, uint64_t tick)){
+    event_hook = hook;
+}
+
+uint64_t sim_now(void){
+    return now;
+}
+
+/* In T_ISR: ticks since the SLM_TRIG terminal count that raised it */
+uint32 sim_isr_latency(void){
+    return (uint32)(now - irq_tick);
+}
+
+/* Register access cost so far, see SIM_ACCESS_CYCLES */
+uint32 sim_cycles(void){
+    return cycles;
+}
+
+uint8 sim_chain_busy(void){
+    return running[SIM_TRG_CNT] || running[SIM_SLM_WAIT] || running[SIM_SLM_TRIG]
+        || start_held || irq_pending || stage_irq_pending || time_irq_pending || dma_pending;
+}
+
+/* Entry 0 goes out immediately, as the CPU request in hw_sched_arm() */
+void sim_sched_arm(const uint8* table, uint16 len, uint8 cyclic){
+    sched_tab = table;
+    sched_n = len;
+    sched_idx = 0;
+    sched_loop = cyclic;
+    sched_armed = 1;
+    dma_pending = 0;
+    sched_write();
+}
+
+void sim_sched_disarm(void){
+    sched_armed = 0;
+    dma_pending = 0;
+}
+
+/* Cyclic, entry 0 goes out with the next SCHED_REG write, which is the
+*  CPU request of sim_sched_arm() when armed first as sched_start() does
+*/
+void sim_expo_arm(const uint32* table, uint16 len){
+    expo_tab = table;
+    expo_n = len;
+    expo_idx = 0;
+}
+
+void sim_expo_disarm(void){
+    expo_n = 0;
+}
+
+void sim_set_burst(uint8 present){
+    burst_present = present;
+}
+
+uint8 sim_burst(void){
+    return burst_present;
+}
+
+/* hw_burst_start(): BURST_REG off, BURST_CNT, BURST_REG run | go */
+void sim_burst_start(uint32 frames){
+    cycles += 4u * SIM_ACCESS_CYCLES;
+    burst_left = frames;
+    burst_run = 1;
+    chain_go();
+}
+
+void sim_burst_stop(void){
+    cycles += SIM_ACCESS_CYCLES;
+    burst_run = 0;
+}
+
+uint8 sim_burst_busy(void){
+    return burst_run;
+}
+
+uint8 sim_sched_busy(void){
+    return sched_armed || dma_pending;
+}
+
+/*******************************************************************************
+* Function Name: sim_advance
+********************************************************************************
+*
+* Summary:
+*  Runs the model for the given number of ticks, jumping from one terminal
+*  count / interrupt to the next instead of stepping every tick.
+*
+*******************************************************************************/
+void sim_advance(uint64_t ticks){
+    uint64_t end = now + ticks;
+
+    for(;;){
+        uint8 id;
+        uint8 fired = 1;
+
+        /* Terminal counts due now, including zero length periods */
+        while(fired){
+            fired = 0;
+            for(id = 0; id < SIM_COUNTERS; id++){
+                if(running[id] && remain[id] == 0){
+                    terminal_count(id);
+                    fired = 1;
+                }
+            }
+        }
+
+        if(dma_pending && now >= dma_tick + SIM_DMA_LATENCY){
+            dma_pending = 0;
+            if(sched_armed){
+                sched_write();
+            }
+            continue;
+        }
+
+        if(irq_pending && isr_fn && now >= irq_tick + isr_delay){
+            irq_pending = 0;
+            emit(SIM_EV_ISR_ENTRY);
+            isr_fn();
+            continue;
+        }
+
+        if(stage_irq_pending && now >= stage_irq_tick + isr_latency){
+            stage_irq_pending = 0;
+            stage_isr_fn();
+            continue;
+        }
+
+        if(time_irq_pending && now >= time_irq_tick + isr_latency){
+            time_irq_pending = 0;
+            time_isr_fn();
+            continue;
+        }
+
+        if(now >= end){
+            break;
+        }
+
+        uint64_t next = end;
+        for(id = 0; id < SIM_COUNTERS; id++){
+            if(running[id] && now + remain[id] < next){
+                next = now + remain[id];
+            }
+        }
+        if(irq_pending && isr_fn && irq_tick + isr_delay < next){
+            next = irq_tick + isr_delay;
+        }
+        if(stage_irq_pending && stage_irq_tick + isr_latency < next){
+            next = stage_irq_tick + isr_latency;
+        }
+        if(time_irq_pending && time_irq_tick + isr_latency < next){
+            next = time_irq_tick + isr_latency;
+        }
+        if(dma_pending && dma_tick + SIM_DMA_LATENCY < next){
+            next = dma_tick + SIM_DMA_LATENCY;
+        }
+
+        for(id = 0; id < SIM_COUNTERS; id++){
+            if(running[id]){
+                remain[id] -= (uint32)(next - now);
+            }
+        }
+        now = next;
+    }
+}
+
+/* [] END OF FILE */
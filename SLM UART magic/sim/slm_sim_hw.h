@@ -0,0 +1,253 @@
+/*******************************************************************************
+* File Name: slm_sim_hw.h
+*
+* Description:
+*   Workstation stand-in for the PSoC trigger hardware.  Provides the HW_*
+*   register layer used by common/ plus a 2MHz tick model of the
+*   TRG_CNT -> SLM_WAIT -> SLM_TRIG counter chain, BLANKING_DELAY and the
+*   STAGE_TRIG -> STAGE_WAIT stage pulse.
+*
+*   Model of one frame (all periods in 2MHz ticks):
+*     start     TRG_CNT runs exposureTicks (camera trigger high),
+*               BLANKING_DELAY runs alongside and opens the laser at its TC
+*     TRG_CNT   TC starts SLM_WAIT (camera readout + SLM reload)
+*     SLM_WAIT  TC starts SLM_TRIG (SLM trigger pulse)
+*     SLM_TRIG  TC ends the chain; TRIG_ISR is raised if ENBL_TRIG_ISR is set
+*   The chain is (re)started by a TRIG_CNT_RST pulse or a rising edge on
+*   ENBL_TRIG_ISR, but only while ENBL_TRIG_ISR is set and the stage is not
+*   busy.  A STAGE_REG pulse runs STAGE_TRIG then STAGE_WAIT; a start request
+*   arriving meanwhile is held until STAGE_WAIT expires.
+*
+*   The stage controller is STAGE_TRIG (step pulse) plus STAGE_WAIT (move
+*   and settle), so its STAGE_READY output rises at the STAGE_WAIT terminal
+*   count.  An isr installed with sim_set_stage_isr() runs isr latency ticks
+*   after that edge, as STAGE_READY_ISR does with SLM_STAGE_READY=1.
+*
+*   TIME_CNT is a one shot down counter started by sim_time_start().  At its
+*   terminal count the TIME_UP latch blocks every chain start if the gate
+*   was asked for, and an isr installed with sim_set_time_isr() runs isr
+*   latency ticks later, as TIME_ISR does with SLM_TIME_CNT=1.
+*   sim_set_time_cnt(0) builds the board without it, HW_TIME_CNT_AVAILABLE
+*   then reads 0 and the sequencer keeps time in T_ISR.
+*
+*   The schedule DMA (common/slm_sched.h) is modelled as one SCHED_REG write
+*   SIM_DMA_LATENCY ticks after each SLM_TRIG terminal count.  Its SCHED_NEXT
+*   bit restarts the chain without going through ENBL_TRIG_ISR / T_ISR.
+*   EXPO_DMA (SLM_SCHED_EXPO) writes the next TRG_CNT period from its cycle
+*   in the same request, ahead of the SCHED_REG write.
+*   In a burst (SLM_BURST) the SLM_TRIG terminal count restarts the chain
+*   itself until BURST_CNT runs out; sim_set_burst(0) builds the board
+*   without it, as HW_BURST_AVAILABLE then reads.
+*
+*   slm_sim_usb.c models the vendor endpoints: sim_usb_host_write()
+*   only succeeds while OUT is armed and empty (otherwise the host sees NAK),
+*   sim_usb_host_read() takes a loaded IN packet.  ReadOutEP / LoadInEP copy
+*   immediately.
+*
+*   slm_sim_lcd.c keeps the character LCD as a text buffer.  Every
+*   Position / PutChar busy-waits SIM_LCD_ACCESS_TICKS; the main loop models
+*   add that to the pass that made the access (sim_lcd_take_busy()).
+*
+*   No time passes inside T_ISR.  Its execution time (HW_CYCLES) is modelled
+*   as SIM_ACCESS_CYCLES per register access, so a T_ISR that touches more
+*   registers shows up in the slm_isr_stats.h histogram.
+*
+*******************************************************************************/
+
+#ifndef SLM_SIM_HW_H
+#define SLM_SIM_HW_H
+
+#include <stdint.h>
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int8_t   int8;
+typedef int16_t  int16;
+typedef int32_t  int32;
+typedef char     char8;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Counters */
+#define SIM_TRG_CNT         (0u)
+#define SIM_SLM_WAIT        (1u)
+#define SIM_SLM_TRIG        (2u)
+#define SIM_BLANKING_DELAY  (3u)
+#define SIM_STAGE_TRIG      (4u)
+#define SIM_STAGE_WAIT      (5u)
+#define SIM_TIME_CNT        (6u)
+#define SIM_COUNTERS        (7u)
+
+/* Control registers */
+#define SIM_ENBL_TRIG_ISR   (0u)
+#define SIM_TRIG_CNT_RST    (1u)
+#define SIM_CAM_SEL_REG     (2u)
+#define SIM_STAGE_REG       (3u)
+#define SIM_BLANK_TOGGLE    (4u)
+#define SIM_ACTIVATE_SLM    (5u)
+#define SIM_REGS            (6u)
+
+/* Events reported through sim_set_event_hook() */
+#define SIM_EV_EXPOSE_START (0u)    // TRG_CNT started, camera trigger high
+#define SIM_EV_EXPOSE_END   (1u)    // TRG_CNT terminal count
+#define SIM_EV_LASER_ON     (2u)    // BLANKING_DELAY terminal count
+#define SIM_EV_SLM_TRIG     (3u)    // SLM trigger pulse started
+#define SIM_EV_CHAIN_END    (4u)    // SLM_TRIG terminal count
+#define SIM_EV_ISR_ENTRY    (5u)    // T_ISR starts executing
+#define SIM_EV_STAGE_PULSE  (6u)    // STAGE_TRIG started
+#define SIM_EV_STAGE_READY  (7u)    // STAGE_WAIT terminal count, STAGE_READY rises
+#define SIM_EV_SCHED_WRITE  (8u)    // schedule DMA wrote SCHED_REG
+#define SIM_EV_TIME_UP      (9u)    // TIME_CNT terminal count
+
+#define SIM_ISR_LATENCY_DEFAULT (6u)    // 3us from TC to the first register write
+#define SIM_DMA_LATENCY (1u)            // DRQ to SCHED_REG write, a few bus clocks
+#define SIM_ACCESS_CYCLES (6u)          // bus cycles per UDB register access, the T_ISR cost model
+
+void sim_write_period(uint8 counter, uint32 period);
+uint32 sim_read_period(uint8 counter);
+void sim_reg_write(uint8 reg, uint8 val);
+uint8 sim_reg_read(uint8 reg);
+void sim_isr_clear_pending(void);
+
+/* Simulator control */
+void sim_reset(void);
+void sim_set_isr(void (*isr)(void));
+void sim_set_stage_isr(void (*isr)(void));
+void sim_set_time_isr(void (*isr)(void));
+void sim_set_isr_latency(uint32 ticks);
+void sim_set_isr_jitter(uint32 ticks);
+void sim_set_event_hook(void (*hook)(uint8 event, uint64_t tick));
+uint64_t sim_now(void);
+uint32 sim_isr_latency(void);
+uint32 sim_cycles(void);
+uint8 sim_chain_busy(void);
+void sim_advance(uint64_t ticks);
+
+/* USB endpoints, device side */
+#define SIM_USB_OUT_BUFFER_FULL  (1u)
+#define SIM_USB_OUT_BUFFER_EMPTY (2u)
+#define SIM_USB_IN_BUFFER_FULL   (3u)
+#define SIM_USB_IN_BUFFER_EMPTY  (4u)
+#define SIM_USB_EP_SIZE          (64u)
+#define SIM_USB_EPS              (8u)
+
+uint8 sim_usb_ep_state(uint8 ep);
+uint16 sim_usb_ep_count(uint8 ep);
+void sim_usb_enable_out(uint8 ep);
+uint16 sim_usb_read_out(uint8 ep, uint8* buf, uint16 len);
+void sim_usb_load_in(uint8 ep, const uint8* buf, uint16 len);
+
+/* USB endpoints, host side */
+void sim_usb_reset(void);
+uint8 sim_usb_host_write(uint8 ep, const void* buf, uint16 len);
+uint16 sim_usb_host_read(uint8 ep, void* buf, uint16 len);
+
+#define SIM_LCD_ACCESS_TICKS (80u)     // one LCD_Char access, 40us
+
+void sim_lcd_reset(void);
+void sim_lcd_position(uint8 row, uint8 col);
+void sim_lcd_putchar(char ch);
+const char* sim_lcd_row(uint8 row);
+uint32 sim_lcd_accesses(void);
+uint32 sim_lcd_take_busy(void);
+
+/* Edge counters behind HW_*_CNT_READ() */
+#define SIM_CNT_CAM         (0u)    // chain starts, camera trigger rising edges
+#define SIM_CNT_SLM         (1u)    // SLM trigger pulses
+#define SIM_CNT_STAGE       (2u)    // STAGE_TRIG starts
+#define SIM_CNTS            (3u)
+
+uint32 sim_cnt_read(uint8 cnt);
+
+void sim_set_time_cnt(uint8 present);
+uint8 sim_time_cnt(void);
+void sim_time_start(uint32 ticks, uint8 gate);
+void sim_time_stop(void);
+
+void sim_sched_arm(const uint8* table, uint16 len, uint8 cyclic);
+void sim_sched_disarm(void);
+uint8 sim_sched_busy(void);
+void sim_expo_arm(const uint32* table, uint16 len);
+void sim_expo_disarm(void);
+void sim_set_burst(uint8 present);
+uint8 sim_burst(void);
+void sim_burst_start(uint32 frames);
+void sim_burst_stop(void);
+uint8 sim_burst_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define HW_TRG_CNT_WRITE_PERIOD(p)          sim_write_period(SIM_TRG_CNT, (p))
+#define HW_SLM_WAIT_WRITE_PERIOD(p)         sim_write_period(SIM_SLM_WAIT, (p))
+#define HW_SLM_TRIG_WRITE_PERIOD(p)         sim_write_period(SIM_SLM_TRIG, (p))
+#define HW_BLANKING_DELAY_WRITE_PERIOD(p)   sim_write_period(SIM_BLANKING_DELAY, (p))
+#define HW_STAGE_TRIG_WRITE_PERIOD(p)       sim_write_period(SIM_STAGE_TRIG, (p))
+#define HW_STAGE_WAIT_WRITE_PERIOD(p)       sim_write_period(SIM_STAGE_WAIT, (p))
+
+#define HW_ENBL_TRIG_ISR_WRITE(v)           sim_reg_write(SIM_ENBL_TRIG_ISR, (v))
+#define HW_ENBL_TRIG_ISR_READ()             sim_reg_read(SIM_ENBL_TRIG_ISR)
+#define HW_TRIG_CNT_RST_WRITE(v)            sim_reg_write(SIM_TRIG_CNT_RST, (v))
+#define HW_CAM_SEL_REG_WRITE(v)             sim_reg_write(SIM_CAM_SEL_REG, (v))
+#define HW_CAM_SEL_REG_READ()               sim_reg_read(SIM_CAM_SEL_REG)
+#define HW_STAGE_REG_WRITE(v)               sim_reg_write(SIM_STAGE_REG, (v))
+#define HW_BLANK_TOGGLE_WRITE(v)            sim_reg_write(SIM_BLANK_TOGGLE, (v))
+#define HW_ACTIVATE_SLM_WRITE(v)            sim_reg_write(SIM_ACTIVATE_SLM, (v))
+
+#define HW_TRIG_ISR_CLEAR_PENDING()         sim_isr_clear_pending()
+
+#define HW_TS_START()
+#define HW_TS_NOW()                         ((uint32)sim_now())
+#define HW_TS_HZ                            (2000000u)
+
+#define HW_TRIG_ISR_LATENCY()               sim_isr_latency()
+#define HW_CYCLES()                         sim_cycles()
+
+#define HW_USB_EP_STATE(ep)                 sim_usb_ep_state(ep)
+#define HW_USB_EP_COUNT(ep)                 sim_usb_ep_count(ep)
+#define HW_USB_ENABLE_OUT_EP(ep)            sim_usb_enable_out(ep)
+#define HW_USB_READ_OUT_EP(ep, b, n)        sim_usb_read_out((ep), (b), (n))
+#define HW_USB_LOAD_IN_EP(ep, b, n)         sim_usb_load_in((ep), (b), (n))
+#define HW_USB_OUT_BUFFER_FULL              SIM_USB_OUT_BUFFER_FULL
+#define HW_USB_IN_BUFFER_EMPTY              SIM_USB_IN_BUFFER_EMPTY
+
+#define HW_LCD_POSITION(r, c)               sim_lcd_position((r), (c))
+#define HW_LCD_PUTCHAR(ch)                  sim_lcd_putchar(ch)
+
+#define HW_SCHED_AVAILABLE                  (1u)
+#define HW_SCHED_ARM(t, n, c)               sim_sched_arm((t), (n), (c))
+#define HW_SCHED_DISARM()                   sim_sched_disarm()
+#define HW_SCHED_BUSY()                     sim_sched_busy()
+
+#define HW_BURST_AVAILABLE                  sim_burst()
+#define HW_BURST_START(n)                   sim_burst_start(n)
+#define HW_BURST_STOP()                     sim_burst_stop()
+#define HW_BURST_BUSY()                     sim_burst_busy()
+
+#define HW_SCHED_EXPO_AVAILABLE             (1u)
+#define HW_SCHED_EXPO_ARM(t, n)             sim_expo_arm((t), (n))
+#define HW_SCHED_EXPO_DISARM()              sim_expo_disarm()
+
+#define HW_STAGE_READY_AVAILABLE            (1u)
+
+#define HW_TIME_CNT_AVAILABLE               sim_time_cnt()
+#define HW_TIME_START(t, g)                 sim_time_start((t), (g))
+#define HW_TIME_STOP()                      sim_time_stop()
+
+#define HW_FRAME_CNT_AVAILABLE              (1u)
+#define HW_CAM_CNT_READ()                   sim_cnt_read(SIM_CNT_CAM)
+#define HW_SLM_CNT_READ()                   sim_cnt_read(SIM_CNT_SLM)
+#define HW_STAGE_CNT_READ()                 sim_cnt_read(SIM_CNT_STAGE)
+
+/* Single threaded model, T_ISR only runs from sim_advance() */
+#define HW_ENTER_CRITICAL()                 (0u)
+#define HW_EXIT_CRITICAL(s)                 ((void)(s))
+
+#endif /* SLM_SIM_HW_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,66 @@
+/*******************************************************************************
+* File Name: slm_sim_lcd.c
+*
+* Description:
+*   Character LCD model for the simulator: 2 x 20 cells and a cursor that
+*   moves right after every character, like the LCD_Char component.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "slm_sim_hw.h"
+
+#define SIM_LCD_ROWS (2u)
+#define SIM_LCD_COLS (20u)
+
+static char cells[SIM_LCD_ROWS][SIM_LCD_COLS + 1u];
+static uint8 cur_row;
+static uint8 cur_col;
+static uint32 accesses;
+static uint32 busy;
+
+void sim_lcd_reset(void){
+    uint8 r;
+
+    for(r = 0; r < SIM_LCD_ROWS; r++){
+        memset(cells[r], ' ', SIM_LCD_COLS);
+        cells[r][SIM_LCD_COLS] = '\0';
+    }
+    cur_row = cur_col = 0;
+    accesses = busy = 0;
+}
+
+void sim_lcd_position(uint8 row, uint8 col){
+    cur_row = row;
+    cur_col = col;
+    accesses++;
+    busy += SIM_LCD_ACCESS_TICKS;
+}
+
+void sim_lcd_putchar(char ch){
+    if(cur_row < SIM_LCD_ROWS && cur_col < SIM_LCD_COLS){
+        cells[cur_row][cur_col] = ch;
+    }
+    cur_col++;
+    accesses++;
+    busy += SIM_LCD_ACCESS_TICKS;
+}
+
+/* What the display shows on row, SIM_LCD_COLS characters */
+const char* sim_lcd_row(uint8 row){
+    return (row < SIM_LCD_ROWS) ? cells[row] : "";
+}
+
+uint32 sim_lcd_accesses(void){
+    return accesses;
+}
+
+/* Busy-wait ticks since the last call */
+uint32 sim_lcd_take_busy(void){
+    uint32 b = busy;
+
+    busy = 0;
+    return b;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,86 @@
+/*******************************************************************************
+* File Name: slm_sim_usb.c
+*
+* Description:
+*   USBFS endpoint model for the simulator.  Each endpoint holds at most one
+*   packet.  An endpoint is IN until the firmware enables it as OUT.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include "slm_sim_hw.h"
+
+struct sim_ep{
+    uint8 out;
+    uint8 armed;
+    uint8 full;
+    uint16 len;
+    uint8 buf[SIM_USB_EP_SIZE];
+};
+
+static struct sim_ep eps[SIM_USB_EPS];
+
+static uint16 clamp_len(uint16 len){
+    return len > SIM_USB_EP_SIZE ? SIM_USB_EP_SIZE : len;
+}
+
+void sim_usb_reset(void){
+    memset(eps, 0, sizeof(eps));
+}
+
+uint8 sim_usb_ep_state(uint8 ep){
+    if(eps[ep].out){
+        return eps[ep].full ? SIM_USB_OUT_BUFFER_FULL : SIM_USB_OUT_BUFFER_EMPTY;
+    }
+    return eps[ep].full ? SIM_USB_IN_BUFFER_FULL : SIM_USB_IN_BUFFER_EMPTY;
+}
+
+/* Bytes of the packet the host last wrote */
+uint16 sim_usb_ep_count(uint8 ep){
+    return eps[ep].len;
+}
+
+void sim_usb_enable_out(uint8 ep){
+    eps[ep].out = 1;
+    eps[ep].armed = 1;
+}
+
+uint16 sim_usb_read_out(uint8 ep, uint8* buf, uint16 len){
+    uint16 n = eps[ep].len < len ? eps[ep].len : len;
+
+    memcpy(buf, eps[ep].buf, n);
+    eps[ep].full = 0;
+    return n;
+}
+
+void sim_usb_load_in(uint8 ep, const uint8* buf, uint16 len){
+    eps[ep].len = clamp_len(len);
+    memcpy(eps[ep].buf, buf, eps[ep].len);
+    eps[ep].full = 1;
+}
+
+/* Returns 0 (NAK) unless the endpoint is armed and empty */
+uint8 sim_usb_host_write(uint8 ep, const void* buf, uint16 len){
+    if(!eps[ep].out || !eps[ep].armed || eps[ep].full){
+        return 0;
+    }
+    eps[ep].len = clamp_len(len);
+    memcpy(eps[ep].buf, buf, eps[ep].len);
+    eps[ep].full = 1;
+    eps[ep].armed = 0;
+    return 1;
+}
+
+/* Returns the packet length, 0 (NAK) if nothing is loaded */
+uint16 sim_usb_host_read(uint8 ep, void* buf, uint16 len){
+    uint16 n = eps[ep].len < len ? eps[ep].len : len;
+
+    if(eps[ep].out || !eps[ep].full){
+        return 0;
+    }
+    memcpy(buf, eps[ep].buf, n);
+    eps[ep].full = 0;
+    return n;
+}
+
+/* [] END OF FILE */
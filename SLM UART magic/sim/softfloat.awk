@@ -0,0 +1,69 @@
+# Soft-float census for `make softfloat`: reads `objdump -dr` of the objects
+# and, from the functions in roots, walks the calls each function makes in
+# the listing.  Prints the libgcc float / double helpers reachable from the
+# roots as call sites, each function counted once and both arms of every
+# branch included, so it is a static count and not calls per update.
+#   awk -v path=<name> -v roots="<fn> ..." -f softfloat.awk <listings>
+
+function helper(s){
+    # __aeabi_fdiv, __aeabi_d2uiz, __aeabi_ui2f ... on ARM, __divsf3,
+    # __floatunsidf ... on other soft-float targets; not __aeabi_uldivmod
+    return s ~ /^__aeabi_(c?[fd][a-z0-9]+|[iul]+2[fd])$/ || s ~ /^__[a-z]+[sd]f[0-9]?[a-z0-9]*$/
+}
+
+function walk(fn,    i, n, list){
+    if(fn in seen){
+        return
+    }
+    seen[fn] = 1
+    n = split(calls[fn], list, " ")
+    for(i = 1; i <= n; i++){
+        if(helper(list[i])){
+            sites[list[i]]++
+            total++
+            if(list[i] ~ /df/ || list[i] ~ /^__aeabi_(c?d|[a-z0-9]*2d$)/){
+                doubles++
+            }
+        } else {
+            walk(list[i])
+        }
+    }
+}
+
+/^[0-9a-f]+ <[^>]+>:$/ {
+    fn = substr($2, 2, length($2) - 3)
+    next
+}
+
+# Calls resolved by the assembler, within the object
+/\t(call|jmp|bl|b\.w|b)[ \t]+[0-9a-f]+ <[^+>]+>$/ {
+    sym = $NF
+    calls[fn] = calls[fn] " " substr(sym, 2, length(sym) - 2)
+    next
+}
+
+# Calls left to the linker
+/R_(386_PC32|386_PLT32|X86_64_PLT32|ARM_THM_CALL|ARM_THM_JUMP24|ARM_CALL|ARM_JUMP24)/ {
+    sym = $NF
+    sub(/[-+]0x[0-9a-f]+$/, "", sym)
+    calls[fn] = calls[fn] " " sym
+}
+
+END {
+    n = split(roots, list, " ")
+    for(i = 1; i <= n; i++){
+        walk(list[i])
+    }
+    n = 0
+    for(s in sites){
+        for(i = ++n; i > 1 && names[i - 1] > s; i--){
+            names[i] = names[i - 1]
+        }
+        names[i] = s
+    }
+    for(i = 1; i <= n; i++){
+        printf("%s_sites %s: %u\n", path, names[i], sites[names[i]])
+    }
+    printf("%s_softfloat_sites: %u\n", path, total)
+    printf("%s_double_sites: %u\n", path, doubles)
+}
@@ -0,0 +1,166 @@
+/*******************************************************************************
+* File Name: timing_bench.c
+*
+* Description:
+*   Compares the integer tick timing engine in common/slm_timing.c with the
+*   double precision code it replaced, over a sweep of frame rates, camera
+*   row counts and the readout modes of the build's camera profile.  Reports
+*   the difference in TRG_CNT / SLM_WAIT periods (in ticks) and the time per
+*   setExposure() for both paths.  The reference is the readTime() of the
+*   main.c copy that camera used to have; build with CAMERA=HAMAMATSU for
+*   the Hamamatsu profiles.
+*
+*   Where the requested frame does not fit the readout, the reference fell
+*   back to the camera's fixed rate and setExposure() now solves for the
+*   fastest frame (minFrameTicks()); those configs report the solved rate
+*   against the fixed one and which constraint bound it.
+*
+*   The workstation has an FPU, so the time per call printed here is the
+*   host's and no measure of the PSoC, where the Cortex-M3 does every float
+*   and double operation in a libgcc soft-float call; the double path even
+*   runs faster here.  `make -C sim softfloat` cross compiles both paths
+*   (the reference is in timing_ref.c) and counts those calls instead:
+*     double path  24 call sites, 21 of them double (4 x __aeabi_ddiv)
+*     tick path    11 call sites, all single precision (2 x __aeabi_fdiv,
+*                  one of them only on the fallback), no double
+*   Those are call sites reachable from each path, both arms of every
+*   branch counted, not calls per update.  The figures are from
+*   SOFT_CC=gcc SOFT_CFLAGS="-m32 -msoft-float -mno-80387", the same
+*   libgcc routines under their generic names (__divdf3 for __aeabi_ddiv);
+*   an arm-none-eabi build, the default, may differ by a call or two.
+*
+*   Build: make -C sim timing_bench [CAMERA=HAMAMATSU]   Run: sim/timing_bench
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+#define bench_clock() __rdtsc()
+#else
+#define BENCH_UNIT "ns"
+static uint64 bench_clock(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000000ull + (uint64)ts.tv_nsec;
+}
+#endif
+
+#include "slm_seq.h"
+#include "slm_timing.h"
+#include "timing_ref.h"
+
+#define BENCH_REPEAT (200u)
+
+/* What CHANGE_FPS does now */
+__attribute__((noinline)) static void tick_set_exposure(float fps, uint16 rows, uint8 cap){
+    fps_in = fps;
+    frameTicks = fpsToTicks(fps_in);
+    vert = rows;
+    capMode = cap;
+    setExposure();
+}
+
+static uint32 udiff(uint32 a, uint32 b){
+    return a > b ? a - b : b - a;
+}
+
+int main(void){
+    uint64 ref_time = 0;
+    uint64 tick_time = 0;
+    uint32 calls = 0;
+    uint32 compared = 0;
+    uint32 skipped = 0;
+    uint32 exp_max_err = 0;
+    uint32 wait_max_err = 0;
+    uint64 exp_err_sum = 0;
+    uint64 wait_err_sum = 0;
+    uint32 limits[LIMIT_SLM + 1u] = {0};
+    double solved_sum = 0.0;
+    double fixed_sum = 0.0;
+    float solved_min = 1e9f;
+    float solved_max = 0.0f;
+    uint32 h;
+
+    sim_reset();
+    printf("camera: %s\n", CAM_NAME);
+    for(h = 0; h < ref_cam_count; h++){
+        uint32 h_exp_err = 0;
+        uint32 h_wait_err = 0;
+        uint32 fps10;
+        uint32 rows;
+
+        for(fps10 = 10; fps10 <= 1000; fps10 += 5){
+            for(rows = 16; rows <= 2048; rows += 16){
+                float fps = (float)fps10 / 10.0f;
+                struct ref_result r;
+                uint64 t0;
+                uint32 i;
+
+                t0 = bench_clock();
+                for(i = 0; i < BENCH_REPEAT; i++){
+                    ref_set_exposure(fps, (uint16)rows, &ref_cams[h], &r);
+                }
+                ref_time += bench_clock() - t0;
+
+                t0 = bench_clock();
+                for(i = 0; i < BENCH_REPEAT; i++){
+                    tick_set_exposure(fps, (uint16)rows, ref_cams[h].cap_mode);
+                }
+                tick_time += bench_clock() - t0;
+                calls += BENCH_REPEAT;
+
+                /* The reference left frameTicks stale on fallback, nothing to compare */
+                if(r.fallback){
+                    skipped++;
+                    limits[frameLimit]++;
+                    solved_sum += fps_in;
+                    fixed_sum += ref_cams[h].fallback_fps;
+                    solved_min = fps_in < solved_min ? fps_in : solved_min;
+                    solved_max = fps_in > solved_max ? fps_in : solved_max;
+                    continue;
+                }
+                compared++;
+                if(udiff(r.exposure_ticks, exposureTicks) > h_exp_err){
+                    h_exp_err = udiff(r.exposure_ticks, exposureTicks);
+                }
+                if(udiff(r.wait_ticks, wait_time_ticks) > h_wait_err){
+                    h_wait_err = udiff(r.wait_ticks, wait_time_ticks);
+                }
+                exp_err_sum += udiff(r.exposure_ticks, exposureTicks);
+                wait_err_sum += udiff(r.wait_ticks, wait_time_ticks);
+            }
+        }
+        printf("%s: max_exposure_err_ticks %u max_wait_err_ticks %u\n",
+               ref_cams[h].name, h_exp_err, h_wait_err);
+        if(h_exp_err > exp_max_err){
+            exp_max_err = h_exp_err;
+        }
+        if(h_wait_err > wait_max_err){
+            wait_max_err = h_wait_err;
+        }
+    }
+
+    printf("configs_compared: %u\n", compared);
+    printf("configs_fallback: %u\n", skipped);
+    if(skipped){
+        printf("fallback_fixed_fps: mean %.3f\n", fixed_sum / skipped);
+        printf("fallback_solved_fps: min %.3f mean %.3f max %.3f\n", solved_min, solved_sum / skipped, solved_max);
+        for(h = LIMIT_EXPOSURE; h <= LIMIT_SLM; h++){
+            printf("fallback_limit_%s: %u\n", limitName((uint8)h), limits[h]);
+        }
+    }
+    printf("exposure_err_ticks: max %u mean %.3f\n", exp_max_err, (double)exp_err_sum / compared);
+    printf("wait_err_ticks: max %u mean %.3f\n", wait_max_err, (double)wait_err_sum / compared);
+    /* Host FPU timing, see the header for the PSoC's soft-float calls */
+    printf("host_double_%s_per_call: %.1f\n", BENCH_UNIT, (double)ref_time / calls);
+    printf("host_tick_%s_per_call: %.1f\n", BENCH_UNIT, (double)tick_time / calls);
+
+    /* One tick is 500ns, anything above a couple of ticks is a real change */
+    return (exp_max_err <= 2u && wait_max_err <= 2u) ? 0 : 1;
+}
+
+/* [] END OF FILE */
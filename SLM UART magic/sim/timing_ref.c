@@ -0,0 +1,60 @@
+/*******************************************************************************
+* File Name: timing_ref.c
+*
+* Description:
+*   The double precision timing path as it was before common/slm_timing.c,
+*   see timing_ref.h.  No C library calls, only the counter chain macros.
+*
+*******************************************************************************/
+
+#include "timing_ref.h"
+
+const struct ref_cam ref_cams[] = {
+#if defined(SLM_CAMERA_HAMAMATSU)
+    {"hama_norm", CAP_MODE_NORMAL, .00000974436f, 2.0, 0.0, THIRTY},
+    {"hama_slow", CAP_MODE_SLOW, .0000324812f, 2.0, 0.0, TWENTY_SIX},
+#else
+    {"andor_30mhz", CAP_MODE_SLOW, .00005547f, 1.0, 0.0064, FIFTEEN},
+#endif
+};
+
+const uint8 ref_cam_count = sizeof(ref_cams) / sizeof(ref_cams[0]);
+
+/* Previous setExposure() / setWaitTime() / readTime(), double throughout */
+void ref_set_exposure(float fps, uint16 rows, const struct ref_cam* cam, struct ref_result* r){
+    volatile float fps_req = fps;
+    double period = 1 / fps_req;
+    uint32 frame = (uint32)(period / COUNT_PERIOD);
+    double read_out = (rows / cam->rows_div + 10)*cam->horz + cam->fudge;
+    double exp_max = 1 / fps_req - read_out - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
+    double float_ticks;
+    uint32 wait;
+    uint32 remain;
+
+    r->fallback = 0;
+    if(exp_max < 0){
+        exp_max = 1 / cam->fallback_fps - read_out - (double)(SLM_CNTR_TICKS + SLM_TRG_TICKS) * COUNT_PERIOD;
+        r->fallback = 1;
+    }
+    r->exposure_ticks = (uint32)(exp_max / COUNT_PERIOD);
+    HW_TRG_CNT_WRITE_PERIOD(r->exposure_ticks);
+    HW_TRIG_CNT_RST_WRITE(REG_ON);
+    HW_TRIG_CNT_RST_WRITE(REG_OFF);
+
+    float_ticks = (read_out / COUNT_PERIOD) - (double)SLM_CNTR_TICKS / 2.0f;
+    if(float_ticks <= 0){
+        wait = SLM_CNTR_TICKS;
+    } else {
+        wait = (uint32)(read_out / COUNT_PERIOD) - SLM_TRG_TICKS / 2;
+    }
+    remain = frame - r->exposure_ticks - SLM_TRG_TICKS;
+    if(wait < remain){
+        wait = remain;
+    }
+    if(wait < SLM_CNTR_TICKS){
+        wait = SLM_CNTR_TICKS;
+    }
+    r->wait_ticks = wait;
+}
+
+/* [] END OF FILE */
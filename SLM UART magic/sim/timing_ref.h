@@ -0,0 +1,42 @@
+/*******************************************************************************
+* File Name: timing_ref.h
+*
+* Description:
+*   The double precision setExposure() / setWaitTime() / readTime() that the
+*   integer tick engine in common/slm_timing.c replaced, kept as a reference
+*   for timing_bench.c.  It has a translation unit of its own, free of the
+*   C library, so that `make softfloat` can cross compile it next to
+*   slm_timing.c and count the soft-float calls of both.
+*
+*******************************************************************************/
+
+#ifndef TIMING_REF_H
+#define TIMING_REF_H
+
+#include "slm_seq.h"
+#include "slm_timing.h"
+
+/* The reference per readout mode, in seconds as the old headers had them */
+struct ref_cam{
+    const char* name;
+    uint8 cap_mode;
+    double horz;
+    double rows_div;
+    double fudge;
+    float fallback_fps;
+};
+
+struct ref_result{
+    uint32 exposure_ticks;
+    uint32 wait_ticks;
+    uint8 fallback;
+};
+
+extern const struct ref_cam ref_cams[];
+extern const uint8 ref_cam_count;
+
+void ref_set_exposure(float fps, uint16 rows, const struct ref_cam* cam, struct ref_result* r);
+
+#endif
+
+/* [] END OF FILE */
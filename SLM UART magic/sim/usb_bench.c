@@ -0,0 +1,367 @@
+/*******************************************************************************
+* File Name: usb_bench.c
+*
+* Description:
+*   Command latency of the USB main loop when the host stops reading the IN
+*   endpoint.  The host model sends a stream of command packets (retrying
+*   on NAK) and polls IN every --poll-ms, except during a --stall-ms window
+*   in which it stops polling.  The same command stream is run through:
+*     blocking  the previous loop, which spins until OUT is drained and
+*               until the host has read IN before every pass
+*     link      the usb_link_poll_out() / usb_link_poll_in() state machine
+*   and the time from the host issuing a command to the firmware applying
+*   it is reported for each.
+*
+*   It then sets up a full acquisition (SETUP_CMDS parameters) through the
+*   link loop twice: as legacy struct usb_data packets, each confirmed by a
+*   status packet before the next is sent, and as one command batch
+*   confirmed by its ack packet.
+*
+*   Build: make -C sim usb_bench        Run: sim/usb_bench --help
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "slm_usb.h"
+
+#define BENCH_LOOP_TICKS (20u)      // one pass of the main loop, 10us
+#define BENCH_SPIN_TICKS (2u)       // one GetEPState() poll in a busy wait
+#define BENCH_RETRY_TICKS (100u)    // host bulk OUT retry after NAK, 50us
+#define BENCH_STALL_START (200000u) // 100ms
+#define BENCH_CMD_MAX (10000u)
+#define SETUP_CMDS (8u)
+#define SETUP_TIMEOUT (2000000u)    // 1s
+#define TICKS_TO_US(t) ((double)(t) * 0.5)
+
+struct bench_cmd{
+    uint64_t issue;
+    uint64_t applied;
+};
+
+static struct bench_cmd cmds[BENCH_CMD_MAX];
+static uint32 n_cmds = 200;
+static uint32 poll_ticks = 2000;
+static uint32 stall_ticks = 1000000;
+static uint32 next_cmd;
+static uint64_t next_retry;
+static uint64_t next_poll;
+static uint32 status_packets;
+
+static uint8 host_polling(uint64_t t){
+    return t < BENCH_STALL_START || t >= (uint64_t)BENCH_STALL_START + stall_ticks;
+}
+
+/* Host side, run between firmware steps */
+static void host_step(void){
+    uint64_t t = sim_now();
+
+    if(next_cmd < n_cmds && t >= cmds[next_cmd].issue && t >= next_retry){
+        struct usb_data pkt;
+
+        memset(&pkt, 0, sizeof(pkt));
+        pkt.flags = STOP_CAPTURE;
+        pkt.count = next_cmd;
+        if(sim_usb_host_write(OUT_EP_NUM, &pkt, sizeof(pkt))){
+            next_cmd++;
+        } else {
+            next_retry = t + BENCH_RETRY_TICKS;
+        }
+    }
+    if(host_polling(t) && t >= next_poll){
+        struct usb_data pkt;
+
+        if(sim_usb_host_read(IN_EP_NUM, &pkt, sizeof(pkt))){
+            status_packets++;
+        }
+        next_poll = t + poll_ticks;
+    }
+}
+
+static void cpu(uint32 ticks){
+    sim_advance(ticks);
+    host_step();
+}
+
+static void apply(void){
+    uint32 id = incoming.count;
+
+    if(id < n_cmds && !cmds[id].applied){
+        cmds[id].applied = sim_now();
+    }
+}
+
+/* Previous main loop, as it was before slm_usb.c */
+static void blocking_pass(void){
+    if(HW_USB_EP_STATE(OUT_EP_NUM) == HW_USB_OUT_BUFFER_FULL){
+        HW_USB_READ_OUT_EP(OUT_EP_NUM, (uint8*)&incoming, sizeof(struct usb_data));
+        apply();
+    }
+    while(HW_USB_EP_STATE(OUT_EP_NUM) == HW_USB_OUT_BUFFER_FULL){
+        cpu(BENCH_SPIN_TICKS);
+    }
+    HW_USB_ENABLE_OUT_EP(OUT_EP_NUM);
+    while(HW_USB_EP_STATE(IN_EP_NUM) != HW_USB_IN_BUFFER_EMPTY){
+        cpu(BENCH_SPIN_TICKS);
+    }
+    HW_USB_LOAD_IN_EP(IN_EP_NUM, (uint8*)&outgoing, sizeof(struct usb_data));
+    cpu(BENCH_LOOP_TICKS);
+}
+
+static void link_pass(void){
+    struct usb_cmd cmd;
+    uint8 rx = usb_link_poll_out();
+
+    if(rx == USB_RX_LEGACY){
+        apply();
+    } else if(rx == USB_RX_BATCH){
+        while(usb_cmd_next(&cmd)){
+            uint8 status = usb_cmd_load(&cmd, &incoming);
+
+            if(status == CMD_OK){
+                apply();
+            }
+            usb_cmd_ack(cmd.seq, status);
+        }
+    }
+    usb_link_poll_in();
+    cpu(BENCH_LOOP_TICKS);
+}
+
+/* Firmware side of the setup run, echoes the applied count in steps, as
+*  count carries the camera triggers
+*/
+static uint32 setup_applied;
+
+static void setup_fw_pass(void){
+    struct usb_cmd cmd;
+    uint8 rx = usb_link_poll_out();
+
+    if(rx == USB_RX_LEGACY){
+        outgoing.steps = (uint16)++setup_applied;
+    } else if(rx == USB_RX_BATCH){
+        while(usb_cmd_next(&cmd)){
+            uint8 status = usb_cmd_load(&cmd, &incoming);
+
+            if(status == CMD_OK){
+                outgoing.steps = (uint16)++setup_applied;
+            }
+            usb_cmd_ack(cmd.seq, status);
+        }
+    }
+    usb_link_poll_in();
+    sim_advance(BENCH_LOOP_TICKS);
+}
+
+/* Batch builder of the host model */
+struct usb_batch{
+    uint8 buf[USB_EP_SIZE];
+    uint16 len;
+};
+
+static void usb_batch_init(struct usb_batch* b){
+    b->buf[0] = (uint8)(USB_CMD_MAGIC);
+    b->buf[1] = (uint8)(USB_CMD_MAGIC >> 8);
+    b->buf[2] = (uint8)(USB_CMD_MAGIC >> 16);
+    b->buf[3] = (uint8)(USB_CMD_MAGIC >> 24);
+    b->len = sizeof(uint32);
+}
+
+/* Returns 0 if the record does not fit, send the batch and start another */
+static uint8 usb_batch_add(struct usb_batch* b, uint8 op, uint16 seq, const void* payload){
+    uint8 n;
+
+    if(op >= CMD_COUNT){
+        return 0;
+    }
+    n = usbCmdLen[op];
+    if(b->len + USB_CMD_HDR + n > USB_EP_SIZE){
+        return 0;
+    }
+    b->buf[b->len] = op;
+    b->buf[b->len + 1u] = (uint8)seq;
+    b->buf[b->len + 2u] = (uint8)(seq >> 8);
+    memcpy(&b->buf[b->len + USB_CMD_HDR], payload, n);
+    b->len += USB_CMD_HDR + n;
+    return 1;
+}
+
+static void setup_batch(struct usb_batch* b){
+    static const uint8 ops[SETUP_CMDS] = {
+        CMD_LASER, CMD_SIM_MODE, CMD_RUN_MODE, CMD_Z_STEPS,
+        CMD_READOUT, CMD_FPS, CMD_EXPOSURE, CMD_START
+    };
+    uint8 payload[8];
+    uint16 i;
+
+    usb_batch_init(b);
+    memset(payload, 0, sizeof(payload));
+    for(i = 0; i < SETUP_CMDS; i++){
+        usb_batch_add(b, ops[i], (uint16)(100u + i), payload);
+    }
+}
+
+static uint8 setup_run(const char* name, uint8 batch){
+    union{
+        struct usb_data status;
+        struct usb_ack ack;
+        uint8 raw[USB_EP_SIZE];
+    } in;
+    struct usb_batch b;
+    struct usb_data pkt;
+    uint32 sent = 0, confirmed = 0, out_packets = 0, in_reads = 0, i;
+    uint8 waiting = 0;
+    uint64_t t_poll = 0, t_retry = 0;
+
+    sim_reset();
+    usb_link_init();
+    setup_applied = 0;
+    outgoing.steps = 0;
+    setup_batch(&b);
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.flags = SET_LASER_MODE;
+
+    while(confirmed < SETUP_CMDS && sim_now() < SETUP_TIMEOUT){
+        uint64_t t = sim_now();
+
+        setup_fw_pass();
+        if(!waiting && t >= t_retry){
+            uint8 ok = batch ? sim_usb_host_write(OUT_EP_NUM, b.buf, b.len)
+                             : sim_usb_host_write(OUT_EP_NUM, &pkt, sizeof(pkt));
+            if(ok){
+                out_packets++;
+                sent = batch ? SETUP_CMDS : sent + 1u;
+                waiting = 1;
+                t_poll = t + poll_ticks;
+            } else {
+                t_retry = t + BENCH_RETRY_TICKS;
+            }
+        }
+        if(waiting && t >= t_poll){
+            if(sim_usb_host_read(IN_EP_NUM, &in, sizeof(in))){
+                in_reads++;
+                if(in.ack.magic == USB_ACK_MAGIC){
+                    for(i = 0; i < in.ack.count; i++){
+                        confirmed += in.ack.status[i] == CMD_OK;
+                    }
+                } else if(!batch && in.status.steps == sent){
+                    confirmed = sent;
+                }
+                waiting = confirmed < sent;
+            }
+            t_poll = t + poll_ticks;
+        }
+    }
+
+    printf("%s_setup_ms: %.3f\n", name, TICKS_TO_US(sim_now()) / 1000.0);
+    printf("%s_setup_packets: out %u in %u\n", name, out_packets, in_reads);
+    return confirmed == SETUP_CMDS;
+}
+
+static uint8 run(const char* name, void (*pass)(void)){
+    uint64_t end = (uint64_t)BENCH_STALL_START * 2u + stall_ticks * 2ull;
+    uint64_t sum = 0, max = 0, st_sum = 0, st_max = 0;
+    uint32 n = 0, st_n = 0, lost = 0, i;
+
+    sim_reset();
+    for(i = 0; i < n_cmds; i++){
+        cmds[i].applied = 0;
+    }
+    next_cmd = 0;
+    next_retry = 0;
+    next_poll = 0;
+    status_packets = 0;
+    usb_link_init();
+
+    while(sim_now() < end){
+        pass();
+    }
+
+    for(i = 0; i < n_cmds; i++){
+        uint64_t lat;
+
+        if(!cmds[i].applied){
+            lost++;
+            continue;
+        }
+        lat = cmds[i].applied - cmds[i].issue;
+        sum += lat;
+        n++;
+        if(lat > max){
+            max = lat;
+        }
+        if(!host_polling(cmds[i].issue)){
+            st_sum += lat;
+            st_n++;
+            if(lat > st_max){
+                st_max = lat;
+            }
+        }
+    }
+
+    printf("%s_latency_us: mean %.1f max %.1f\n", name,
+           n ? TICKS_TO_US((double)sum / n) : 0.0, TICKS_TO_US(max));
+    printf("%s_stalled_latency_us: mean %.1f max %.1f (%u commands)\n", name,
+           st_n ? TICKS_TO_US((double)st_sum / st_n) : 0.0, TICKS_TO_US(st_max), st_n);
+    printf("%s_status_packets: %u\n", name, status_packets);
+    printf("%s_lost_commands: %u\n", name, lost);
+    return lost == 0;
+}
+
+static void usage(const char* prog){
+    printf("usage: %s [options]\n"
+           "  --commands N       command packets to send (default 200)\n"
+           "  --poll-ms T        host IN poll interval (default 1)\n"
+           "  --stall-ms T       time the host stops polling IN (default 500)\n",
+           prog);
+}
+
+int main(int argc, char** argv){
+    static const struct option opts[] = {
+        {"commands", required_argument, 0, 'c'},
+        {"poll-ms", required_argument, 0, 'p'},
+        {"stall-ms", required_argument, 0, 's'},
+        {"help", no_argument, 0, 'H'},
+        {0, 0, 0, 0}
+    };
+    uint32 seed = 1;
+    uint64_t span;
+    uint32 i;
+    uint8 ok;
+    int c;
+
+    while((c = getopt_long(argc, argv, "", opts, NULL)) != -1){
+        switch(c){
+            case 'c': n_cmds = (uint32)strtoul(optarg, NULL, 0); break;
+            case 'p': poll_ticks = (uint32)(strtod(optarg, NULL) * 2000.0); break;
+            case 's': stall_ticks = (uint32)(strtod(optarg, NULL) * 2000.0); break;
+            default: usage(argv[0]); return c == 'H' ? 0 : 1;
+        }
+    }
+    if(n_cmds > BENCH_CMD_MAX){
+        n_cmds = BENCH_CMD_MAX;
+    }
+    if(poll_ticks == 0){
+        poll_ticks = 1;
+    }
+
+    /* Commands spread over the run, before, during and after the stall */
+    span = (uint64_t)BENCH_STALL_START * 2u + stall_ticks;
+    for(i = 0; i < n_cmds; i++){
+        seed = seed * 1103515245u + 12345u;
+        cmds[i].issue = span * i / n_cmds + (seed >> 16) % 1000u;
+    }
+
+    printf("host_poll_ms: %.3f\n", poll_ticks / 2000.0);
+    printf("host_stall_ms: %.3f\n", stall_ticks / 2000.0);
+    ok = run("blocking", blocking_pass);
+    ok &= run("link", link_pass);
+    ok &= setup_run("legacy", 0);
+    ok &= setup_run("batch", 1);
+    return ok ? 0 : 1;
+}
+
+/* [] END OF FILE */